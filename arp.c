@@ -17,13 +17,20 @@
 //-----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <string.h>
 #include "arp.h"
 #include "ip.h"
+#include "timer.h"
+#include "uart0.h"
 
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
 
+arpEntry arpCache[ARP_CACHE_SIZE];
+arpQueued arpQueue[ARP_QUEUE_SIZE];
+uint8_t arpQueueCount = 0;
+
 // ------------------------------------------------------------------------------
 //  Structures
 // ------------------------------------------------------------------------------
@@ -90,7 +97,7 @@ void sendArpResponse(etherHeader *ether)
 }
 
 // Sends an ARP request
-void sendArpRequest(etherHeader *ether, uint8_t ipFrom[], uint8_t ipTo[])
+bool sendArpRequest(etherHeader *ether, uint8_t ipFrom[], uint8_t ipTo[])
 {
     arpPacket *arp = (arpPacket*)ether->data;
     uint8_t i;
@@ -121,5 +128,241 @@ void sendArpRequest(etherHeader *ether, uint8_t ipFrom[], uint8_t ipTo[])
         arp->destIp[i] = ipTo[i];
     }
     // send packet
-    putEtherPacket(ether, sizeof(etherHeader) + sizeof(arpPacket));
+    return putEtherPacket(ether, sizeof(etherHeader) + sizeof(arpPacket));
+}
+
+// Returns the cache entry for ip, or ARP_CACHE_SIZE
+uint8_t findArpEntry(const uint8_t ip[4])
+{
+    uint8_t i;
+    for (i = 0; i < ARP_CACHE_SIZE; i++)
+        if (arpCache[i].state != ARP_FREE && memcmp(arpCache[i].ip, ip, IP_ADD_LENGTH) == 0)
+            return i;
+    return ARP_CACHE_SIZE;
+}
+
+bool isArpEntryQueued(uint8_t entry)
+{
+    uint8_t i;
+    for (i = 0; i < arpQueueCount; i++)
+        if (arpQueue[i].entry == entry)
+            return true;
+    return false;
+}
+
+// Makes an entry for ip: a free one, or else the resolved one confirmed
+// longest ago that no packet is waiting on, preferring one no socket uses;
+// returns ARP_CACHE_SIZE if full
+uint8_t addArpEntry(const uint8_t ip[4])
+{
+    uint32_t now = getUptime();
+    uint8_t entry = ARP_CACHE_SIZE;
+    uint8_t i;
+    for (i = 0; i < ARP_CACHE_SIZE && arpCache[i].state != ARP_FREE; i++)
+    {
+        if (arpCache[i].state != ARP_RESOLVED || isArpEntryQueued(i))
+            continue;
+        if (entry == ARP_CACHE_SIZE
+            || (arpCache[i].users == 0 && arpCache[entry].users != 0)
+            || ((arpCache[i].users == 0) == (arpCache[entry].users == 0)
+                && now - arpCache[i].confirmed > now - arpCache[entry].confirmed))
+            entry = i;
+    }
+    if (i < ARP_CACHE_SIZE)
+        entry = i;
+    if (entry < ARP_CACHE_SIZE)
+    {
+        memset(&arpCache[entry], 0, sizeof(arpEntry));
+        memcpy(arpCache[entry].ip, ip, IP_ADD_LENGTH);
+    }
+    return entry;
+}
+
+// Looks ip up; true, with its hardware address, if it is resolved
+bool getArpEntry(const uint8_t ip[4], uint8_t hwAddress[6])
+{
+    uint8_t entry = findArpEntry(ip);
+    if (entry == ARP_CACHE_SIZE || arpCache[entry].state != ARP_RESOLVED)
+        return false;
+    memcpy(hwAddress, arpCache[entry].hwAddress, HW_ADD_LENGTH);
+    return true;
+}
+
+// Records that ip is at hwAddress; an entry that isn't in the cache is only
+// made if add is set (RFC 826: merge, and add if the frame was for us)
+void setArpEntry(const uint8_t ip[4], const uint8_t hwAddress[6], bool add)
+{
+    uint8_t entry = findArpEntry(ip);
+    if (entry == ARP_CACHE_SIZE && add)
+        entry = addArpEntry(ip);
+    if (entry == ARP_CACHE_SIZE)
+        return;
+    memcpy(arpCache[entry].hwAddress, hwAddress, HW_ADD_LENGTH);
+    arpCache[entry].state = ARP_RESOLVED;
+    arpCache[entry].tries = 0;
+    arpCache[entry].confirmed = getUptime();
+}
+
+// Takes the sender of a received ARP packet or IP datagram
+void updateArpCache(etherHeader *ether, bool add)
+{
+    arpPacket *arp = (arpPacket*)ether->data;
+    ipHeader *ip = (ipHeader*)ether->data;
+    if (ether->frameType == htons(TYPE_ARP))
+        setArpEntry(arp->sourceIp, arp->sourceAddress, add);
+    else if (ether->frameType == htons(TYPE_IP))
+        setArpEntry(ip->sourceIp, ether->sourceAddress, add);
+}
+
+// Returns ARP_RESOLVED with the hardware address of ip if it is cached;
+// otherwise queues tag until it resolves (see getArpQueued) and returns
+// ARP_PENDING, or ARP_FAILED if there is no room
+// The entry is kept refreshed for tag until cancelArpQueued(tag)
+uint8_t resolveArp(const uint8_t ip[4], uint8_t hwAddress[6], uint8_t tag)
+{
+    uint8_t entry = findArpEntry(ip);
+    if (entry < ARP_CACHE_SIZE && arpCache[entry].state == ARP_RESOLVED)
+    {
+        memcpy(hwAddress, arpCache[entry].hwAddress, HW_ADD_LENGTH);
+        arpCache[entry].users |= (uint32_t)1 << tag;
+        return ARP_RESOLVED;
+    }
+    if (arpQueueCount == ARP_QUEUE_SIZE)
+        return ARP_FAILED;
+    if (entry == ARP_CACHE_SIZE)
+        entry = addArpEntry(ip);
+    if (entry == ARP_CACHE_SIZE)
+        return ARP_FAILED;
+    // processArpCache() sends the first request
+    if (arpCache[entry].state != ARP_PENDING)
+    {
+        arpCache[entry].state = ARP_PENDING;
+        arpCache[entry].tries = 0;
+    }
+    arpQueue[arpQueueCount].entry = entry;
+    arpQueue[arpQueueCount].tag = tag;
+    arpQueueCount++;
+    return ARP_PENDING;
+}
+
+// Takes the oldest queued packet whose entry has resolved or failed;
+// returns that state with the tag and hardware address, or ARP_FREE
+uint8_t getArpQueued(uint8_t *tag, uint8_t hwAddress[6])
+{
+    uint8_t i;
+    uint8_t entry;
+    uint8_t state;
+    for (i = 0; i < arpQueueCount; i++)
+    {
+        entry = arpQueue[i].entry;
+        state = arpCache[entry].state;
+        if (state != ARP_RESOLVED && state != ARP_FAILED)
+            continue;
+        *tag = arpQueue[i].tag;
+        memcpy(hwAddress, arpCache[entry].hwAddress, HW_ADD_LENGTH);
+        arpQueueCount--;
+        memmove(&arpQueue[i], &arpQueue[i + 1], (arpQueueCount - i) * sizeof(arpQueued));
+        if (state == ARP_RESOLVED)
+            arpCache[entry].users |= (uint32_t)1 << *tag;
+        else if (!isArpEntryQueued(entry))
+            arpCache[entry].state = ARP_FREE;
+        return state;
+    }
+    return ARP_FREE;
+}
+
+// Drops the packets queued with tag, and stops refreshing its entries
+void cancelArpQueued(uint8_t tag)
+{
+    uint8_t i;
+    for (i = 0; i < ARP_CACHE_SIZE; i++)
+        arpCache[i].users &= ~((uint32_t)1 << tag);
+    i = 0;
+    while (i < arpQueueCount)
+    {
+        if (arpQueue[i].tag == tag)
+        {
+            arpQueueCount--;
+            memmove(&arpQueue[i], &arpQueue[i + 1], (arpQueueCount - i) * sizeof(arpQueued));
+        }
+        else
+            i++;
+    }
+}
+
+// Runs from the main loop: sends the requests that are due, for pending
+// entries and for resolved ones in use about to expire, and ages the cache
+// An entry no socket uses, such as a host that only ARPs us, just expires
+// At most one request goes out per call, so it never waits on the transmitter
+void processArpCache(etherHeader *ether)
+{
+    uint32_t now = getUptime();
+    uint8_t localIpAddress[4];
+    arpEntry *e;
+    bool due;
+    uint8_t i;
+    bool sent = false;
+    for (i = 0; i < ARP_CACHE_SIZE; i++)
+    {
+        e = &arpCache[i];
+        due = false;
+        switch (e->state)
+        {
+            case ARP_PENDING:
+                if (e->tries == 0 || now - e->requested >= ARP_RETRY_TIME)
+                {
+                    if (e->tries >= ARP_RETRIES)
+                        e->state = ARP_FAILED;
+                    else
+                        due = true;
+                }
+                break;
+            case ARP_RESOLVED:
+                if (now - e->confirmed >= ARP_CACHE_TTL)
+                    e->state = ARP_FREE;
+                else if (e->users != 0
+                         && now - e->confirmed >= ARP_CACHE_TTL - ARP_CACHE_REFRESH
+                         && (e->tries == 0 || now - e->requested >= ARP_CACHE_REFRESH / ARP_RETRIES))
+                    due = true;
+                break;
+            case ARP_FAILED:
+                if (!isArpEntryQueued(i))
+                    e->state = ARP_FREE;
+                break;
+        }
+        if (due && !sent)
+        {
+            getIpAddress(localIpAddress);
+            if (sendArpRequest(ether, localIpAddress, e->ip))
+            {
+                e->tries++;
+                e->requested = now;
+            }
+            sent = true;
+        }
+    }
+}
+
+void printArpCache(void)
+{
+    static const char *stateNames[] = {"free", "pending", "resolved", "failed"};
+    uint32_t now = getUptime();
+    arpEntry *e;
+    char str[80];
+    uint8_t i;
+
+    putsUart0("ARP cache         hw address          state      age (ms)\n");
+    for (i = 0; i < ARP_CACHE_SIZE; i++)
+    {
+        e = &arpCache[i];
+        if (e->state == ARP_FREE)
+            continue;
+        snprintf(str, sizeof(str), "  %3u.%3u.%3u.%3u %02x:%02x:%02x:%02x:%02x:%02x   %-10s %8lu\n",
+                 e->ip[0], e->ip[1], e->ip[2], e->ip[3], e->hwAddress[0], e->hwAddress[1],
+                 e->hwAddress[2], e->hwAddress[3], e->hwAddress[4], e->hwAddress[5],
+                 stateNames[e->state], (unsigned long)(now - e->confirmed));
+        putsUart0(str);
+    }
+    snprintf(str, sizeof(str), "  %u packets waiting\n", arpQueueCount);
+    putsUart0(str);
 }
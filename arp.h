@@ -37,6 +37,43 @@ typedef struct _arpPacket // 28 bytes
   uint8_t destIp[4];
 } arpPacket;
 
+// ARP cache: ip to hardware address for the hosts on the link, learned from
+// received frames and from requests sent for the sockets, so a socket to a
+// known host starts without an ARP round-trip.  Times are in ms of uptime
+#ifndef ARP_CACHE_SIZE
+#define ARP_CACHE_SIZE    8         // entries
+#endif
+#define ARP_CACHE_TTL     600000    // an entry is dropped this long after it was last confirmed
+#define ARP_CACHE_REFRESH 60000     // and requested again for its last ARP_CACHE_REFRESH if a socket uses it
+#define ARP_RETRY_TIME    1000      // between requests while resolving
+#define ARP_RETRIES       5
+#define ARP_QUEUE_SIZE    8         // packets waiting for a resolution
+
+// Entry states
+#define ARP_FREE      0
+#define ARP_PENDING   1             // requested, no reply yet
+#define ARP_RESOLVED  2
+#define ARP_FAILED    3             // no reply to ARP_RETRIES requests
+
+typedef struct _arpEntry
+{
+  uint8_t ip[4];
+  uint8_t hwAddress[6];
+  uint8_t state;
+  uint8_t tries;                    // requests since the last confirmation
+  uint32_t confirmed;               // uptime of the last reply or frame from the host
+  uint32_t requested;               // uptime of the last request
+  uint32_t users;                   // bit per tag (0-31) of the sockets it resolved for
+} arpEntry;
+
+// A packet waiting for its entry to resolve, kept as the caller's tag (the
+// socket it is for) rather than the frame
+typedef struct _arpQueued
+{
+  uint8_t entry;
+  uint8_t tag;
+} arpQueued;
+
 // // ARP states
 // #define ARP_LISTENING 0
 // #define ARP_
@@ -49,7 +86,16 @@ typedef struct _arpPacket // 28 bytes
 bool isArpRequest(etherHeader *ether);
 bool isArpResponse(etherHeader *ether);
 void sendArpResponse(etherHeader *ether);
-void sendArpRequest(etherHeader *ether, uint8_t ipFrom[], uint8_t ipTo[]);
+bool sendArpRequest(etherHeader *ether, uint8_t ipFrom[], uint8_t ipTo[]);
+
+bool getArpEntry(const uint8_t ip[4], uint8_t hwAddress[6]);
+void setArpEntry(const uint8_t ip[4], const uint8_t hwAddress[6], bool add);
+void updateArpCache(etherHeader *ether, bool add);
+uint8_t resolveArp(const uint8_t ip[4], uint8_t hwAddress[6], uint8_t tag);
+uint8_t getArpQueued(uint8_t *tag, uint8_t hwAddress[6]);
+void cancelArpQueued(uint8_t tag);
+void processArpCache(etherHeader *ether);
+void printArpCache(void);
 
 #endif
 
@@ -0,0 +1,97 @@
+// Bus Statistics Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "uart0.h"
+#include "busStats.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+busOp currentBusOp = BUS_OP_OTHER;
+uint32_t busBytes[BUS_OP_COUNT][BUS_COUNT];
+uint32_t busWriteCycles[BUS_OP_COUNT];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Charges the bytes that follow to op and returns the previous operation,
+// so nested operations can restore it
+busOp setBusOp(busOp op)
+{
+    busOp previous = currentBusOp;
+    currentBusOp = op;
+    return previous;
+}
+
+void countBusBytes(busId bus, uint16_t bytes)
+{
+    busBytes[currentBusOp][bus] += bytes;
+}
+
+// EEPROM writes keep the chip busy for its write cycle after the bytes
+void countBusWriteCycle(void)
+{
+    busWriteCycles[currentBusOp]++;
+}
+
+uint32_t getBusBytes(busOp op, busId bus)
+{
+    return busBytes[op][bus];
+}
+
+void resetBusStats(void)
+{
+    memset(busBytes, 0, sizeof(busBytes));
+    memset(busWriteCycles, 0, sizeof(busWriteCycles));
+}
+
+// Prints bytes per bus for each operation; the table is copied first, since
+// printing it adds uart0 bytes
+void printBusStats(void)
+{
+    static const char *opNames[BUS_OP_COUNT] = {"other", "shell", "eth rx", "eth tx", "radio poll",
+                                                "radio tx", "binding"};
+    uint32_t bytes[BUS_OP_COUNT][BUS_COUNT];
+    uint32_t cycles[BUS_OP_COUNT];
+    uint32_t total[BUS_COUNT + 1] = {0};
+    char str[80];
+    uint8_t i, j;
+
+    memcpy(bytes, busBytes, sizeof(bytes));
+    memcpy(cycles, busWriteCycles, sizeof(cycles));
+    putsUart0("Bus bytes       spi0       spi1       i2c0      uart0  ee writes\n");
+    for (i = 0; i < BUS_OP_COUNT; i++)
+    {
+        snprintf(str, sizeof(str), "  %-10s %10lu %10lu %10lu %10lu %10lu\n", opNames[i],
+                 (unsigned long)bytes[i][BUS_SPI0], (unsigned long)bytes[i][BUS_SPI1],
+                 (unsigned long)bytes[i][BUS_I2C0], (unsigned long)bytes[i][BUS_UART0],
+                 (unsigned long)cycles[i]);
+        putsUart0(str);
+        for (j = 0; j < BUS_COUNT; j++)
+            total[j] += bytes[i][j];
+        total[BUS_COUNT] += cycles[i];
+    }
+    snprintf(str, sizeof(str), "  %-10s %10lu %10lu %10lu %10lu %10lu\n", "total",
+             (unsigned long)total[BUS_SPI0], (unsigned long)total[BUS_SPI1],
+             (unsigned long)total[BUS_I2C0], (unsigned long)total[BUS_UART0],
+             (unsigned long)total[BUS_COUNT]);
+    putsUart0(str);
+}
@@ -0,0 +1,53 @@
+// Bus Statistics Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Always-on byte counters for the buses the bridge waits on, charged to the
+// operation the main loop is running when the bytes are clocked:
+//   spi0   ENC28J60 (spi0.c)
+//   spi1   nRF24L01+ (spi1.c)
+//   i2c0   24LC512 and other I2C devices (i2c0.c, i2cEeprom.c), counting
+//          address, register and data bytes, plus EEPROM write cycles
+//   uart0  shell output and input (uart0.c)
+// Interrupt handlers are charged to the operation they interrupt.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef BUSSTATS_H_
+#define BUSSTATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum _busId
+{
+    BUS_SPI0, BUS_SPI1, BUS_I2C0, BUS_UART0, BUS_COUNT
+} busId;
+
+typedef enum _busOp
+{
+    BUS_OP_OTHER, BUS_OP_SHELL, BUS_OP_ETH_RX, BUS_OP_ETH_TX, BUS_OP_RADIO_POLL,
+    BUS_OP_RADIO_TX, BUS_OP_BINDING, BUS_OP_COUNT
+} busOp;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+busOp setBusOp(busOp op);
+void countBusBytes(busId bus, uint16_t bytes);
+void countBusWriteCycle(void);
+uint32_t getBusBytes(busOp op, busId bus);
+void resetBusStats(void);
+void printBusStats(void);
+
+#endif
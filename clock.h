@@ -24,6 +24,7 @@
 //-----------------------------------------------------------------------------
 
 void initSystemClockTo40Mhz(void);
+void resetSystem(void);
 
 #endif
 
@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include "tm4c123gh6pm.h"
 #include "eeprom.h"
+#include "perfStats.h"
 
 //-----------------------------------------------------------------------------
 // Subroutines
@@ -29,15 +30,21 @@ void initEeprom(void)
 
 void writeEeprom(uint16_t add, uint32_t data)
 {
+    uint32_t perfStart = PERF_START();
     EEPROM_EEBLOCK_R = add >> 4;
     EEPROM_EEOFFSET_R = add & 0xF;
     EEPROM_EERDWR_R = data;
     while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+    PERF_STOP(PERF_EEPROM, perfStart);
 }
 
 uint32_t readEeprom(uint16_t add)
 {
+    uint32_t perfStart = PERF_START();
+    uint32_t data;
     EEPROM_EEBLOCK_R = add >> 4;
     EEPROM_EEOFFSET_R = add & 0xF;
-    return EEPROM_EERDWR_R;
+    data = EEPROM_EERDWR_R;
+    PERF_STOP(PERF_EEPROM, perfStart);
+    return data;
 }
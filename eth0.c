@@ -24,11 +24,13 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "tm4c123gh6pm.h"
+#include <string.h>
+#include "hal.h"
 #include "wait.h"
 #include "gpio.h"
 #include "spi0.h"
 #include "eth0.h"
+#include "busStats.h"
 
 // Pins
 #define CS PORTA,3
@@ -52,20 +54,41 @@
 #define ERXRDPTH    0x0D
 #define ERXWRPTL    0x0E
 #define ERXWRPTH    0x0F
+#define EDMASTL     0x10
+#define EDMASTH     0x11
+#define EDMANDL     0x12
+#define EDMANDH     0x13
+#define EDMACSL     0x16
+#define EDMACSH     0x17
 #define EIE         0x1B
+#define RXERIE  0x01
+#define TXERIE  0x02
+#define TXIE    0x08
+#define PKTIE   0x40
+#define INTIE   0x80
 #define EIR         0x1C
 #define RXERIF  0x01
 #define TXERIF  0x02
 #define TXIF    0x08
+#define DMAIF   0x20
 #define PKTIF   0x40
 #define ESTAT       0x1D
 #define CLKRDY  0x01
 #define TXABORT 0x02
+#define RXBUSY  0x04
 #define ECON2       0x1E
 #define PKTDEC  0x40
 #define ECON1       0x1F
 #define RXEN    0x04
 #define TXRTS   0x08
+#define CSUMEN  0x10
+#define DMAST   0x20
+#define TXRST   0x80
+#define EPMM0       0x28
+#define EPMCSL      0x30
+#define EPMCSH      0x31
+#define EPMOL       0x34
+#define EPMOH       0x35
 #define ERXFCON     0x38
 #define EPKTCNT     0x39
 #define MACON1      0x40
@@ -113,6 +136,47 @@
 #define HDLDIS 0x0100
 #define PHLCON      0x14
 
+// Buffer memory: receive buffer at the bottom, transmit area at the top
+// The transmit area holds two frames (each with its control byte and 7 byte
+// status vector), so one can be written while the other is on the wire; a
+// full-size frame leaves room for a small one behind it
+#define ETHER_TX_SLOTS     2
+#define ETHER_TX_START     0x1800
+#define ETHER_TX_END       0x2000
+#define ETHER_TX_OVERHEAD  8
+#define ETHER_RX_END       (ETHER_TX_START - 1)
+
+// Receive ring in RAM, filled by etherIsr()
+// Frames are kept whole in the pool; the descriptor count is a power of 2 so
+// the free-running indices wrap with it
+#define ETHER_RX_POOL_SIZE 4096
+#define ETHER_RX_FRAMES    16
+#define ETHER_RX_HEADER    6
+
+typedef struct _etherRxFrame
+{
+    uint16_t offset;
+    uint16_t size;
+    bool tcpChecked;                        // TCP checksum verified by the DMA
+} etherRxFrame;
+
+// The offload is slower than the software sum at every size on this part:
+// setting up the DMA and reading the result back costs about 40 SPI bytes
+// (60 us) and the DMA takes 80 ns per byte, while sumIpWords() takes about
+// 25 ns per byte at 40 MHz (sendTcpSegment/1460 models 2669 us offloaded
+// against 2482 us in software).  It stays off unless ETHER_CHECKSUMOFFLOAD
+// is passed, for testing the DMA path, and then only takes full segments
+#define ETHER_CHECKSUM_MIN 1024
+// DMA runs a checksum gets before a receive side that stays busy leaves it
+// to software
+#define ETHER_DMA_TRIES    4
+
+// Protocol fields the checksum offload reads from an IP header
+#define IP_PROTOCOL_TCP 6
+#define IP_LENGTH       2
+#define IP_PROTOCOL     9
+#define IP_SOURCE       12
+
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
@@ -122,6 +186,29 @@ uint8_t nextPacketMsb = 0x00;
 uint8_t sequenceId = 1;
 uint8_t hwAddress[HW_ADD_LENGTH] = {2,3,4,5,6,7};
 
+uint8_t etherRxPool[ETHER_RX_POOL_SIZE];
+etherRxFrame etherRxRing[ETHER_RX_FRAMES];
+volatile uint8_t etherRxWr = 0;             // advanced by etherIsr()
+volatile uint8_t etherRxRd = 0;             // advanced by getEtherPacket()
+uint16_t etherRxHead = 0;                   // pool offset of the next frame in
+volatile uint16_t etherRxTail = 0;          // pool offset after the last frame out
+volatile bool etherRxStalled = false;       // ring full, PKTIE masked until a frame is taken
+etherRxStats etherRx;
+_etherRxFilter etherRxFilter = NULL;
+uint32_t etherRxOverflowsSeen = 0;
+
+uint16_t etherTxStart[ETHER_TX_SLOTS];
+uint16_t etherTxSize[ETHER_TX_SLOTS];
+volatile uint8_t etherTxHead = 0;           // slot on the wire, or sent next
+volatile uint8_t etherTxCount = 0;          // slots written and not yet sent
+etherTxStats etherTx;
+
+bool etherChecksumOffload = false;
+etherHeader *etherTxChecksumFrame = NULL;   // set by setEtherTxChecksum()
+uint16_t etherTxChecksumStart;
+uint16_t etherTxChecksumField;
+etherHeader *etherRxChecked = NULL;         // frame getEtherPacket() returned, TCP checksum good
+
 // ------------------------------------------------------------------------------
 //  Structures
 // ------------------------------------------------------------------------------
@@ -131,8 +218,8 @@ uint8_t hwAddress[HW_ADD_LENGTH] = {2,3,4,5,6,7};
 //-----------------------------------------------------------------------------
 
 // Buffer is configured as follows
-// Receive buffer starts at 0x0000 (bottom 6666 bytes of 8K space)
-// Transmit buffer at 01A0A (top 1526 bytes of 8K space)
+// Receive buffer starts at 0x0000 (bottom 6144 bytes of 8K space)
+// Transmit area at 0x1800 (top 2048 bytes of 8K space)
 
 void enableEtherCs(void)
 {
@@ -145,6 +232,19 @@ void disableEtherCs(void)
     setPinValue(CS, 1);
 }
 
+// Keeps etherIsr() off the SPI bus (and the bank select) while the main loop
+// is talking to the ENC28J60
+void lockEther(void)
+{
+    disablePinInterrupt(INT);
+}
+
+// INT is level sensitive, so frames that arrived meanwhile are taken at once
+void unlockEther(void)
+{
+    enablePinInterrupt(INT);
+}
+
 void writeEtherReg(uint8_t reg, uint8_t data)
 {
     enableEtherCs();
@@ -231,6 +331,12 @@ void writeEtherMem(uint8_t data)
     readSpi0Data();
 }
 
+// Streams a block through the SPI FIFO under the same WBM command
+void writeEtherMemBlock(const uint8_t data[], uint16_t size)
+{
+    writeSpi0Block(data, size);
+}
+
 void stopEtherMemWrite(void)
 {
     disableEtherCs();
@@ -249,6 +355,12 @@ uint8_t readEtherMem(void)
     return readSpi0Data();
 }
 
+// Streams a block through the SPI FIFO under the same RBM command
+void readEtherMemBlock(uint8_t data[], uint16_t size)
+{
+    readSpi0Block(data, size);
+}
+
 void stopEtherMemRead(void)
 {
     disableEtherCs();
@@ -284,18 +396,20 @@ void initEther(uint16_t mode)
     setEtherBank(ERXSTL);
     writeEtherReg(ERXSTL, LOBYTE(0x0000));
     writeEtherReg(ERXSTH, HIBYTE(0x0000));
-    writeEtherReg(ERXNDL, LOBYTE(0x1A09));
-    writeEtherReg(ERXNDH, HIBYTE(0x1A09));
+    writeEtherReg(ERXNDL, LOBYTE(ETHER_RX_END));
+    writeEtherReg(ERXNDH, HIBYTE(ETHER_RX_END));
    
     // initialize receiver write and read ptrs
-    // at startup, will write from 0 to 1A08 only and will not overwrite rd ptr
+    // at startup, will write from 0 to 17FE only and will not overwrite rd ptr
     writeEtherReg(ERXWRPTL, LOBYTE(0x0000));
     writeEtherReg(ERXWRPTH, HIBYTE(0x0000));
-    writeEtherReg(ERXRDPTL, LOBYTE(0x1A09));
-    writeEtherReg(ERXRDPTH, HIBYTE(0x1A09));
+    writeEtherReg(ERXRDPTL, LOBYTE(ETHER_RX_END));
+    writeEtherReg(ERXRDPTH, HIBYTE(ETHER_RX_END));
     writeEtherReg(ERDPTL, LOBYTE(0x0000));
     writeEtherReg(ERDPTH, HIBYTE(0x0000));
 
+    setEtherChecksumOffload((mode & ETHER_CHECKSUMOFFLOAD) != 0);
+
     // setup receive filter
     // always check CRC, use OR mode
     setEtherBank(ERXFCON);
@@ -350,6 +464,15 @@ void initEther(uint16_t mode)
     // stretch LED on to 40ms (default)
     writeEtherPhy(PHLCON, 0x0472);
 
+    // interrupt on received packets, rx buffer overflows and the end of a
+    // transmission; INT is held low until etherIsr() has handled them
+    writeEtherReg(EIE, INTIE | PKTIE | RXERIE | TXIE | TXERIE);
+    selectPinInterruptLowLevel(INT);
+    enablePinInterrupt(INT);
+#ifndef HOST
+    NVIC_EN0_R |= 1 << (INT_GPIOC-16);               // turn-on interrupt 18 (GPIOC)
+#endif
+
     // enable reception
     setEtherReg(ECON1, RXEN);
 }
@@ -357,61 +480,54 @@ void initEther(uint16_t mode)
 // Returns true if link is up
 bool isEtherLinkUp(void)
 {
-    return (readEtherPhy(PHSTAT1) & LSTAT) != 0;
+    bool up;
+    lockEther();
+    up = (readEtherPhy(PHSTAT1) & LSTAT) != 0;
+    unlockEther();
+    return up;
 }
 
 // Returns TRUE if packet received
 bool isEtherDataAvailable(void)
 {
-    return ((readEtherReg(EIR) & PKTIF) != 0);
+    return etherRxRd != etherRxWr;
 }
 
-// Returns true if rx buffer overflowed after correcting the problem
+// Returns true if the rx buffer has overflowed since the last call
+// (etherIsr() corrects the problem)
 bool isEtherOverflow(void)
 {
-    bool err;
-    err = (readEtherReg(EIR) & RXERIF) != 0;
-    if (err)
-        clearEtherReg(EIR, RXERIF);
+    bool err = etherRx.overflows != etherRxOverflowsSeen;
+    etherRxOverflowsSeen = etherRx.overflows;
     return err;
 }
 
-// Returns up to max_size characters in data buffer
-// Returns number of bytes copied to buffer
-// Contents written are 16-bit size, 16-bit status, payload excl crc
-uint16_t getEtherPacket(etherHeader *ether, uint16_t maxSize)
+// Finds room in the pool for a frame, keeping frames whole
+// Returns the offset, or ETHER_RX_POOL_SIZE if the pool is full
+uint16_t getEtherRxSpace(uint16_t size)
 {
-    uint16_t i = 0, size, tmp16, status;
-    uint8_t *packet = (uint8_t*)ether;
-
-    // enable read from FIFO buffers
-    startEtherMemRead();
-
-    // get next packet information
-    nextPacketLsb = readEtherMem();
-    nextPacketMsb = readEtherMem();
-
-    // calc size
-    // don't return crc, instead return size + status, so size is correct
-    size = readEtherMem();
-    tmp16 = readEtherMem();
-    size |= (tmp16 << 8);
-
-    // get status (currently unused)
-    status = readEtherMem();
-    tmp16 = readEtherMem();
-    status |= (tmp16 << 8);
-
-    // copy data
-    if (size > maxSize)
-        size = maxSize;
-    while (i < size)
-        packet[i++] = readEtherMem();
-
-    // end read from FIFO buffers
-    stopEtherMemRead();
+    uint16_t tail;
+
+    // with the ring empty the whole pool is free
+    if (etherRxRd == etherRxWr)
+        return (etherRxHead + size <= ETHER_RX_POOL_SIZE) ? etherRxHead : 0;
+    // getEtherPacket() moves the tail before the read index, so it is current
+    tail = etherRxTail;
+    if (etherRxHead > tail)
+    {
+        if (etherRxHead + size <= ETHER_RX_POOL_SIZE)
+            return etherRxHead;
+        if (size <= tail)
+            return 0;
+    }
+    else if (size <= tail - etherRxHead)
+        return etherRxHead;
+    return ETHER_RX_POOL_SIZE;
+}
 
-    // advance read pointer
+// Moves the read pointers past the current packet and frees its space
+void skipEtherPacket(void)
+{
     setEtherBank(ERXRDPTL);
     writeEtherReg(ERXRDPTL, nextPacketLsb); // hw ptr
     writeEtherReg(ERXRDPTH, nextPacketMsb);
@@ -420,28 +536,441 @@ uint16_t getEtherPacket(etherHeader *ether, uint16_t maxSize)
 
     // decrement packet counter so that PKTIF is maintained correctly
     setEtherReg(ECON2, PKTDEC);
+}
+
+// Returns the rx buffer address offset bytes after address
+uint16_t getEtherRxAddress(uint16_t address, uint16_t offset)
+{
+    address += offset;
+    if (address > ETHER_RX_END)
+        address -= ETHER_RX_END + 1;
+    return address;
+}
+
+// Runs the DMA in checksum mode over size bytes at address (wrapping in the
+// rx buffer) and sets sum to the IP checksum, high byte first on the wire
+// A frame received while the DMA runs can corrupt the result (silicon
+// errata), so it is taken again if one was coming in as the DMA started or
+// ended (RXBUSY), or came in whole meanwhile (EPKTCNT moved).  Returns false
+// if that happened on all ETHER_DMA_TRIES runs, and sum can't be trusted
+bool getEtherDmaChecksum(uint16_t address, uint16_t size, uint16_t *sum)
+{
+    uint16_t end = address + size - 1;
+    uint8_t count, tries;
+    bool busy;
+
+    if (address <= ETHER_RX_END)
+        end = getEtherRxAddress(address, size - 1);
+    for (tries = 0; tries < ETHER_DMA_TRIES; tries++)
+    {
+        setEtherBank(EPKTCNT);
+        count = readEtherReg(EPKTCNT);
+        busy = (readEtherReg(ESTAT) & RXBUSY) != 0;
+        setEtherBank(EDMASTL);
+        writeEtherReg(EDMASTL, LOBYTE(address));
+        writeEtherReg(EDMASTH, HIBYTE(address));
+        writeEtherReg(EDMANDL, LOBYTE(end));
+        writeEtherReg(EDMANDH, HIBYTE(end));
+        setEtherReg(ECON1, CSUMEN);
+        setEtherReg(ECON1, DMAST);
+        while ((readEtherReg(ECON1) & DMAST) != 0);
+        clearEtherReg(ECON1, CSUMEN);
+        clearEtherReg(EIR, DMAIF);
+        *sum = (readEtherReg(EDMACSH) << 8) | readEtherReg(EDMACSL);
+        busy |= (readEtherReg(ESTAT) & RXBUSY) != 0;
+        setEtherBank(EPKTCNT);
+        if (!busy && readEtherReg(EPKTCNT) == count)
+            return true;
+    }
+    return false;
+}
+
+// The checksum the DMA would give of size bytes of a frame still in memory
+uint16_t sumEtherBytes(const uint8_t data[], uint16_t size)
+{
+    uint32_t sum = 0;
+    uint16_t i;
+
+    for (i = 0; i + 1 < size; i += 2)
+        sum += (data[i] << 8) | data[i + 1];
+    if (i < size)
+        sum += data[i] << 8;
+    while ((sum >> 16) != 0)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum;
+}
+
+// Returns the size of the TCP segment in a peeked frame if the DMA takes
+// its checksum, or 0
+uint16_t getEtherTcpOffloadSize(const uint8_t peek[], uint16_t peekSize, uint16_t size)
+{
+    const uint8_t *ip = ((etherHeader*)peek)->data;
+    uint16_t ipHeaderLength = (ip[0] & 0x0F) * 4;
+    uint16_t length = (ip[IP_LENGTH] << 8) | ip[IP_LENGTH + 1];
+
+    if (((etherHeader*)peek)->frameType != htons(TYPE_IP) || peekSize < sizeof(etherHeader) + 20
+        || (ip[0] >> 4) != 4 || ip[IP_PROTOCOL] != IP_PROTOCOL_TCP || ipHeaderLength < 20
+        || length <= ipHeaderLength || sizeof(etherHeader) + length > size
+        || !isEtherChecksumOffload(length - ipHeaderLength))
+        return 0;
+    return length - ipHeaderLength;
+}
+
+// Checks the TCP checksum of a frame in the rx buffer with the DMA; the
+// pseudo header comes from the peeked IP header
+// Returns true, with checked false, when the DMA result is in doubt, so the
+// segment is kept for the stack to check in software
+bool isEtherTcpChecksumOk(const uint8_t peek[], uint16_t frameAddress, uint16_t tcpLength, bool *checked)
+{
+    const uint8_t *ip = ((etherHeader*)peek)->data;
+    uint16_t ipHeaderLength = (ip[0] & 0x0F) * 4;
+    uint32_t sum = 0;
+    uint16_t dmaSum;
+    uint8_t i;
+
+    // pseudo header: addresses, protocol and TCP length
+    for (i = 0; i < 8; i += 2)
+        sum += (ip[IP_SOURCE + i] << 8) | ip[IP_SOURCE + i + 1];
+    sum += IP_PROTOCOL_TCP + tcpLength;
+
+    // the DMA checksum is the complement of the segment's sum
+    *checked = getEtherDmaChecksum(getEtherRxAddress(frameAddress, sizeof(etherHeader) + ipHeaderLength),
+                                   tcpLength, &dmaSum);
+    if (!*checked)
+        return true;
+    sum += ~dmaSum & 0xFFFF;
+    while ((sum >> 16) != 0)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return sum == 0xFFFF;
+}
+
+// Moves one packet from the ENC28J60 rx buffer to the ring
+// Only the first ETHER_PEEK_SIZE bytes are read before the filter set with
+// setEtherRxFilter() decides; the rest of a dropped frame never crosses SPI
+// With the checksum offload on, a TCP segment is checked by the DMA before
+// it is copied, and dropped if it is corrupt
+// Returns false (leaving the packet where it is) if the ring is full
+bool takeEtherPacket(void)
+{
+    uint8_t header[ETHER_RX_HEADER];
+    uint8_t peek[ETHER_PEEK_SIZE];
+    uint16_t size, peekSize, offset, tcpLength;
+    uint16_t packet = nextPacketLsb | (nextPacketMsb << 8);
+    bool tcpChecked = false;
+    etherRxFrame *frame;
+
+    if ((uint8_t)(etherRxWr - etherRxRd) == ETHER_RX_FRAMES)
+        return false;
+    startEtherMemRead();
+    readEtherMemBlock(header, sizeof(header));
+    size = header[2] | (header[3] << 8);
+    if (size > ETHER_RX_POOL_SIZE / 2)
+        size = ETHER_RX_POOL_SIZE / 2;
+    peekSize = (size < ETHER_PEEK_SIZE) ? size : ETHER_PEEK_SIZE;
+    readEtherMemBlock(peek, peekSize);
+    if (etherRxFilter != NULL && !(*etherRxFilter)((etherHeader*)peek, peekSize))
+    {
+        stopEtherMemRead();
+        nextPacketLsb = header[0];
+        nextPacketMsb = header[1];
+        skipEtherPacket();
+        etherRx.filtered++;
+        return true;
+    }
+    tcpLength = getEtherTcpOffloadSize(peek, peekSize, size);
+    if (tcpLength != 0)
+    {
+        // the read picks up after the peek again
+        stopEtherMemRead();
+        if (!isEtherTcpChecksumOk(peek, getEtherRxAddress(packet, ETHER_RX_HEADER), tcpLength, &tcpChecked))
+        {
+            nextPacketLsb = header[0];
+            nextPacketMsb = header[1];
+            skipEtherPacket();
+            etherRx.badChecksums++;
+            return true;
+        }
+        startEtherMemRead();
+    }
+    offset = getEtherRxSpace(size);
+    if (offset == ETHER_RX_POOL_SIZE)
+    {
+        // rewind to the start of the packet for the next try
+        stopEtherMemRead();
+        setEtherBank(ERDPTL);
+        writeEtherReg(ERDPTL, nextPacketLsb);
+        writeEtherReg(ERDPTH, nextPacketMsb);
+        return false;
+    }
+    memcpy(&etherRxPool[offset], peek, peekSize);
+    readEtherMemBlock(&etherRxPool[offset + peekSize], size - peekSize);
+    stopEtherMemRead();
+    nextPacketLsb = header[0];
+    nextPacketMsb = header[1];
+    skipEtherPacket();
+
+    frame = &etherRxRing[etherRxWr % ETHER_RX_FRAMES];
+    frame->offset = offset;
+    frame->size = size;
+    frame->tcpChecked = tcpChecked;
+    etherRxHead = offset + size;
+    etherRxWr++;
+    etherRx.frames++;
+    return true;
+}
+
+// Starts sending the frame in the head slot
+void startEtherTx(void)
+{
+    uint16_t start = etherTxStart[etherTxHead];
+
+    setEtherBank(ETXSTL);
+    writeEtherReg(ETXSTL, LOBYTE(start));
+    writeEtherReg(ETXSTH, HIBYTE(start));
+    writeEtherReg(ETXNDL, LOBYTE(start + etherTxSize[etherTxHead]));
+    writeEtherReg(ETXNDH, HIBYTE(start + etherTxSize[etherTxHead]));
+    setEtherReg(ECON1, TXRTS);
+}
+
+// Retires the frame on the wire once TXIF (or TXERIF) says it is done and
+// starts the one written behind it
+// Called by etherIsr(), and by putEtherPacket() while it waits for a slot
+void serviceEtherTx(void)
+{
+    uint8_t eir = readEtherReg(EIR);
+
+    if ((eir & (TXIF | TXERIF)) == 0)
+        return;
+    if ((eir & TXERIF) != 0)
+    {
+        // a late collision can leave TXRTS set; reset the transmit logic
+        setEtherReg(ECON1, TXRST);
+        clearEtherReg(ECON1, TXRST | TXRTS);
+    }
+    clearEtherReg(EIR, TXIF | TXERIF);
+    if (etherTxCount == 0)
+        return;
+    if ((readEtherReg(ESTAT) & TXABORT) != 0)
+    {
+        etherTx.aborts++;
+        clearEtherReg(ESTAT, TXABORT);
+    }
+    else
+        etherTx.frames++;
+    etherTxHead = (etherTxHead + 1) % ETHER_TX_SLOTS;
+    etherTxCount--;
+    if (etherTxCount != 0)
+        startEtherTx();
+}
+
+// INT (PC6) isr: drains received packets into the ring, so they survive
+// the main loop spending a while in other stages, and starts the next
+// transmit slot when a frame has gone out
+// When the ring is full only PKTIE is masked, leaving the remaining packets
+// in the ENC28J60 until getEtherPacket() has emptied half of it, so the
+// frames waiting to go out are still started as each one finishes
+void etherIsr(void)
+{
+    busOp op = setBusOp(BUS_OP_ETH_RX);
+    uint8_t eir = readEtherReg(EIR);
+
+    if ((eir & RXERIF) != 0)
+    {
+        etherRx.overflows++;
+        clearEtherReg(EIR, RXERIF);
+    }
+    if ((eir & (TXIF | TXERIF)) != 0)
+        serviceEtherTx();
+    setEtherBank(EPKTCNT);
+    while (!etherRxStalled && readEtherReg(EPKTCNT) != 0)
+    {
+        if (!takeEtherPacket())
+        {
+            etherRxStalled = true;
+            etherRx.stalls++;
+            clearEtherReg(EIE, PKTIE);
+        }
+        setEtherBank(EPKTCNT);
+    }
+    clearPinInterrupt(INT);
+    setBusOp(op);
+}
+
+// Selects the receive filters (ETHER_UNICAST, ETHER_PATTERNMATCH, ...), OR'ed
+// together; CRC checking stays on
+void setEtherFilterMode(uint16_t mode)
+{
+    lockEther();
+    setEtherBank(ERXFCON);
+    writeEtherReg(ERXFCON, (mode | ETHER_CHECKCRC) & 0xFF);
+    unlockEther();
+}
+
+// Sets the pattern match filter used with ETHER_PATTERNMATCH: byte i of the
+// 64 byte window starting offset bytes into the frame is compared when bit i
+// of mask is set, and has to equal pattern[i]
+// The hardware compares a checksum of the selected bytes, not the bytes
+void setEtherPatternFilter(uint16_t offset, const uint8_t pattern[ETHER_PATTERN_SIZE],
+                           const uint8_t mask[ETHER_PATTERN_SIZE / 8])
+{
+    uint32_t sum = 0;
+    bool odd = false;
+    uint8_t i;
+
+    // IP checksum of the selected bytes, taken in order as big endian words
+    for (i = 0; i < ETHER_PATTERN_SIZE; i++)
+    {
+        if ((mask[i / 8] & (1 << (i % 8))) == 0)
+            continue;
+        sum += odd ? pattern[i] : (pattern[i] << 8);
+        odd = !odd;
+    }
+    while ((sum >> 16) != 0)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = ~sum;
+
+    lockEther();
+    setEtherBank(EPMM0);
+    for (i = 0; i < ETHER_PATTERN_SIZE / 8; i++)
+        writeEtherReg(EPMM0 + i, mask[i]);
+    writeEtherReg(EPMCSL, LOBYTE(sum));
+    writeEtherReg(EPMCSH, HIBYTE(sum));
+    // the offset goes last, as writing it starts the filter on the new pattern
+    writeEtherReg(EPMOL, LOBYTE(offset));
+    writeEtherReg(EPMOH, HIBYTE(offset));
+    unlockEther();
+}
+
+// Sets the function that decides from the first ETHER_PEEK_SIZE bytes of a
+// frame whether it is wanted; NULL takes every frame
+void setEtherRxFilter(_etherRxFilter filter)
+{
+    etherRxFilter = filter;
+}
+
+// Lets the ENC28J60 DMA compute TCP checksums: received segments are
+// checked before they are copied, and calcTcpChecksum() leaves the sum of
+// a segment to putEtherPacket()
+void setEtherChecksumOffload(bool enable)
+{
+    etherChecksumOffload = enable;
+}
+
+// True if the DMA takes the checksum of a segment of size bytes
+bool isEtherChecksumOffload(uint16_t size)
+{
+    return etherChecksumOffload && size >= ETHER_CHECKSUM_MIN;
+}
+
+// Has the next putEtherPacket() of ether complete a checksum in the
+// buffer: the DMA sums the frame from byte start on, and the result goes to
+// the 16 bit field at byte field, which holds the pseudo header sum
+void setEtherTxChecksum(etherHeader *ether, uint16_t start, uint16_t field)
+{
+    etherTxChecksumFrame = ether;
+    etherTxChecksumStart = start;
+    etherTxChecksumField = field;
+}
+
+// True if ether holds the frame getEtherPacket() last returned and the DMA
+// has already verified its TCP checksum
+bool isEtherTcpChecksumVerified(etherHeader *ether)
+{
+    return ether == etherRxChecked;
+}
+
+// Returns the transmit slot counters
+void getEtherTxStats(etherTxStats *stats)
+{
+    *stats = etherTx;
+    stats->queued = etherTxCount;
+}
+
+// Returns the receive ring counters
+void getEtherRxStats(etherRxStats *stats)
+{
+    *stats = etherRx;
+    stats->queued = (uint8_t)(etherRxWr - etherRxRd);
+}
+
+// Returns up to max_size characters in data buffer
+// Returns number of bytes copied to buffer
+// Takes the oldest frame in the ring; contents are the frame incl crc
+uint16_t getEtherPacket(etherHeader *ether, uint16_t maxSize)
+{
+    etherRxFrame *frame;
+    uint16_t size;
 
+    if (etherRxRd == etherRxWr)
+        return 0;
+    frame = &etherRxRing[etherRxRd % ETHER_RX_FRAMES];
+    size = frame->size;
+    if (size > maxSize)
+        size = maxSize;
+    memcpy(ether, &etherRxPool[frame->offset], size);
+    etherRxChecked = frame->tcpChecked ? ether : NULL;
+
+    // free the frame, then let packets interrupt again if etherIsr() was
+    // waiting for room (not before half the ring is free, so it moves a
+    // batch per interrupt)
+    etherRxTail = frame->offset + frame->size;
+    etherRxRd++;
+    if (etherRxStalled && (uint8_t)(etherRxWr - etherRxRd) <= ETHER_RX_FRAMES / 2)
+    {
+        lockEther();
+        etherRxStalled = false;
+        setEtherReg(EIE, PKTIE);
+        unlockEther();
+    }
     return size;
 }
 
-// Writes a packet
+// Returns where a frame of size bytes fits in the transmit area: after the
+// frame on the wire or, failing that, before it; 0 if it has to wait
+uint16_t getEtherTxSpace(uint16_t size)
+{
+    uint16_t needed = size + ETHER_TX_OVERHEAD;
+    uint16_t start, end;
+
+    if (etherTxCount == 0)
+        return ETHER_TX_START;
+    if (etherTxCount == ETHER_TX_SLOTS)
+        return 0;
+    start = etherTxStart[etherTxHead];
+    end = start + etherTxSize[etherTxHead] + ETHER_TX_OVERHEAD;
+    if (end + needed <= ETHER_TX_END)
+        return end;
+    if (ETHER_TX_START + needed <= start)
+        return ETHER_TX_START;
+    return 0;
+}
+
+// Writes a packet to the transmit area and returns without waiting for it
+// to go out; it is sent as soon as the frame ahead of it is done
+// Only waits when there is no room beside the frame on the wire
 bool putEtherPacket(etherHeader *ether, uint16_t size)
 {
-    uint16_t i;
-    uint8_t *packet = (uint8_t*) ether;
+    busOp op = setBusOp(BUS_OP_ETH_TX);
+    uint8_t slot;
+    uint16_t start, sum;
 
-    // clear out any tx errors
-    if ((readEtherReg(EIR) & TXERIF) != 0)
+    lockEther();
+
+    // etherIsr() is masked, so poll for the end of a transmission
+    start = getEtherTxSpace(size);
+    if (start == 0)
+        etherTx.waits++;
+    while (start == 0)
     {
-        clearEtherReg(EIR, TXERIF);
-        setEtherReg(ECON1, TXRTS);
-        clearEtherReg(ECON1, TXRTS);
+        serviceEtherTx();
+        start = getEtherTxSpace(size);
     }
+    slot = (etherTxHead + etherTxCount) % ETHER_TX_SLOTS;
 
     // set DMA start address
     setEtherBank(EWRPTL);
-    writeEtherReg(EWRPTL, LOBYTE(0x1A0A));
-    writeEtherReg(EWRPTH, HIBYTE(0x1A0A));
+    writeEtherReg(EWRPTL, LOBYTE(start));
+    writeEtherReg(EWRPTH, HIBYTE(start));
 
     // start FIFO buffer write
     startEtherMemWrite();
@@ -450,25 +979,39 @@ bool putEtherPacket(etherHeader *ether, uint16_t size)
     writeEtherMem(0);
 
     // write data
-    for (i = 0; i < size; i++)
-        writeEtherMem(packet[i]);
+    writeEtherMemBlock((uint8_t*)ether, size);
 
     // stop write
     stopEtherMemWrite();
-  
-    // request transmit
-    writeEtherReg(ETXSTL, LOBYTE(0x1A0A));
-    writeEtherReg(ETXSTH, HIBYTE(0x1A0A));
-    writeEtherReg(ETXNDL, LOBYTE(0x1A0A+size));
-    writeEtherReg(ETXNDH, HIBYTE(0x1A0A+size));
-    clearEtherReg(EIR, TXIF);
-    setEtherReg(ECON1, TXRTS);
-
-    // wait for completion
-    while ((readEtherReg(ECON1) & TXRTS) != 0);
 
-    // determine success
-    return ((readEtherReg(ESTAT) & TXABORT) == 0);
+    // fill in the checksum setEtherTxChecksum() left to the DMA
+    if (ether == etherTxChecksumFrame)
+    {
+        if (!getEtherDmaChecksum(start + 1 + etherTxChecksumStart, size - etherTxChecksumStart, &sum))
+            sum = sumEtherBytes((uint8_t*)ether + etherTxChecksumStart, size - etherTxChecksumStart);
+        setEtherBank(EWRPTL);
+        writeEtherReg(EWRPTL, LOBYTE(start + 1 + etherTxChecksumField));
+        writeEtherReg(EWRPTH, HIBYTE(start + 1 + etherTxChecksumField));
+        startEtherMemWrite();
+        writeEtherMem(HIBYTE(sum));
+        writeEtherMem(LOBYTE(sum));
+        stopEtherMemWrite();
+        etherTxChecksumFrame = NULL;
+    }
+    // the buffer no longer holds the frame that was checked
+    if (ether == etherRxChecked)
+        etherRxChecked = NULL;
+
+    // request transmit, unless the other frame is still on the wire
+    etherTxStart[slot] = start;
+    etherTxSize[slot] = size;
+    etherTxCount++;
+    if (etherTxCount == 1)
+        startEtherTx();
+
+    unlockEther();
+    setBusOp(op);
+    return true;
 }
 
 // Converts from host to network order and vice versa
@@ -502,6 +1045,7 @@ void setEtherMacAddress(uint8_t mac0, uint8_t mac1, uint8_t mac2, uint8_t mac3,
     hwAddress[3] = mac3;
     hwAddress[4] = mac4;
     hwAddress[5] = mac5;
+    lockEther();
     setEtherBank(MAADR0);
     writeEtherReg(MAADR5, mac0);
     writeEtherReg(MAADR4, mac1);
@@ -509,6 +1053,7 @@ void setEtherMacAddress(uint8_t mac0, uint8_t mac1, uint8_t mac2, uint8_t mac3,
     writeEtherReg(MAADR2, mac3);
     writeEtherReg(MAADR1, mac4);
     writeEtherReg(MAADR0, mac5);
+    unlockEther();
 }
 
 // Gets MAC address
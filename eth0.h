@@ -62,6 +62,35 @@ typedef struct _etherHeader // 14 bytes
 
 #define ETHER_HALFDUPLEX     0x00
 #define ETHER_FULLDUPLEX     0x100
+#define ETHER_CHECKSUMOFFLOAD 0x200
+
+// Window of the pattern match filter
+#define ETHER_PATTERN_SIZE   64
+
+// Receive ring counters
+typedef struct _etherRxStats
+{
+  uint32_t frames;                  // taken from the ENC28J60
+  uint32_t filtered;                // dropped by the rx filter after the peek
+  uint32_t badChecksums;            // TCP checksum failed in the DMA, not copied
+  uint32_t stalls;                  // ring full, frames left waiting in the ENC28J60
+  uint32_t overflows;               // ENC28J60 rx buffer full, frames lost
+  uint8_t queued;                   // frames waiting in the ring now
+} etherRxStats;
+
+// Transmit slot counters
+typedef struct _etherTxStats
+{
+  uint32_t frames;                  // sent
+  uint32_t aborts;                  // given up by the ENC28J60 (collisions)
+  uint32_t waits;                   // both slots busy, putEtherPacket() had to wait
+  uint8_t queued;                   // frames waiting in the ENC28J60 now
+} etherTxStats;
+
+// Bytes of a received frame the rx filter sees (ethernet, IP and TCP headers)
+#define ETHER_PEEK_SIZE 54
+
+typedef bool (*_etherRxFilter)(etherHeader *ether, uint16_t size);
 
 #define LOBYTE(x) ((x) & 0xFF)
 #define HIBYTE(x) (((x) >> 8) & 0xFF)
@@ -77,6 +106,16 @@ bool isEtherDataAvailable(void);
 bool isEtherOverflow(void);
 uint16_t getEtherPacket(etherHeader *Ether, uint16_t maxSize);
 bool putEtherPacket(etherHeader *Ether, uint16_t size);
+void setEtherFilterMode(uint16_t mode);
+void setEtherPatternFilter(uint16_t offset, const uint8_t pattern[ETHER_PATTERN_SIZE],
+                           const uint8_t mask[ETHER_PATTERN_SIZE / 8]);
+void setEtherRxFilter(_etherRxFilter filter);
+void getEtherRxStats(etherRxStats *stats);
+void getEtherTxStats(etherTxStats *stats);
+void setEtherChecksumOffload(bool enable);
+bool isEtherChecksumOffload(uint16_t size);
+void setEtherTxChecksum(etherHeader *ether, uint16_t start, uint16_t field);
+bool isEtherTcpChecksumVerified(etherHeader *ether);
 
 void setEtherMacAddress(uint8_t mac0, uint8_t mac1, uint8_t mac2, uint8_t mac3, uint8_t mac4, uint8_t mac5);
 void getEtherMacAddress(uint8_t mac[6]);
@@ -39,7 +39,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
-#include "tm4c123gh6pm.h"
+#include "hal.h"
 #include "clock.h"
 #include "eeprom.h"
 #include "gpio.h"
@@ -53,9 +53,12 @@
 #include "icmp.h"
 #include "udp.h"
 #include "tcp.h"
+#include "packet.h"
 #include "mqtt.h"
 #include "wireless.h"
 #include "hashTable.h"
+#include "busStats.h"
+#include "perfStats.h"
 
 // Pins
 #define RED_LED PORTF,1
@@ -77,11 +80,11 @@
 // Ether frame header (18) + Max MTU (1500) + CRC (4)
 #define MAX_PACKET_SIZE 1522
 
-#define MAX_SOCKETS 5
+#define MAX_SOCKETS 32
 #define MAX_TOPICS 20
 
-#define MAX_ARP_TIMEOUT 5
-#define MAX_TCP_HANDSHAKE_TIMEOUT 5
+// PUBLISH of a device's topic and message, both up to 30 bytes
+#define MAX_DEVICE_PUB_SIZE (5 + 2 * 30)
 
 #define MQTT_DEFAULT_CONFIG_NARGS 1
 #define MQTT_DEFAULT_N_TOPICS 3
@@ -100,13 +103,12 @@
 socket sockets[MAX_SOCKETS];
 topic topics[MAX_TOPICS] = {""};
 uint32_t pingTime;
+// MQTT packets read out of each socket's byte stream
+mqttReader mqttStreams[MAX_SOCKETS];
 
 //-----------------------------------------------------------------------------
 // Flags                
 //-----------------------------------------------------------------------------
-uint8_t gf_arp_send_request;
-uint8_t gf_rx_arp;
-
 uint8_t gf_send_ping;
 uint8_t gf_rx_ping;
 
@@ -116,7 +118,6 @@ uint8_t gf_tcp_send_ack;
 uint8_t gf_disconnect;
 uint8_t gf_tcp_send_fin;
 uint8_t gf_rx_lastAck;
-uint8_t gf_tcp_rx_synack;
 
 // MQTT Flags
 uint8_t gf_mqtt_connect;
@@ -144,6 +145,7 @@ void deleteSocket(socket *s)
 {
     uint8_t i;
 
+    removeTcpSocket(sockets, s - sockets);
     for(i = 0; i < HW_ADD_LENGTH; i++)
         s->remoteHwAddress[i] = 0;
     for(i = 0; i < IP_ADD_LENGTH; i++)
@@ -152,6 +154,10 @@ void deleteSocket(socket *s)
     s->remotePort = 0;
     s->id = 0;
     s->state = 0;
+    s->headerValid = false;
+    cancelArpQueued(s - sockets);
+    clearTcpQueue(s);
+    resetMqttReader(&mqttStreams[s - sockets]);
 }
 
 
@@ -163,77 +169,83 @@ void closeSocketCallback()
     gf_close_socket = 0;
 }
 
-void tcpHandshakeTimeoutCallback()
+void setSocketHwAddress(socket *s, const uint8_t hwAddress[6])
 {
-    static uint8_t count = 0;
-    if(!gf_tcp_rx_synack || gf_tcp_send_syn)
-        return;
+    uint8_t i;
+    uint8_t mqtt_ip[4];
+    uint8_t gw_ip[4];
+    getIpMqttBrokerAddress(mqtt_ip);
+    getIpGatewayAddress(gw_ip);
 
-    count++;
-    if(count >= MAX_TCP_HANDSHAKE_TIMEOUT)
-    {
-        putsUart0("Unable to connect");
-        putcUart0('\n');
-        deleteSocket(&(sockets[gf_rx_arp]));
-        gf_mqtt_connect_default = 0;
-        gf_mqtt_connect = 0;
-        gf_tcp_rx_synack = 0;
-        count = 0;
-    }
-    else
+    // the table is keyed on the remote ip, which may change below
+    removeTcpSocket(sockets, s - sockets);
+    for (i = 0; i < HW_ADD_LENGTH; i++)
+        s->remoteHwAddress[i] = hwAddress[i];
+
+    // a broker off the link is reached through the gateway's address
+    if(memcmp(s->remoteIpAddress, gw_ip, sizeof(gw_ip)) == 0)
     {
-        restartTimer(tcpHandshakeTimeoutCallback);
-        gf_tcp_send_syn = gf_tcp_rx_synack;
-        gf_tcp_rx_synack = 0;
-        putsUart0("Tcp timeout\n");
+        for(i = 0; i < IP_ADD_LENGTH; i++)
+        {
+             s->remoteIpAddress[i] = mqtt_ip[i];
+        }
     }
+    // the socket is fully addressed now, so its segments' headers are fixed
+    // and the segments it receives can find it
+    setTcpHeaderTemplate(s);
+    if (s->id == PROTOCOL_TCP)
+        addTcpSocket(sockets, s - sockets);
 }
 
-void arpRequestTimeoutCallback()
+// Connects a socket again from the SYN, and MQTT over it if it is the
+// broker's, after the peer reset it or stopped acknowledging
+void reconnectSocket(uint8_t socketNum)
 {
-    static uint8_t count = 0;
-    if(!gf_rx_arp || gf_arp_send_request)
-        return;
+    socket *s = &(sockets[socketNum]);
+
+    clearTcpQueue(s);
+    resetMqttReader(&mqttStreams[socketNum]);
+    resetSocket(s);
+    initTcpSocket(s);
+    setTcpState(s, TCP_SYN_SENT);
+    gf_tcp_send_syn = socketNum;
+    if(isMqttSocket(s))
+        gf_mqtt_connect_default = socketNum;
+}
 
-    count++;
-    if(count >= MAX_ARP_TIMEOUT)
+// Starts a socket whose remote hardware address is now known (arpState is
+// ARP_RESOLVED), or drops it if ARP gave up on it
+void finishSocketArp(uint8_t socketNum, uint8_t arpState, const uint8_t hwAddress[6])
+{
+    if (arpState != ARP_RESOLVED)
     {
         putsUart0("Unable to reach ip");
         putcUart0('\n');
-        deleteSocket(&(sockets[gf_rx_arp]));
+        deleteSocket(&(sockets[socketNum]));
         gf_mqtt_connect_default = 0;
         gf_mqtt_connect = 0;
-        gf_rx_arp = 0;
-        count = 0;
+        return;
     }
-    else
+    setSocketHwAddress(&(sockets[socketNum]), hwAddress);
+    switch(sockets[socketNum].id)
     {
-        restartTimer(arpRequestTimeoutCallback);
-        gf_arp_send_request = gf_rx_arp;
-        gf_rx_arp = 0;
-        putsUart0("Arp timeout\n");
+        case PROTOCOL_TCP:
+            gf_tcp_send_syn = socketNum;
+            break;
+        case PROTOCOL_ICMP:
+            gf_send_ping = socketNum;
+            break;
     }
 }
 
-void setSocketHwAddress(etherHeader *ether, socket *s)
+// Starts a socket towards its remote ip: at once if the ARP cache has it,
+// otherwise once the request processArpCache() sends for it is answered
+void resolveSocket(uint8_t socketNum)
 {
-    arpPacket *arp = (arpPacket*)(ether->data);
-    uint8_t i;
-    uint8_t mqtt_ip[4];
-    uint8_t gw_ip[4];
-    getIpMqttBrokerAddress(mqtt_ip);
-    getIpGatewayAddress(gw_ip);
-
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-        s->remoteHwAddress[i] = arp->sourceAddress[i];
-
-    if(memcmp(arp->sourceIp, gw_ip, sizeof(arp->sourceIp)) == 0)
-    {
-        for(i = 0; i < IP_ADD_LENGTH; i++)
-        {
-             s->remoteIpAddress[i] = mqtt_ip[i];
-        }
-    }
+    uint8_t hwAddress[6];
+    uint8_t arpState = resolveArp(sockets[socketNum].remoteIpAddress, hwAddress, socketNum);
+    if (arpState != ARP_PENDING)
+        finishSocketArp(socketNum, arpState, hwAddress);
 }
 
 void removeDelimiters(char *input, char* output, char *delimiters)
@@ -256,6 +268,21 @@ void removeDelimiters(char *input, char* output, char *delimiters)
     output[k] = '\0';
 }
 
+// Picks a local port from the dynamic range (RFC 6335) that no socket
+// has, so no two connections share their addresses and ports
+uint16_t getLocalPort(socket *s, uint8_t socketCount)
+{
+    uint16_t port;
+    uint8_t i;
+
+    do
+    {
+        port = 49152 + (random32() & 0x3FFF);
+        for (i = 0; i < socketCount && s[i].localPort != port; i++);
+    } while (i < socketCount);
+    return port;
+}
+
 uint8_t createSocket(uint16_t protocol, socket *s, uint8_t socketCount, uint8_t remote_ip[4], uint16_t remote_port)
 {
     uint8_t i;
@@ -274,13 +301,12 @@ uint8_t createSocket(uint16_t protocol, socket *s, uint8_t socketCount, uint8_t
     // Make local port
     for(i = 0; i < IP_ADD_LENGTH; i++)
         s[socketNum].remoteIpAddress[i] = remote_ip[i];
-    uint16_t temp = random32() & 0xFFFF;
-    temp &= ~0xF;
-    temp |= socketNum;
-    s[socketNum].localPort = temp;
+    s[socketNum].localPort = getLocalPort(s, socketCount);
     s[socketNum].remotePort = remote_port;
     s[socketNum].state = 0;
     s[socketNum].id = protocol;
+    s[socketNum].headerValid = false;
+    initTcpSocket(&s[socketNum]);
     return socketNum;
 }
 
@@ -307,15 +333,50 @@ void initHw()
 
 initDefaultTimers()
 {
-    startOneshotTimer(arpRequestTimeoutCallback, 1);
-    startOneshotTimer(tcpHandshakeTimeoutCallback, 3);
     startOneshotTimer(closeSocketCallback, 2);
 }
 
+// Receive filter run on the first ETHER_PEEK_SIZE bytes of each frame, so
+// frames the loop below would ignore are dropped before the rest is read:
+// ARP requests for this ip and ARP responses, and IP unicast to this ip
+bool isEtherFrameWanted(etherHeader *ether, uint16_t size)
+{
+    if (size < sizeof(etherHeader) + sizeof(ipHeader))
+        return false;
+    if (ether->frameType == htons(TYPE_ARP))
+        return isArpRequest(ether) || isArpResponse(ether);
+    if (ether->frameType == htons(TYPE_IP))
+        return isIpUnicast(ether);
+    return false;
+}
+
+// Programs the ENC28J60 receive filters: unicast to this MAC, and through
+// the pattern match filter broadcasts only if they are ARP for this ip, so
+// other broadcasts are dropped before they reach the rx buffer
+// The window starts at the frame, so it fits in the smallest frame (64 bytes)
+void setEtherFilters()
+{
+    uint8_t pattern[ETHER_PATTERN_SIZE] = {0};
+    uint8_t mask[ETHER_PATTERN_SIZE / 8] = {0};
+    uint8_t i;
+
+    pattern[12] = HIBYTE(TYPE_ARP);                 // frame type
+    pattern[13] = LOBYTE(TYPE_ARP);
+    getIpAddress(&pattern[38]);                     // arp target ip
+    for (i = 0; i < ETHER_PATTERN_SIZE; i++)
+        if (i == 12 || i == 13 || (i >= 38 && i < 38 + IP_ADD_LENGTH))
+            mask[i / 8] |= 1 << (i % 8);
+    setEtherPatternFilter(0, pattern, mask);
+    setEtherFilterMode(ETHER_UNICAST | ETHER_PATTERNMATCH);
+}
+
 void displayConnectionInfo()
 {
     uint8_t i;
     char str[10];
+    char rxStr[140];
+    etherRxStats rx;
+    etherTxStats tx;
     uint8_t mac[6];
     uint8_t ip[4];
     getEtherMacAddress(mac);
@@ -393,6 +454,15 @@ void displayConnectionInfo()
         putsUart0("Link is up\n");
     else
         putsUart0("Link is down\n");
+    getEtherRxStats(&rx);
+    snprintf(rxStr, sizeof(rxStr), "  RX:    %lu frames, %lu filtered, %lu bad checksums, %lu ring full, %lu overflows, %u queued\n",
+             (unsigned long)rx.frames, (unsigned long)rx.filtered, (unsigned long)rx.badChecksums,
+             (unsigned long)rx.stalls, (unsigned long)rx.overflows, rx.queued);
+    putsUart0(rxStr);
+    getEtherTxStats(&tx);
+    snprintf(rxStr, sizeof(rxStr), "  TX:    %lu frames, %lu aborted, %lu slot waits, %u queued\n",
+             (unsigned long)tx.frames, (unsigned long)tx.aborts, (unsigned long)tx.waits, tx.queued);
+    putsUart0(rxStr);
 }
 
 void readConfiguration()
@@ -540,6 +610,8 @@ void processShell()
             strInput[count] = '\0';
             count = 0;
             token = strtok(strInput, " ");
+            if (token == NULL)                  // empty line
+                token = "";
             if(strcmp(token, "macs") == 0)
             {
                 snprintf(bufferTemp, 80, "%s", "\nDevice Number\t\tDevice MAC Address\n");
@@ -758,7 +830,7 @@ void processShell()
             }
             if (strcmp(token, "reboot") == 0)
             {
-                NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
+                resetSystem();
             }
             if (strcmp(token, "set") == 0)
             {
@@ -771,6 +843,9 @@ void processShell()
                         ip[i] = asciiToUint8(token);
                     }
                     setIpAddress(ip);
+                    setEtherFilters();
+                    for (i = 0; i < MAX_SOCKETS; i++)
+                        sockets[i].headerValid = false;
                     p32 = (uint32_t*)ip;
                     writeEeprom(EEPROM_IP, *p32);
                 }
@@ -834,13 +909,38 @@ void processShell()
             {
                 putsUart0("Commands:\r");
                 putsUart0("  ifconfig\r");
+                putsUart0("  arp (ARP cache)\r");
+                putsUart0("  status (TCP round trip times and retransmissions)\r");
                 putsUart0("  reboot\r");
                 putsUart0("  set ip | gw | dns | time | mqtt | sn w.x.y.z\r");
                 putsUart0("  macs (print assigned device MACs)\r");
+                putsUart0("  bus [reset] (bytes per bus and operation)\r");
+                putsUart0("  perf [reset] (cycles per main loop stage)\r");
             }
             if (strcmp(token, "status") == 0)
             {
-                putsUart0("Prints status\n");
+                printTcpStatus(sockets, MAX_SOCKETS);
+                printMqttStatus();
+            }
+            if (strcmp(token, "arp") == 0)
+            {
+                printArpCache();
+            }
+            if (strcmp(token, "bus") == 0)
+            {
+                char *arg = strtok(NULL, " ");
+                if (arg != NULL && strcmp(arg, "reset") == 0)
+                    resetBusStats();
+                else
+                    printBusStats();
+            }
+            if (strcmp(token, "perf") == 0)
+            {
+                char *arg = strtok(NULL, " ");
+                if (arg != NULL && strcmp(arg, "reset") == 0)
+                    resetPerfStats();
+                else
+                    printPerfStats();
             }
             if (strcmp(token, "ping1") == 0)
             {
@@ -853,8 +953,7 @@ void processShell()
                 uint8_t socketNum = createSocket(PROTOCOL_ICMP, sockets, MAX_SOCKETS, remote_ip, 0);
                 if(socketNum < MAX_SOCKETS)
                 {
-                    restartTimer(arpRequestTimeoutCallback);
-                    gf_arp_send_request = socketNum;
+                    resolveSocket(socketNum);
                 }
                 else
                 {
@@ -878,8 +977,7 @@ void processShell()
                 if(socketNum < MAX_SOCKETS)
                 {
                     setTcpState(&(sockets[socketNum]), TCP_SYN_SENT);
-                    restartTimer(arpRequestTimeoutCallback);
-                    gf_arp_send_request = socketNum;
+                    resolveSocket(socketNum);
                 }
                 else
                 {
@@ -1115,9 +1213,8 @@ void processShell()
                 if(socketNum < MAX_SOCKETS)
                 {
                     setTcpState(&(sockets[socketNum]), TCP_SYN_SENT);
-                    restartTimer(arpRequestTimeoutCallback);
-                    gf_arp_send_request = socketNum;
                     gf_mqtt_connect = socketNum;
+                    resolveSocket(socketNum);
                 }
                 else
                 {
@@ -1236,7 +1333,10 @@ void processTransmission()
 {
     uint8_t buffer[MAX_PACKET_SIZE];
     etherHeader *data = (etherHeader*) buffer;
-    uint8_t local_ip[4];
+    uint8_t hwAddress[6];
+    uint8_t socketNum;
+    uint8_t arpState;
+    socket *s;
     
     if (gf_send_ping)
     {
@@ -1245,40 +1345,54 @@ void processTransmission()
         gf_rx_ping = gf_send_ping;
         gf_send_ping = 0;
     }
-    if (gf_arp_send_request)
+    // ARP requests and replies for the sockets waiting on them
+    processArpCache(data);
+    while ((arpState = getArpQueued(&socketNum, hwAddress)) != ARP_FREE)
+        finishSocketArp(socketNum, arpState, hwAddress);
+    // data the peer's window has opened for, and retransmissions, the SYN's
+    // included
+    s = processTcpQueue(data);
+    if (s != NULL && s->state == TCP_SYN_SENT)
+    {
+        putsUart0("Unable to connect\n");
+        deleteSocket(s);
+        gf_mqtt_connect_default = 0;
+        gf_mqtt_connect = 0;
+    }
+    else if (s != NULL)
     {
-        getIpAddress(local_ip);
-        sendArpRequest(data, local_ip, sockets[gf_arp_send_request].remoteIpAddress);
-        gf_rx_arp = gf_arp_send_request;
-        gf_arp_send_request = 0;
+        putsUart0("Tcp retransmission timeout\n");
+        sendTcpMessage(data, s, RST, NULL, 0);
+        reconnectSocket(s - sockets);
     }
+    // the SYN waits for room in the send buffer like data
     if (gf_tcp_send_syn)
     {
-        sendTcpMessage(data, sockets[gf_tcp_send_syn], SYN, NULL, 0);
-        restartTimer(tcpHandshakeTimeoutCallback);
-        gf_tcp_rx_synack = gf_tcp_send_syn;
-        gf_tcp_send_syn = 0;
+        if (sendTcpMessage(data, &(sockets[gf_tcp_send_syn]), SYN, NULL, 0))
+            gf_tcp_send_syn = 0;
     }
     if (gf_tcp_send_ack)
     {
-        sendTcpMessage(data, sockets[gf_tcp_send_ack], ACK, NULL, 0);
+        sendTcpMessage(data, &(sockets[gf_tcp_send_ack]), ACK, NULL, 0);
         gf_tcp_send_ack = 0;
     }
+    // an MQTT flag stays set until the send buffer takes the message
     if (gf_mqtt_subscribe)
     {
-        if(sockets[gf_mqtt_subscribe].state == TCP_ESTABLISHED)
-        {
-            // mqttSubscribe(data, sockets[gf_mqtt_subscribe], mqttFlags, &(mqttMessages[0]), nargs);
-            sendMqttMessage(data, sockets[gf_mqtt_subscribe], SUBSCRIBE, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs);
-        }
-        gf_mqtt_subscribe = 0;
+        // mqttSubscribe(data, sockets[gf_mqtt_subscribe], mqttFlags, &(mqttMessages[0]), nargs);
+        if(sockets[gf_mqtt_subscribe].state != TCP_ESTABLISHED)
+            gf_mqtt_subscribe = 0;
+        else if(sendMqttMessage(data, &(sockets[gf_mqtt_subscribe]), SUBSCRIBE, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs))
+            gf_mqtt_subscribe = 0;
     }
     if (gf_mqtt_subscribe_caps && numOfSubCaps)
     {
         mqttFlags = 0;
-        gf_mqtt_rx_suback = addTopic(subTopicQueue[numOfSubCaps - 1], topics, MAX_TOPICS);
-        sendMqttMessage(data, sockets[gf_mqtt_subscribe_caps], SUBSCRIBE, mqttFlags, (void *)subTopicQueue[numOfSubCaps - 1], 30, 1);
-        numOfSubCaps--;
+        if(sendMqttMessage(data, &(sockets[gf_mqtt_subscribe_caps]), SUBSCRIBE, mqttFlags, (void *)subTopicQueue[numOfSubCaps - 1], 30, 1))
+        {
+            gf_mqtt_rx_suback = addTopic(subTopicQueue[numOfSubCaps - 1], topics, MAX_TOPICS);
+            numOfSubCaps--;
+        }
     }
     if (gf_mqtt_subscribe_default)
     {
@@ -1299,36 +1413,37 @@ void processTransmission()
                 return;
             }
 
-            sendMqttMessage(data, sockets[gf_mqtt_subscribe_default], SUBSCRIBE, mqttFlags, (void *)(topics[j++].name), MAX_CHARS, 1);
-            gf_mqtt_rx_suback_default = gf_mqtt_subscribe_default;
-            gf_mqtt_subscribe_default = 0;
+            if(sendMqttMessage(data, &(sockets[gf_mqtt_subscribe_default]), SUBSCRIBE, mqttFlags, (void *)(topics[j].name), MAX_CHARS, 1))
+            {
+                j++;
+                gf_mqtt_rx_suback_default = gf_mqtt_subscribe_default;
+                gf_mqtt_subscribe_default = 0;
+            }
         }
     }
     if (gf_mqtt_unsubscribe)
     {
-        if(sockets[gf_mqtt_unsubscribe].state == TCP_ESTABLISHED)
-        {
-            sendMqttMessage(data, sockets[gf_mqtt_unsubscribe], UNSUBSCRIBE, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs);
-        }
-        gf_mqtt_unsubscribe = 0;
+        if(sockets[gf_mqtt_unsubscribe].state != TCP_ESTABLISHED)
+            gf_mqtt_unsubscribe = 0;
+        else if(sendMqttMessage(data, &(sockets[gf_mqtt_unsubscribe]), UNSUBSCRIBE, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs))
+            gf_mqtt_unsubscribe = 0;
     }
     if (gf_mqtt_publish)
     {
-        if(sockets[gf_mqtt_publish].state == TCP_ESTABLISHED)
-        {
-            // mqttPublish(data, sockets[gf_mqtt_publish], mqttFlags, &(mqttMessages[0]), nargs);
-            sendMqttMessage(data, sockets[gf_mqtt_publish], PUBLISH, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs);
-        }
-        gf_mqtt_publish = 0;
+        // mqttPublish(data, sockets[gf_mqtt_publish], mqttFlags, &(mqttMessages[0]), nargs);
+        if(sockets[gf_mqtt_publish].state != TCP_ESTABLISHED)
+            gf_mqtt_publish = 0;
+        else if(sendMqttMessage(data, &(sockets[gf_mqtt_publish]), PUBLISH, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs))
+            gf_mqtt_publish = 0;
     }
     if (gf_tcp_send_fin)
     {
-        sendTcpMessage(data, sockets[gf_tcp_send_fin], FIN, NULL, 0);
+        sendTcpMessage(data, &(sockets[gf_tcp_send_fin]), FIN, NULL, 0);
         gf_tcp_send_fin = 0;
     }
     if (gf_tcp_send_finack)
     {
-        sendTcpMessage(data, sockets[gf_tcp_send_finack], (FIN | ACK), NULL, 0);
+        sendTcpMessage(data, &(sockets[gf_tcp_send_finack]), (FIN | ACK), NULL, 0);
         gf_rx_lastAck = gf_tcp_send_finack;
         gf_tcp_send_finack = 0;
     }
@@ -1336,12 +1451,12 @@ void processTransmission()
     {
         if (sockets[gf_disconnect].state == TCP_CLOSE_WAIT)
         {
-            sendTcpMessage(data, sockets[gf_disconnect], FIN, NULL, 0);
+            sendTcpMessage(data, &(sockets[gf_disconnect]), FIN, NULL, 0);
             gf_rx_lastAck = gf_disconnect;
         }
         if (sockets[gf_disconnect].state == TCP_FIN_WAIT_2)
         {
-            sendTcpMessage(data, sockets[gf_disconnect], ACK, NULL, 0);
+            sendTcpMessage(data, &(sockets[gf_disconnect]), ACK, NULL, 0);
         }
         putsUart0("Socket closed\n");
         deleteSocket(&(sockets[gf_disconnect]));
@@ -1349,30 +1464,32 @@ void processTransmission()
     }
     if (gf_mqtt_disconnect)
     {
-        if(sockets[gf_mqtt_disconnect].state == TCP_ESTABLISHED)
-        {
-            sendMqttMessage(data, sockets[gf_mqtt_disconnect], DISCONNECT, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs);
-        }
-        gf_mqtt_disconnect = 0;
+        if(sockets[gf_mqtt_disconnect].state != TCP_ESTABLISHED)
+            gf_mqtt_disconnect = 0;
+        else if(sendMqttMessage(data, &(sockets[gf_mqtt_disconnect]), DISCONNECT, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs))
+            gf_mqtt_disconnect = 0;
     }
     if (gf_mqtt_connect)
     {
         if(sockets[gf_mqtt_connect].state == TCP_ESTABLISHED)
         {
-            putsUart0("Sending mqtt connect\n");
             // mqttConnect(data, sockets[gf_mqtt_connect], mqttFlags, &(mqttMessages[0]), nargs);
-            sendMqttMessage(data, sockets[gf_mqtt_connect], CONNECT, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs);
-            gf_mqtt_rx_connack = gf_mqtt_connect;
-            gf_mqtt_connect = 0;
+            if(sendMqttMessage(data, &(sockets[gf_mqtt_connect]), CONNECT, mqttFlags, (void *)mqttMessages, MAX_CHARS, nargs))
+            {
+                putsUart0("Sending mqtt connect\n");
+                gf_mqtt_rx_connack = gf_mqtt_connect;
+                gf_mqtt_connect = 0;
+            }
         }
     }
-    if(gf_mqtt_device_pub)
+    // the message stays in the buffer until the send buffer has room for it
+    if(gf_mqtt_device_pub && getTcpSendSpace(&(sockets[gf_mqtt_device_pub])) >= MAX_DEVICE_PUB_SIZE)
     {
         char publishMsg[2][30];
         bool isValidRead = readPubMsgBuffer(&publishMsg);
         if(isValidRead)
         {
-            sendMqttMessage(data, sockets[gf_mqtt_device_pub], PUBLISH, mqttFlags, (void *)publishMsg, 30, 2);
+            sendMqttMessage(data, &(sockets[gf_mqtt_device_pub]), PUBLISH, mqttFlags, (void *)publishMsg, 30, 2);
             // if(isPubMsgBufferEmpty())
                 gf_mqtt_device_pub = 0;
         }
@@ -1384,7 +1501,7 @@ void processTransmission()
     {
         if(sockets[gf_mqtt_connect_default].state == TCP_ESTABLISHED)
         {
-            putsUart0("Sending mqtt connect\n");
+            bool sent;
             if(checkRemoteBrokerAddress())
             {
                 mqttFlags = 192;
@@ -1395,15 +1512,21 @@ void processTransmission()
                 strncpy(mqttMessages[1], IO_USRNAME, strlen(IO_USRNAME));
                 strncpy(mqttMessages[2], IO_KEY, strlen(IO_KEY));
 
-                sendMqttMessage(data, sockets[gf_mqtt_connect_default], CONNECT, mqttFlags, (void *)mqttMessages, MAX_CHARS, 3);
+                sent = sendMqttMessage(data, &(sockets[gf_mqtt_connect_default]), CONNECT, mqttFlags, (void *)mqttMessages, MAX_CHARS, 3);
             }
             else
             // mqttConnect(data, sockets[gf_mqtt_connect], mqttFlags, &(mqttMessages[0]), nargs);
-                sendMqttMessage(data, sockets[gf_mqtt_connect_default], CONNECT, mqttFlags, (void *)MQTT_DEFAULT_CONFIG, MAX_CHARS, MQTT_DEFAULT_CONFIG_NARGS);
-            gf_mqtt_rx_connack = gf_mqtt_connect_default;
-            gf_mqtt_connect_default = 0;
+                sent = sendMqttMessage(data, &(sockets[gf_mqtt_connect_default]), CONNECT, mqttFlags, (void *)MQTT_DEFAULT_CONFIG, MAX_CHARS, MQTT_DEFAULT_CONFIG_NARGS);
+            if(sent)
+            {
+                putsUart0("Sending mqtt connect\n");
+                gf_mqtt_rx_connack = gf_mqtt_connect_default;
+                gf_mqtt_connect_default = 0;
+            }
         }
     }
+    // received data no segment above has acknowledged
+    processTcpAcks(data, sockets, MAX_SOCKETS);
 }
 
 connectMqttBroker()
@@ -1420,10 +1543,117 @@ connectMqttBroker()
     //getIpMqttBrokerAddress(mqtt_address);
     uint8_t socketNum = createSocket(PROTOCOL_TCP, sockets, MAX_SOCKETS, ip_address, MQTT_PORT);
     setTcpState(&(sockets[socketNum]), TCP_SYN_SENT);
-    restartTimer(arpRequestTimeoutCallback);
-    gf_arp_send_request = socketNum;
     gf_mqtt_connect_default = socketNum;
+    resolveSocket(socketNum);
+}
+// Acts on an MQTT packet received on a socket
+void processMqttPacket(uint8_t *packet)
+{
+    uint8_t mqttFlags = getMqttFlags(packet);
+    uint8_t *mqttData = getMqttData(packet);
+    uint8_t *mqttMessage;
+    uint16_t topicLength;
+
+    switch(mqttFlags)
+    {
+        case CONNACK:
+            if(gf_mqtt_rx_connack)
+            {
+                if(mqttData[1] == 0)
+                {
+                    putsUart0("Connected\n");
+                    //gf_mqtt_subscribe_default = gf_mqtt_rx_connack;
+                    setMqttBrokerSocketIndex(gf_mqtt_rx_connack);
+                }
+                else
+                {
+                    putsUart0("MQTT connection refused\nReturned: ");
+                    putcUart0(mqttData[1] + '0');
+                    putsUart0("\n");
+                    deleteSocket(&(sockets[gf_mqtt_rx_connack]));
+                }
+                gf_mqtt_rx_connack = 0;
+            }
+            break;
+        case SUBACK:
+            if(gf_mqtt_rx_suback)
+            {
+                putsUart0("Subscribed to ");
+                putsUart0(topics[gf_mqtt_rx_suback].name);
+                putcUart0('\n');
+                gf_mqtt_rx_suback = 0;
+            }
+            else if(gf_mqtt_rx_suback_default)
+            {
+                putsUart0("Subscribed to default topics\n");
+                gf_mqtt_subscribe_default = gf_mqtt_rx_suback_default;
+                gf_mqtt_rx_suback_default = 0;
+            }
+            break;
+        case UNSUBACK:
+            if(gf_mqtt_rx_unsuback)
+            {
+                putsUart0("Unsubscribed from ");
+                putsUart0(topics[gf_mqtt_rx_unsuback].name);
+                putcUart0('\n');
+                // removeTopic(gf_mqtt_rx_unsuback, topics);
+                gf_mqtt_rx_unsuback = 0;
+            }
+            break;
+        case PUBLISH:
+            // Extract topic information and msg from publish
+            topicLength = (mqttData[0] << 8) + mqttData[1];
+            char shortTopicName[6] = {0};
+            // 0012 uta_iot/feed/mtrsp
+            // 0 1  0123456789ABC
+            strncpy(shortTopicName, (char *)&mqttData[2 + topicLength - 5], 5);
+            uint16_t msgLength = getMqttMessageLength(packet);
+            mqttMessage = getMqttMessage(packet);
+            pushMessage pshMsg;
+            strncpy(pshMsg.topicName, shortTopicName, 5);
+            if (msgLength > sizeof(pshMsg.topicMessage) - 1)
+                msgLength = sizeof(pshMsg.topicMessage) - 1;
+            strncpy(pshMsg.topicMessage, (char *)mqttMessage, msgLength);
+            pshMsg.topicMessage[msgLength] = '\0';
+
+            setPushFlag(true);
+            MQTTBinding binding[3];
+            MQTTBinding *bindingPtr[] = {&binding[0], &binding[1], &binding[2]};
+            MQTTBinding *isDevicePresent = mqtt_binding_table_get(bindingPtr, 3, shortTopicName);
+
+            if(isDevicePresent != NULL)
+            {
+                // if(binding[0].dirtyBit == 1)
+                queuePushMsg(&pshMsg, (binding[0].client_id[6]) - '0');
+                // if(isOverflow)
+                //     putsUart0("Push Message Buffer overload\n");
+
+            }
+            break;
+    }
 }
+
+// Hands every MQTT packet the last segment received on the socket completed
+// to processMqttPacket.  What the reader leaves while it waits for a packet
+// buffer stays unacknowledged, and the broker sends it again
+void readMqttSocket(uint8_t socketNumber)
+{
+    uint8_t *data;
+    uint8_t *packet;
+    uint16_t size;
+
+    while ((size = readTcpStream(&(sockets[socketNumber]), &data)) != 0)
+    {
+        while ((packet = readMqttPacket(&mqttStreams[socketNumber], &data, &size)) != NULL)
+            processMqttPacket(packet);
+        if (size != 0)
+        {
+            unreadTcpStream(&(sockets[socketNumber]), size);
+            break;
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Main
 //-----------------------------------------------------------------------------
@@ -1432,13 +1662,12 @@ int main(void)
 {
     char str[32];
     uint8_t *udpData;
-    uint8_t *tcpData; 
-    uint8_t *mqttMessage;
-    uint16_t topicLength;
-    uint8_t *mqttData;
     uint8_t buffer[MAX_PACKET_SIZE];
     etherHeader *data = (etherHeader*) buffer;
+    uint16_t size;
+    packetInfo info;
     socket s;
+    uint32_t loopStart, perfStart;
 
     // Init controller
     initHw();
@@ -1450,6 +1679,7 @@ int main(void)
     initWireless();
     // Init timer
     initTimer();
+    initPerfStats();
 
     initDefaultTimers();
 
@@ -1458,10 +1688,12 @@ int main(void)
     putsUart0("\nStarting eth0\n");
     initEther(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
     setEtherMacAddress(2, 3, 4, 5, 6, 69);
+    setEtherRxFilter(isEtherFrameWanted);
 
     // Init EEPROM
     
     readConfiguration();
+    setEtherFilters();
 
     setPinValue(GREEN_LED, 1);
     waitMicrosecond(100000);
@@ -1477,16 +1709,31 @@ int main(void)
     // Main Loop
     // RTOS and interrupts would greatly improve this code,
     // but the goal here is simplicity
+    loopStart = PERF_START();
     while (true)
     {
+        // Time between passes, however each one ends
+        PERF_STOP(PERF_LOOP, loopStart);
+        loopStart = PERF_START();
+
         // Put terminal processing here
+        setBusOp(BUS_OP_SHELL);
+        perfStart = PERF_START();
         processShell();
+        PERF_STOP(PERF_SHELL, perfStart);
 
+        setBusOp(BUS_OP_OTHER);
+        perfStart = PERF_START();
         processTransmission();
+        PERF_STOP(PERF_TRANSMISSION, perfStart);
 
+        setBusOp(BUS_OP_RADIO_POLL);
+        perfStart = PERF_START();
         processWireless();
+        PERF_STOP(PERF_WIRELESS, perfStart);
 
         // Packet processing
+        setBusOp(BUS_OP_ETH_RX);
         if (isEtherDataAvailable())
         {
             if (isEtherOverflow())
@@ -1497,47 +1744,34 @@ int main(void)
             }
 
             // Get packet
-            getEtherPacket(data, MAX_PACKET_SIZE);
+            perfStart = PERF_START();
+            size = getEtherPacket(data, MAX_PACKET_SIZE);
+            PERF_STOP(PERF_ETH_GET, perfStart);
+            getPacketInfo(data, size, sockets, MAX_SOCKETS, &info);
+            // the ARP cache keeps the sender of anything addressed here
+            if (info.type != PACKET_OTHER)
+                updateArpCache(data, info.type == PACKET_ARP_REQUEST);
 
             // Handle ARP request
-            if (isArpRequest(data))
+            if (info.type == PACKET_ARP_REQUEST)
             {
                 sendArpResponse(data);
             }
             
-            // Handle ARP response
-            if(isArpResponse(data))
-            {
-                if(gf_rx_arp)
-                {
-                    setSocketHwAddress(data, &(sockets[gf_rx_arp]));
-                    switch(sockets[gf_rx_arp].id)
-                    {
-                        case PROTOCOL_TCP:
-                            gf_tcp_send_syn = gf_rx_arp;
-                            restartTimer(tcpHandshakeTimeoutCallback);
-                            break;
-                        case PROTOCOL_ICMP:
-                            gf_send_ping = gf_rx_arp;
-                            break;
-                    }
-                    gf_rx_arp = 0;
-                }
-            }
             // Handle IP datagram
-            if (isIp(data))
+            if (info.ip != NULL)
             {
-            	if (isIpUnicast(data))
+            	if (info.type >= PACKET_IP)
             	{
                     // Handle ICMP ping request
-                    if (isPingRequest(data))
+                    if (info.type == PACKET_PING_REQUEST)
                     {
                         sendPingResponse(data);
                         putsUart0("Pinged\n");
                     }
 
                     // Handle ICMP ping response
-                    if(isPingResponse(data))
+                    if(info.type == PACKET_PING_RESPONSE)
                     {
                         // putsUart0("Time = ");
                         // sprintf(str, "%u""ms", getUptime() - pingTime);
@@ -1548,9 +1782,9 @@ int main(void)
                     }
 
                     // Handle UDP datagram
-                    if (isUdp(data))
+                    if (info.type == PACKET_UDP)
                     {
-                        udpData = getUdpData(data);
+                        udpData = info.payload;
                         if (strcmp((char*)udpData, "on") == 0)
                             setPinValue(GREEN_LED, 1);
                         if (strcmp((char*)udpData, "off") == 0)
@@ -1560,16 +1794,16 @@ int main(void)
                     }
 
                     // Handle TCP datagram
-                    if (isTcp(data))
+                    if (info.type == PACKET_TCP)
                     {
-                        uint8_t socketNumber = isTcpSocketConnected(data, sockets, MAX_SOCKETS);
+                        uint8_t socketNumber = info.socketNumber;
                         socket *s = &(sockets[socketNumber]);
                         // Invalid socket
                         if(socketNumber >= MAX_SOCKETS)
                             continue;
                         
-                        tcpData = getTcpData(data, s);
-                        uint16_t tcpFlags = getTcpFlags(data);
+                        updateTcpSocket(s, (tcpHeader*)info.transport, info.payloadSize);
+                        uint16_t tcpFlags = info.tcpFlags;
                         switch(s->state)
                         {
                             case TCP_SYN_SENT:
@@ -1577,101 +1811,26 @@ int main(void)
                                 {
                                     case (SYN | ACK):
                                         gf_tcp_send_ack = socketNumber;
-                                        gf_tcp_rx_synack = 0;
+                                        if(info.mqtt)
+                                            resetMqttReader(&mqttStreams[socketNumber]);
                                         setTcpState(s, TCP_ESTABLISHED);
                                         break;
                                     case (RST | ACK):
-                                        deleteSocket(&(sockets[gf_tcp_rx_synack]));
+                                        deleteSocket(s);
                                         putsUart0("TCP Connection refused\nPort not open\n");
-                                        gf_tcp_rx_synack = 0;
                                         break;
                                     default:
                                         break;
                                 }
                                 break;
                             case TCP_ESTABLISHED:
+                                // every MQTT packet the segment completes, however
+                                // the broker cut its stream into segments
+                                if(info.mqtt)
+                                    readMqttSocket(socketNumber);
                                 switch(tcpFlags)
                                 {
                                     case (PSH | ACK):
-                                        gf_tcp_send_ack = socketNumber;
-                                        if(isMqtt(data))
-                                        {
-                                            uint8_t mqttFlags = getMqttFlags(tcpData);
-                                            mqttData = getMqttData(tcpData);
-                                            switch(mqttFlags)
-                                            {
-                                                case CONNACK:
-                                                    if(gf_mqtt_rx_connack)
-                                                    {
-                                                        if(mqttData[1] == 0)
-                                                        {
-                                                            putsUart0("Connected\n");
-                                                            //gf_mqtt_subscribe_default = gf_mqtt_rx_connack;
-                                                            setMqttBrokerSocketIndex(gf_mqtt_rx_connack);
-                                                        }
-                                                        else
-                                                        {
-                                                            putsUart0("MQTT connection refused\nReturned: ");
-                                                            putcUart0(mqttData[1] + '0');
-                                                            putsUart0("\n");
-                                                            deleteSocket(&(sockets[gf_mqtt_rx_connack]));
-                                                        }
-                                                        gf_mqtt_rx_connack = 0;
-                                                    }
-                                                    break;
-                                                case SUBACK:
-                                                    if(gf_mqtt_rx_suback)
-                                                    {
-                                                        putsUart0("Subscribed to ");
-                                                        putsUart0(topics[gf_mqtt_rx_suback].name);
-                                                        putcUart0('\n');
-                                                        gf_mqtt_rx_suback = 0;
-                                                    }
-                                                    else if(gf_mqtt_rx_suback_default)
-                                                    {
-                                                        putsUart0("Subscribed to default topics\n");
-                                                        gf_mqtt_subscribe_default = gf_mqtt_rx_suback_default;
-                                                        gf_mqtt_rx_suback_default = 0;
-                                                    }
-                                                    break;
-                                                case UNSUBACK:
-                                                    if(gf_mqtt_rx_unsuback)
-                                                    {
-                                                        putsUart0("Unsubscribed from ");
-                                                        putsUart0(topics[gf_mqtt_rx_unsuback].name);
-                                                        putcUart0('\n');
-                                                        // removeTopic(gf_mqtt_rx_unsuback, topics);
-                                                        gf_mqtt_rx_unsuback = 0;
-                                                    }
-                                                    break;
-                                                case PUBLISH:
-                                                    // Extract topic information and msg from publish
-                                                    topicLength = (mqttData[0] << 8) + mqttData[1];
-                                                    char shortTopicName[5];
-                                                    // 0012 uta_iot/feed/mtrsp
-                                                    // 0 1  0123456789ABC
-                                                    strncpy(shortTopicName, (char *)&mqttData[2 + topicLength - 5], 5);
-                                                    uint16_t msgLength = getMqttMessageLength(tcpData);
-                                                    mqttMessage = getMqttMessage(tcpData);
-                                                    pushMessage pshMsg;
-                                                    strncpy(pshMsg.topicName, shortTopicName, 5);
-                                                    strncpy(pshMsg.topicMessage, (char *)mqttMessage, msgLength);
-                                                    
-                                                    setPushFlag(true);
-                                                    MQTTBinding binding[3];
-                                                    MQTTBinding *isDevicePresent = mqtt_binding_table_get((MQTTBinding **)&binding, 3, pshMsg.topicName);
-
-                                                    if(isDevicePresent != NULL)
-                                                    {
-//                                                        if(binding[0].dirtyBit == 1)
-                                                        queuePushMsg(&pshMsg, (binding[0].client_id[6]) - '0');
-                                                        // if(isOverflow)
-                                                        //     putsUart0("Push Message Buffer overload\n");
-
-                                                    }
-                                                    break;
-                                            }
-                                        }
                                         break;
                                     case (FIN | ACK):
                                         gf_tcp_send_ack = 0;
@@ -1681,12 +1840,8 @@ int main(void)
                                         // restartTimer(closeSocketCallback);       
                                         break;
                                     case (RST | ACK):
-                                        resetSocket(s);
-                                        setTcpState(s, TCP_SYN_SENT);
                                         putsUart0("Reset received\n");
-                                        gf_tcp_send_syn = socketNumber;
-                                        if(isMqttSocket(s))
-                                            gf_mqtt_connect_default = socketNumber;
+                                        reconnectSocket(socketNumber);
                                         break;
                                     case ACK:
                                         break;
@@ -0,0 +1,31 @@
+// Hardware Abstraction Layer
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL or Linux host (HOST build)
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// The driver headers (gpio.h, spi0.h, spi1.h, uart0.h, i2c0.h, i2cEeprom.h,
+// eeprom.h, timer.h, timer_wireless.h, clock.h, wait.h, eth0.h) are the
+// boundary between the stack and the hardware.  Code above that boundary
+// includes this file instead of tm4c123gh6pm.h so that it also builds for
+// the host, where host/ supplies simulated versions of the same drivers.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#ifdef HOST
+#define _delay_cycles(cycles) ((void)(cycles))
+#else
+#include "tm4c123gh6pm.h"
+#endif
+
+#endif
@@ -13,6 +13,7 @@
 // Device includes, defines, and assembler directives
 //-----------------------------------------------------reset------------------------
 #include "hashTable.h"
+#include "busStats.h"
 
 //-----------------------------------------------------------------------------
 // Subroutines
@@ -48,6 +49,7 @@ void mqtt_binding_table_put(MQTTBinding **bindings, uint8_t bindings_count)
 {
     uint8_t i;
     uint32_t j;
+    busOp op = setBusOp(BUS_OP_BINDING);
 
     for ( i = 0; i < bindings_count; i++)
     {
@@ -66,6 +68,7 @@ void mqtt_binding_table_put(MQTTBinding **bindings, uint8_t bindings_count)
             }
         }
     }
+    setBusOp(op);
 }
 
 
@@ -75,6 +78,7 @@ MQTTBinding *mqtt_binding_table_get(MQTTBinding **bindings, uint8_t bindings_cou
 {
     uint8_t i;
     uint32_t j;
+    busOp op = setBusOp(BUS_OP_BINDING);
 
     for (i = 0; i < bindings_count; i++)
     {
@@ -91,11 +95,13 @@ MQTTBinding *mqtt_binding_table_get(MQTTBinding **bindings, uint8_t bindings_cou
         if (strncmp(bindings[i]->devCaps, devCaps, sizeof(bindings[i]->devCaps)) == 0)
         {
             // Return the found binding
+            setBusOp(op);
             return bindings[i];
         }
     }
 
     // Return NULL if not found
+    setBusOp(op);
     return NULL;
 }
 
@@ -104,6 +110,7 @@ bool mqtt_binding_table_remove(MQTTBinding **bindings, uint8_t bindings_count, c
     bool removed = false;
     uint8_t i;
     uint32_t j;
+    busOp op = setBusOp(BUS_OP_BINDING);
 
     for (i = 0; i < bindings_count; i++)
     {
@@ -125,5 +132,6 @@ bool mqtt_binding_table_remove(MQTTBinding **bindings, uint8_t bindings_count, c
         }
     }
 
+    setBusOp(op);
     return removed;
 }
@@ -0,0 +1,567 @@
+// Benchmark Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Times the protocol hot paths of the stack and prints the results as JSON
+// on stdout, one object per benchmark:
+//   ns_per_op        host CPU time per call
+//   bytes_per_op     bytes checksummed, built, decoded or hashed per call
+//   model_ns_per_op  target time the call spends on modelled buses and busy
+//                    waits (SPI, I2C EEPROM, waitMicrosecond)
+//
+// The tcp/stream benchmarks measure throughput against a local peer: each
+// op sends BENCH_STREAM_SIZE bytes of PUBLISH packets to the broker
+// stand-in (mqttBroker.c) across the wire model and waits for them all to
+// be acknowledged, so model_ns_per_op is the simulated time the transfer
+// takes, wire, SPI and retransmission timeouts included.  They attach the
+// broker, so they run last.
+//
+// The functions run unmodified, linked against the same host drivers as the
+// bridge; the bridge's main() is renamed so this one can run instead.  The
+// virtual clock (host.c) is forced on, so modelled waits cost no host time
+// and are reported separately.
+//
+//   make bench                 build build/<ETH>/bench
+//   build/frame/bench [name]   run the benchmarks whose name contains name
+//   BENCH_MS                   minimum timed run per benchmark, default 200
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "i2c0.h"
+#include "eth0.h"
+#include "ip.h"
+#include "tcp.h"
+#include "packet.h"
+#include "mqtt.h"
+#include "hashTable.h"
+#include "timer.h"
+#include "timer_wireless.h"
+#include "wireless.h"
+#include "wait.h"
+#include "host.h"
+#include "mqttBroker.h"
+
+#define MAX_BENCH_FRAME 1522
+#define FILLER_TIMERS   10              // the benchmarked timer takes the last free slot
+#define BENCH_STREAM_SIZE   65536       // bytes per op of the stream benchmarks
+#define BENCH_STREAM_PACKET 256         // PUBLISH packet sent per segment
+#define BENCH_STREAM_LOSS   0.01
+
+typedef struct _benchCase
+{
+    const char *name;
+    void (*run)(void);
+    uint32_t bytes;                     // bytes per op
+} benchCase;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t benchFrame[MAX_BENCH_FRAME];
+uint8_t benchPayload[MAX_BENCH_FRAME];
+uint8_t benchPublish[MAX_BENCH_FRAME];  // PUBLISH frame built by sendMqttMessage()
+uint8_t benchSegment[MAX_BENCH_FRAME];  // full-size TCP segment
+uint8_t *benchPublishMqtt;
+socket benchSocket;
+char benchArgs[2][MQTT_MAX_ARGUMENT_LENGTH];
+MQTTBinding benchBinding;
+MQTTBinding *benchBindings[1] = {&benchBinding};
+volatile uint32_t benchSink;
+socket benchStreamSocket;
+bool benchStreamOpen = false;
+uint8_t benchStreamFrame[MAX_BENCH_FRAME];
+uint8_t benchStreamRx[MAX_BENCH_FRAME];
+uint8_t benchStreamPacket[BENCH_STREAM_PACKET];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint64_t readBenchNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+ipHeader* getBenchIp(uint8_t frame[])
+{
+    return (ipHeader*)((etherHeader*)frame)->data;
+}
+
+// Builds an intact IP/TCP frame to this ip carrying size payload bytes
+void buildBenchSegment(uint8_t frame[], uint16_t size)
+{
+    ipHeader *ip = getBenchIp(frame);
+    tcpHeader *tcp;
+
+    memset(frame, 0, MAX_BENCH_FRAME);
+    ip->rev = 0x4;
+    ip->size = 0x5;
+    ip->ttl = 128;
+    ip->protocol = PROTOCOL_TCP;
+    memcpy(ip->sourceIp, benchSocket.remoteIpAddress, IP_ADD_LENGTH);
+    getIpAddress(ip->destIp);
+    ip->length = htons(ip->size * 4 + sizeof(tcpHeader) + size);
+    tcp = (tcpHeader*)((uint8_t*)ip + ip->size * 4);
+    tcp->sourcePort = htons(MQTT_PORT);
+    tcp->destPort = htons(benchSocket.localPort);
+    tcp->offsetFields = htons(0x5000);
+    memcpy(tcp->data, benchPayload, size);
+    ((etherHeader*)frame)->frameType = htons(TYPE_IP);
+    calcIpChecksum(ip);
+    calcTcpChecksum(ip, sizeof(tcpHeader) + size);
+}
+
+void benchSumIpWords20(void)
+{
+    uint32_t sum = 0;
+    sumIpWords(benchPayload, 20, &sum);
+    benchSink = sum;
+}
+
+void benchSumIpWords1460(void)
+{
+    uint32_t sum = 0;
+    sumIpWords(benchPayload, 1460, &sum);
+    benchSink = sum;
+}
+
+void benchCalcIpChecksum(void)
+{
+    calcIpChecksum(getBenchIp(benchFrame));
+}
+
+void benchCalcTcpChecksum536(void)
+{
+    calcTcpChecksum(getBenchIp(benchFrame), sizeof(tcpHeader) + 536);
+}
+
+// Checksums and sends the full-size segment, with the sum left to the
+// ENC28J60 DMA if offload is set (ETH=enc28j60 only; the frame backend
+// always sums in software)
+void sendBenchSegment(bool offload)
+{
+    ipHeader *ip = getBenchIp(benchSegment);
+
+    setEtherChecksumOffload(offload);
+    calcTcpChecksum(ip, ntohs(ip->length) - ip->size * 4);
+    benchSink = putEtherPacket((etherHeader*)benchSegment, sizeof(etherHeader) + ntohs(ip->length));
+    setEtherChecksumOffload(false);
+}
+
+void benchSendTcpSegment1460(void)
+{
+    sendBenchSegment(false);
+}
+
+void benchSendTcpSegment1460Offload(void)
+{
+    sendBenchSegment(true);
+}
+
+// Receive side: the checksum check on the same segment
+void benchIsTcp536(void)
+{
+    benchSink = isTcp((etherHeader*)benchFrame);
+}
+
+// The whole receive classification of the same segment
+void benchGetPacketInfo536(void)
+{
+    packetInfo info;
+
+    benchSink = getPacketInfo((etherHeader*)benchFrame, sizeof(etherHeader) + 20 + sizeof(tcpHeader) + 536,
+                              &benchSocket, 1, &info);
+}
+
+// The broker acknowledging everything sent on s, which releases it from
+// the send buffer
+void ackBenchSocket(socket *s)
+{
+    tcpHeader ack;
+
+    memset(&ack, 0, sizeof(ack));
+    ack.sequenceNumber = htonl(s->sequenceNumber);
+    ack.acknowledgementNumber = htonl(s->acknowledgementNumber);
+    ack.offsetFields = htons(ACK | 0x5000);
+    ack.windowSize = htons(4096);
+    updateTcpSocket(s, &ack, 0);
+}
+
+// The builders send through the send buffer, so each one is acknowledged
+void benchSendMqttConnect(void)
+{
+    sendMqttMessage((etherHeader*)benchFrame, &benchSocket, CONNECT, MQTT_CLEAN, benchArgs,
+                    MQTT_MAX_ARGUMENT_LENGTH, 1);
+    ackBenchSocket(&benchSocket);
+}
+
+void benchSendMqttPublish(void)
+{
+    sendMqttMessage((etherHeader*)benchFrame, &benchSocket, PUBLISH, 0, benchArgs,
+                    MQTT_MAX_ARGUMENT_LENGTH, 1);
+    ackBenchSocket(&benchSocket);
+}
+
+// The same publish from a socket without its header template, which is
+// built on every send
+void benchSendMqttPublishUncached(void)
+{
+    socket s = benchSocket;
+
+    s.headerValid = false;
+    sendMqttMessage((etherHeader*)benchFrame, &s, PUBLISH, 0, benchArgs,
+                    MQTT_MAX_ARGUMENT_LENGTH, 1);
+    ackBenchSocket(&s);
+}
+
+void benchGetMqttData(void)
+{
+    benchSink = (uintptr_t)getMqttData(benchPublishMqtt);
+}
+
+void benchGetMqttMessage(void)
+{
+    benchSink = (uintptr_t)getMqttMessage(benchPublishMqtt) + getMqttMessageLength(benchPublishMqtt);
+}
+
+void benchFnv1HashCaps(void)
+{
+    benchSink = fnv1_hash("mtrsp");
+}
+
+void benchFnv1HashTopic(void)
+{
+    benchSink = fnv1_hash("uta_iot/feed/mtrsp");
+}
+
+void benchBindingGetHit(void)
+{
+    benchSink = (uintptr_t)mqtt_binding_table_get(benchBindings, 1, "mtrsp");
+}
+
+void benchBindingGetMiss(void)
+{
+    benchSink = (uintptr_t)mqtt_binding_table_get(benchBindings, 1, "tempf");
+}
+
+void benchTimerCallback(void)
+{
+}
+
+// Distinct callbacks that fill the timer tables ahead of benchTimerCallback
+#define BENCH_FILLER(n) void benchFiller##n(void) {}
+BENCH_FILLER(0) BENCH_FILLER(1) BENCH_FILLER(2) BENCH_FILLER(3) BENCH_FILLER(4)
+BENCH_FILLER(5) BENCH_FILLER(6) BENCH_FILLER(7) BENCH_FILLER(8) BENCH_FILLER(9)
+
+_callback benchFillers[FILLER_TIMERS] = {benchFiller0, benchFiller1, benchFiller2, benchFiller3,
+                                         benchFiller4, benchFiller5, benchFiller6, benchFiller7,
+                                         benchFiller8, benchFiller9};
+
+// stopTimer() keeps the slot, so the 1 s timers are stopped and restarted
+// (as the tcp handshake timeout is) rather than started again
+void benchTimerStopRestart(void)
+{
+    stopTimer(benchTimerCallback);
+    restartTimer(benchTimerCallback);
+}
+
+void benchTimerRestart(void)
+{
+    benchSink = restartTimer(benchTimerCallback);
+}
+
+void benchTimerStartStop_ms(void)
+{
+    startOneshotTimer_ms(benchTimerCallback, 60000);
+    stopTimer_ms(benchTimerCallback);
+}
+
+void benchTimerRestart_ms(void)
+{
+    benchSink = restartTimer_ms(benchTimerCallback);
+}
+
+// A full-size frame through the ETH backend (the ENC28J60 SPI path with
+// ETH=enc28j60)
+void benchPutEtherPacket1514(void)
+{
+    benchSink = putEtherPacket((etherHeader*)benchPayload, 1514);
+}
+
+// The same frame followed by 1 ms of other work (building the next frame,
+// a radio slot), which can overlap the frame going out
+void benchPutEtherPacket1514Work(void)
+{
+    benchSink = putEtherPacket((etherHeader*)benchPayload, 1514);
+    waitMicrosecond(1000);
+}
+
+void benchNrf24l0TxMsg(void)
+{
+    benchSink = nrf24l0TxMsg(benchPayload, DATA_MAX_SIZE - META_DATA_SIZE, 1 << 3);
+}
+
+// Takes a frame from the broker as main() does, returning the flags of a
+// segment for the stream socket or 0; idles the host clock if there is none
+uint16_t receiveBenchStream(void)
+{
+    packetInfo info;
+    uint16_t size;
+
+    if (!isEtherDataAvailable())
+    {
+        idleHost();
+        return 0;
+    }
+    size = getEtherPacket((etherHeader*)benchStreamRx, MAX_BENCH_FRAME);
+    if (getPacketInfo((etherHeader*)benchStreamRx, size, &benchStreamSocket, 1, &info) != PACKET_TCP ||
+        info.socketNumber != 0)
+        return 0;
+    updateTcpSocket(&benchStreamSocket, (tcpHeader*)info.transport, info.payloadSize);
+    return info.tcpFlags;
+}
+
+// Connects the stream socket to the broker stand-in on first use
+void openBenchStream(void)
+{
+    uint16_t topicSize = strlen("uta_iot/feeds/stream");
+    uint16_t n = 0;
+
+    if (benchStreamOpen)
+        return;
+    benchStreamPacket[n++] = PUBLISH;
+    benchStreamPacket[n++] = 0x80 | ((BENCH_STREAM_PACKET - 3) & 0x7F);
+    benchStreamPacket[n++] = (BENCH_STREAM_PACKET - 3) >> 7;
+    benchStreamPacket[n++] = topicSize >> 8;
+    benchStreamPacket[n++] = topicSize & 0xFF;
+    memcpy(&benchStreamPacket[n], "uta_iot/feeds/stream", topicSize);
+    memcpy(&benchStreamPacket[n + topicSize], benchPayload, BENCH_STREAM_PACKET - n - topicSize);
+
+    attachMqttBroker();
+    benchStreamSocket = benchSocket;
+    benchStreamSocket.sequenceNumber = 0;
+    benchStreamSocket.acknowledgementNumber = 0;
+    setTcpState(&benchStreamSocket, TCP_SYN_SENT);
+    sendTcpMessage((etherHeader*)benchStreamFrame, &benchStreamSocket, SYN, NULL, 0);
+    while (receiveBenchStream() != (SYN | ACK))
+        ;
+    setTcpState(&benchStreamSocket, TCP_ESTABLISHED);
+    sendTcpMessage((etherHeader*)benchStreamFrame, &benchStreamSocket, ACK, NULL, 0);
+    benchStreamOpen = true;
+}
+
+// Sends BENCH_STREAM_SIZE bytes to the broker with at most window bytes
+// unacknowledged, and returns once the broker has acknowledged them all
+void streamBench(uint32_t window)
+{
+    socket *s = &benchStreamSocket;
+    uint32_t sent = 0;
+
+    openBenchStream();
+    while (sent < BENCH_STREAM_SIZE || s->unacknowledged != s->acknowledgementNumber)
+    {
+        if (sent < BENCH_STREAM_SIZE && getTcpSendSpace(s) >= BENCH_STREAM_PACKET &&
+            s->acknowledgementNumber - s->unacknowledged + BENCH_STREAM_PACKET <= window)
+        {
+            sendTcpMessage((etherHeader*)benchStreamFrame, s, PSH | ACK, benchStreamPacket, BENCH_STREAM_PACKET);
+            sent += BENCH_STREAM_PACKET;
+        }
+        processTcpQueue((etherHeader*)benchStreamFrame);
+        receiveBenchStream();
+    }
+}
+
+// As many segments in flight as the broker's window and the send buffer
+// allow
+void benchTcpStream(void)
+{
+    streamBench(UINT32_MAX);
+}
+
+// One segment in flight, as without a send window
+void benchTcpStreamStopWait(void)
+{
+    streamBench(BENCH_STREAM_PACKET);
+}
+
+// The broker losing BENCH_STREAM_LOSS of the segments, which are sent again
+// after the retransmission timeout
+void benchTcpStreamLoss(void)
+{
+    setMqttBrokerLoss(BENCH_STREAM_LOSS);
+    streamBench(UINT32_MAX);
+    setMqttBrokerLoss(0);
+}
+
+// Brings up the parts of the firmware the benchmarks call into
+void initBench(void)
+{
+    static const uint8_t localIp[4] = {192, 168, 1, 110};
+    static const uint8_t brokerIp[4] = {192, 168, 1, 1};
+    static const uint8_t brokerMac[6] = {0x02, 0x42, 0x52, 0x4F, 0x4B, 0x52};
+    ipHeader *ip;
+    tcpHeader *tcp;
+    uint16_t i;
+
+    initI2c0();
+    initWireless();
+    initTimer();
+    initEther(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    setEtherMacAddress(2, 3, 4, 5, 6, 69);
+    setIpAddress(localIp);
+
+    for (i = 0; i < MAX_BENCH_FRAME; i++)
+        benchPayload[i] = getHostRandom();
+    memcpy(benchSocket.remoteIpAddress, brokerIp, sizeof(brokerIp));
+    memcpy(benchSocket.remoteHwAddress, brokerMac, sizeof(brokerMac));
+    benchSocket.remotePort = MQTT_PORT;
+    benchSocket.localPort = 50000;
+    benchSocket.sequenceNumber = 1000;
+    benchSocket.acknowledgementNumber = 2000;
+    benchSocket.unacknowledged = 2000;
+    benchSocket.window = 4096;
+    initTcpSocket(&benchSocket);
+    benchSocket.state = TCP_ESTABLISHED;
+    setTcpHeaderTemplate(&benchSocket);
+    addTcpSocket(&benchSocket, 0);
+    strcpy(benchArgs[0], "uta_iot/feed/mtrsp");
+    strcpy(benchArgs[1], "1500");
+
+    benchSendMqttPublish();
+    memcpy(benchPublish, benchFrame, sizeof(benchPublish));
+    ip = getBenchIp(benchPublish);
+    tcp = (tcpHeader*)((uint8_t*)ip + ip->size * 4);
+    benchPublishMqtt = tcp->data;
+    buildBenchSegment(benchFrame, 536);
+    buildBenchSegment(benchSegment, 1460);
+
+    strcpy(benchBinding.client_id, "dev1");
+    strcpy(benchBinding.topic, "uta_iot/feed/mtrsp");
+    strcpy(benchBinding.devCaps, "mtrsp");
+    strcpy(benchBinding.description, "motor speed");
+    mqtt_binding_table_put(benchBindings, 1);
+
+    // Fill both tables, leaving the last free slot to benchTimerCallback;
+    // wireless.c already holds some of the 1 ms timers
+    i = 0;
+    while (i < FILLER_TIMERS - 1 && startOneshotTimer(benchFillers[i], 3600))
+        i++;
+    startOneshotTimer(benchTimerCallback, 3600);
+    i = 0;
+    while (i < FILLER_TIMERS && startOneshotTimer_ms(benchFillers[i], 3600000))
+        i++;
+    if (i > 0)
+        stopTimer_ms(benchFillers[i - 1]);
+    startOneshotTimer_ms(benchTimerCallback, 3600000);
+}
+
+// Returns the size of the frame sendMqttMessage() left in benchFrame
+uint32_t getBenchFrameSize(void)
+{
+    return sizeof(etherHeader) + ntohs(getBenchIp(benchFrame)->length);
+}
+
+// Doubles the iteration count until a run lasts minNs, then reports it
+void runBench(const benchCase *b, uint64_t minNs, bool first)
+{
+    uint64_t iterations = 1;
+    uint64_t start, elapsed, modelStart, model;
+    uint64_t i;
+
+    (*b->run)();
+    while (true)
+    {
+        modelStart = getHostTimeNs();
+        start = readBenchNs();
+        for (i = 0; i < iterations; i++)
+            (*b->run)();
+        elapsed = readBenchNs() - start;
+        model = getHostTimeNs() - modelStart;
+        if (elapsed >= minNs || iterations >= (1ULL << 40))
+            break;
+        iterations *= 2;
+    }
+    printf("%s    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"bytes_per_op\": %u, "
+           "\"model_ns_per_op\": %.1f}", first ? "" : ",\n", b->name, (unsigned long long)iterations,
+           (double)elapsed / iterations, b->bytes, (double)model / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+    benchCase cases[] =
+    {
+        {"sumIpWords/20", benchSumIpWords20, 20},
+        {"sumIpWords/1460", benchSumIpWords1460, 1460},
+        {"calcIpChecksum", benchCalcIpChecksum, 20},
+        {"calcTcpChecksum/536", benchCalcTcpChecksum536, 12 + sizeof(tcpHeader) + 536},
+        {"sendMqttMessage/connect", benchSendMqttConnect, 0},
+        {"sendMqttMessage/publish", benchSendMqttPublish, 0},
+        {"getMqttData/publish", benchGetMqttData, 0},
+        {"getMqttMessage/publish", benchGetMqttMessage, 0},
+        {"isTcp/536", benchIsTcp536, 12 + sizeof(tcpHeader) + 536},
+        {"sendMqttMessage/publish/uncached", benchSendMqttPublishUncached, 0},
+        {"getPacketInfo/tcp536", benchGetPacketInfo536, 12 + sizeof(tcpHeader) + 536},
+        {"fnv1_hash/devcaps", benchFnv1HashCaps, 5},
+        {"fnv1_hash/topic", benchFnv1HashTopic, 18},
+        {"mqtt_binding_table_get/hit", benchBindingGetHit, sizeof(MQTTBinding)},
+        {"mqtt_binding_table_get/miss", benchBindingGetMiss, sizeof(MQTTBinding)},
+        {"timer/stop_restart", benchTimerStopRestart, 0},
+        {"timer/restart", benchTimerRestart, 0},
+        {"timer_ms/start_stop", benchTimerStartStop_ms, 0},
+        {"timer_ms/restart", benchTimerRestart_ms, 0},
+        {"putEtherPacket/1514", benchPutEtherPacket1514, 1514},
+        {"putEtherPacket/1514+1ms", benchPutEtherPacket1514Work, 1514},
+        {"sendTcpSegment/1460", benchSendTcpSegment1460, 1514},
+        {"sendTcpSegment/1460/offload", benchSendTcpSegment1460Offload, 1514},
+        {"nrf24l0TxMsg", benchNrf24l0TxMsg, DATA_MAX_SIZE},
+        {"tcp/stream/64k", benchTcpStream, BENCH_STREAM_SIZE},
+        {"tcp/stream/64k/stopwait", benchTcpStreamStopWait, BENCH_STREAM_SIZE},
+        {"tcp/stream/64k/loss", benchTcpStreamLoss, BENCH_STREAM_SIZE},
+    };
+    uint64_t minNs = 200000000;
+    bool first = true;
+    uint8_t i;
+
+    setenv("HOST_CLOCK", "virtual", 1);
+    if (getenv("BENCH_MS") != NULL)
+        minNs = strtoull(getenv("BENCH_MS"), NULL, 0) * 1000000;
+    initBench();
+
+    // Frame sizes are only known once the builders have run
+    benchSendMqttConnect();
+    cases[4].bytes = getBenchFrameSize();
+    benchSendMqttPublish();
+    cases[5].bytes = cases[9].bytes = getBenchFrameSize();
+    cases[6].bytes = cases[7].bytes = ntohs(getBenchIp(benchPublish)->length) - 20 - sizeof(tcpHeader);
+    buildBenchSegment(benchFrame, 536);
+
+    printf("{\n  \"suite\": \"bridge\",\n  \"benchmarks\": [\n");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        if (argc > 1 && strstr(cases[i].name, argv[1]) == NULL)
+            continue;
+        runBench(&cases[i], minNs, first);
+        first = false;
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+// EEPROM functions (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// System Clock:    -
+
+// Models the 2 KB internal EEPROM as 512 words that start erased, with the
+// access times described in storage.h
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "eeprom.h"
+#include "host.h"
+#include "storage.h"
+#include "perfStats.h"
+
+#define EEPROM_WORDS 512
+#define READ_NS      100                // 4 clocks at 40 MHz
+#define WRITE_NS     110000             // word program time, no copy or erase
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint32_t eepromWords[EEPROM_WORDS];
+bool eepromInitialized = false;
+FILE *eepromFile = NULL;
+eepromStats eepromTotals;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEeprom(void)
+{
+    uint16_t i;
+    if (eepromInitialized)
+        return;
+    for (i = 0; i < EEPROM_WORDS; i++)
+        eepromWords[i] = 0xFFFFFFFF;
+    eepromInitialized = true;
+
+    // HOST_EEPROM names an image file that keeps the contents across runs
+    if (getenv("HOST_EEPROM") != NULL)
+    {
+        eepromFile = fopen(getenv("HOST_EEPROM"), "r+b");
+        if (eepromFile == NULL)
+        {
+            eepromFile = fopen(getenv("HOST_EEPROM"), "w+b");
+            if (eepromFile != NULL)
+                fwrite(eepromWords, sizeof(uint32_t), EEPROM_WORDS, eepromFile);
+        }
+        else
+            fread(eepromWords, sizeof(uint32_t), EEPROM_WORDS, eepromFile);
+    }
+}
+
+void writeEeprom(uint16_t add, uint32_t data)
+{
+    uint32_t perfStart = PERF_START();
+    initEeprom();
+    eepromTotals.writes++;
+    eepromTotals.busyNs += WRITE_NS;
+    chargeHostTime(WRITE_NS);
+    eepromWords[add % EEPROM_WORDS] = data;
+    if (eepromFile != NULL)
+    {
+        fseek(eepromFile, (add % EEPROM_WORDS) * sizeof(uint32_t), SEEK_SET);
+        fwrite(&data, sizeof(uint32_t), 1, eepromFile);
+        fflush(eepromFile);
+    }
+    PERF_STOP(PERF_EEPROM, perfStart);
+}
+
+uint32_t readEeprom(uint16_t add)
+{
+    uint32_t perfStart = PERF_START();
+    initEeprom();
+    eepromTotals.reads++;
+    eepromTotals.busyNs += READ_NS;
+    chargeHostTime(READ_NS);
+    PERF_STOP(PERF_EEPROM, perfStart);
+    return eepromWords[add % EEPROM_WORDS];
+}
+
+void getEepromStats(eepromStats *stats)
+{
+    *stats = eepromTotals;
+}
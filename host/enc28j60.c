@@ -0,0 +1,691 @@
+// ENC28J60 Model Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Register addresses below carry the bank in bits 6:5, as in eth0.c.
+// The common registers (0x1B-0x1F) are stored once, in bank 0.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "host.h"
+#include "enc28j60.h"
+
+#define SRAM_SIZE   8192
+#define SRAM_MASK   0x1FFF
+#define REG_COUNT   128
+#define PHY_COUNT   32
+
+// Ether registers
+#define ERDPTL      0x00
+#define ERDPTH      0x01
+#define EWRPTL      0x02
+#define EWRPTH      0x03
+#define ETXSTL      0x04
+#define ETXSTH      0x05
+#define ETXNDL      0x06
+#define ETXNDH      0x07
+#define ERXSTL      0x08
+#define ERXSTH      0x09
+#define ERXNDL      0x0A
+#define ERXNDH      0x0B
+#define ERXRDPTL    0x0C
+#define ERXRDPTH    0x0D
+#define ERXWRPTL    0x0E
+#define ERXWRPTH    0x0F
+#define EDMASTL     0x10
+#define EDMANDL     0x12
+#define EDMACSL     0x16
+#define EDMACSH     0x17
+#define EIE         0x1B
+#define INTIE   0x80
+#define EIR         0x1C
+#define RXERIF  0x01
+#define TXERIF  0x02
+#define TXIF    0x08
+#define LINKIF  0x10
+#define DMAIF   0x20
+#define PKTIF   0x40
+#define ESTAT       0x1D
+#define CLKRDY  0x01
+#define TXABORT 0x02
+#define ECON2       0x1E
+#define PKTDEC  0x40
+#define AUTOINC 0x80
+#define ECON1       0x1F
+#define BSEL    0x03
+#define RXEN    0x04
+#define TXRTS   0x08
+#define CSUMEN  0x10
+#define DMAST   0x20
+#define TXRST   0x80
+#define EHT0        0x20
+#define EPMM0       0x28
+#define EPMCSL      0x30
+#define EPMCSH      0x31
+#define EPMOL       0x34
+#define EPMOH       0x35
+#define ERXFCON     0x38
+#define BCEN    0x01
+#define MCEN    0x02
+#define HTEN    0x04
+#define MPEN    0x08
+#define PMEN    0x10
+#define CRCEN   0x20
+#define ANDOR   0x40
+#define UCEN    0x80
+#define EPKTCNT     0x39
+#define MACON1      0x40
+#define MACON3      0x42
+#define PADCFG0 0x20
+#define MAMXFLL     0x4A
+#define MAMXFLH     0x4B
+#define MICMD       0x52
+#define MIIRD   0x01
+#define MIREGADR    0x54
+#define MIWRL       0x56
+#define MIWRH       0x57
+#define MIRDL       0x58
+#define MIRDH       0x59
+#define MAADR1      0x60
+#define MAADR0      0x61
+#define MAADR3      0x62
+#define MAADR2      0x63
+#define MAADR5      0x64
+#define MAADR4      0x65
+#define MISTAT      0x6A
+#define EREVID      0x72
+
+// Ether phy registers
+#define PHCON1      0x00
+#define PHSTAT1     0x01
+#define PHID1       0x02
+#define PHID2       0x03
+#define PHCON2      0x10
+#define PHSTAT2     0x11
+#define LSTAT  0x0400
+#define PHLCON      0x14
+
+#define RX_HEADER_SIZE      6       // next packet pointer + status vector
+#define CRC_SIZE            4
+#define TX_STATUS_SIZE      7
+#define MIN_FRAME_SIZE      60
+#define PATTERN_SIZE        64
+#define TX_BYTE_NS          800     // 10 Mb/s
+#define TX_OVERHEAD         24      // preamble, CRC and interframe gap
+#define TX_TICK_US          20
+#define DMA_BYTE_NS         80      // checksum rate, two 25 MHz cycles per byte
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t encSram[SRAM_SIZE];
+uint8_t encRegs[REG_COUNT];
+uint16_t encPhy[PHY_COUNT];
+
+bool encSelected = false;
+uint8_t encOpcode = 0;
+uint8_t encAddress = 0;             // full address (bank and register)
+uint16_t encByteIndex = 0;
+bool encIntAsserted = false;
+
+_enc28j60TxHandler encTxHandler = NULL;
+_enc28j60IntHandler encIntHandler = NULL;
+enc28j60Stats encStats;
+
+uint8_t encTxFrame[SRAM_SIZE];      // frame on the wire, TXRTS set until it is out
+uint16_t encTxSize = 0;
+uint64_t encTxDoneNs = 0;
+bool encTxBusy = false;
+bool encTxTimerAttached = false;
+uint64_t encDmaDoneNs = 0;          // DMAST stays set until then
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint16_t getEncPointer(uint8_t reg)
+{
+    return (encRegs[reg] | (encRegs[reg + 1] << 8)) & SRAM_MASK;
+}
+
+void setEncPointer(uint8_t reg, uint16_t value)
+{
+    encRegs[reg] = value & 0xFF;
+    encRegs[reg + 1] = (value >> 8) & 0x1F;
+}
+
+// Maps the 5-bit address of an opcode to a register using ECON1.BSEL
+uint8_t getEncAddress(uint8_t address)
+{
+    if (address >= EIE)
+        return address;
+    return ((encRegs[ECON1] & BSEL) << 5) | address;
+}
+
+// MAC and MII registers (and MISTAT) shift out a dummy byte before the data
+bool isEncMacRegister(uint8_t address)
+{
+    return (address >= MACON1 && address <= MIRDH) || (address >= MAADR1 && address <= MAADR4)
+           || address == MISTAT;
+}
+
+// Next address in the RX ring, wrapping from ERXND to ERXST
+uint16_t getEncRxNext(uint16_t address)
+{
+    if (address == getEncPointer(ERXNDL))
+        return getEncPointer(ERXSTL);
+    return (address + 1) & SRAM_MASK;
+}
+
+void updateEncInt(void)
+{
+    bool asserted;
+
+    // PKTIF mirrors EPKTCNT
+    if (encRegs[EPKTCNT] != 0)
+        encRegs[EIR] |= PKTIF;
+    else
+        encRegs[EIR] &= ~PKTIF;
+    asserted = (encRegs[EIE] & INTIE) && (encRegs[EIE] & encRegs[EIR] & 0x7B);
+    if (asserted != encIntAsserted)
+    {
+        encIntAsserted = asserted;
+        if (encIntHandler != NULL)
+            (*encIntHandler)(!asserted);                // INT is active low
+    }
+}
+
+void resetEnc28j60(void)
+{
+    memset(encRegs, 0, sizeof(encRegs));
+    memset(encPhy, 0, sizeof(encPhy));
+    setEncPointer(ERDPTL, 0x05FA);
+    setEncPointer(ERXSTL, 0x05FA);
+    setEncPointer(ERXNDL, 0x1FFF);
+    setEncPointer(ERXRDPTL, 0x05FA);
+    encRegs[ESTAT] = CLKRDY;        // oscillator start-up timer not modeled
+    encRegs[ECON2] = AUTOINC;
+    encRegs[ERXFCON] = UCEN | CRCEN | BCEN;
+    encRegs[MAMXFLL] = 0x00;
+    encRegs[MAMXFLH] = 0x06;
+    encRegs[EREVID] = 0x06;
+    encPhy[PHSTAT1] = 0x1804;       // PFDPX | PHDPX | LLSTAT
+    encPhy[PHID1] = 0x0083;
+    encPhy[PHID2] = 0x1400;
+    encPhy[PHSTAT2] = LSTAT;        // link up
+    encPhy[PHLCON] = 0x3422;
+    encSelected = false;
+    encByteIndex = 0;
+    encTxBusy = false;
+    updateEncInt();
+}
+
+void attachEnc28j60(_enc28j60TxHandler txHandler, _enc28j60IntHandler intHandler)
+{
+    encTxHandler = txHandler;
+    encIntHandler = intHandler;
+    encIntAsserted = false;
+    resetEnc28j60();
+}
+
+// Writes the TX status vector after ETXND and ends the transmission
+void endEncTx(bool aborted)
+{
+    uint16_t end = getEncPointer(ETXNDL);
+    uint8_t i;
+
+    encTxBusy = false;
+    for (i = 0; i < TX_STATUS_SIZE; i++)
+        encSram[(end + 1 + i) & SRAM_MASK] = 0;
+    encSram[(end + 1) & SRAM_MASK] = (encTxSize + CRC_SIZE) & 0xFF;
+    encSram[(end + 2) & SRAM_MASK] = (encTxSize + CRC_SIZE) >> 8;
+    encSram[(end + 3) & SRAM_MASK] = aborted ? 0 : 0x80;    // transmit done
+    encRegs[ECON1] &= ~TXRTS;
+    if (aborted)
+    {
+        encRegs[ESTAT] |= TXABORT;
+        encRegs[EIR] |= TXERIF;
+    }
+    else
+    {
+        encRegs[ESTAT] &= ~TXABORT;
+        encStats.txFrames++;
+        if (encTxHandler != NULL)
+            (*encTxHandler)(encTxFrame, encTxSize);
+    }
+    encRegs[EIR] |= TXIF;
+    updateEncInt();
+}
+
+// Ends the transmission once its time on the wire has passed
+void serviceEncTx(void)
+{
+    if (encTxBusy && getHostTimeNs() >= encTxDoneNs)
+        endEncTx(false);
+}
+
+// Checksum mode of the DMA: the IP checksum of EDMAST..EDMAND (wrapping in
+// the rx buffer) goes to EDMACS, the byte sent first in EDMACSH
+void startEncDmaChecksum(void)
+{
+    uint16_t address = getEncPointer(EDMASTL);
+    uint16_t end = getEncPointer(EDMANDL);
+    uint32_t sum = 0;
+    uint16_t count = 0;
+    bool odd = false;
+
+    while (true)
+    {
+        sum += odd ? encSram[address] : (encSram[address] << 8);
+        odd = !odd;
+        count++;
+        if (address == end || count == SRAM_SIZE)
+            break;
+        address = getEncRxNext(address);
+    }
+    while ((sum >> 16) != 0)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = ~sum & 0xFFFF;
+    encRegs[EDMACSL] = sum & 0xFF;
+    encRegs[EDMACSH] = sum >> 8;
+    encDmaDoneNs = getHostTimeNs() + (uint64_t)count * DMA_BYTE_NS;
+}
+
+// Ends the DMA operation once its time has passed
+void serviceEncDma(void)
+{
+    if ((encRegs[ECON1] & DMAST) && getHostTimeNs() >= encDmaDoneNs)
+    {
+        encRegs[ECON1] &= ~DMAST;
+        encRegs[EIR] |= DMAIF;
+        updateEncInt();
+    }
+}
+
+// Returns how many ticks will pass before the transmission ends
+uint32_t getEncTxIdleTicks(void)
+{
+    uint64_t now = getHostTimeNs();
+
+    if (!encTxBusy)
+        return UINT32_MAX;
+    if (encTxDoneNs <= now + TX_TICK_US * 1000)
+        return 0;
+    return (encTxDoneNs - now) / (TX_TICK_US * 1000) - 1;
+}
+
+// Takes ETXST+1..ETXND and keeps TXRTS set for its time on the wire
+void transmitEnc28j60Frame(void)
+{
+    uint16_t start = getEncPointer(ETXSTL);
+    uint16_t end = getEncPointer(ETXNDL);
+    uint16_t size = 0;
+    uint16_t address = (start + 1) & SRAM_MASK;
+
+    if (end >= start)
+    {
+        while (size < end - start)
+        {
+            encTxFrame[size++] = encSram[address];
+            address = (address + 1) & SRAM_MASK;
+        }
+    }
+    if ((encRegs[MACON3] & PADCFG0) && size < MIN_FRAME_SIZE)
+    {
+        memset(&encTxFrame[size], 0, MIN_FRAME_SIZE - size);
+        size = MIN_FRAME_SIZE;
+    }
+    encTxSize = size;
+    encTxDoneNs = getHostTimeNs() + (uint64_t)(size + TX_OVERHEAD) * TX_BYTE_NS;
+    encTxBusy = true;
+    if (!encTxTimerAttached)
+        encTxTimerAttached = attachHostTimer(serviceEncTx, TX_TICK_US, getEncTxIdleTicks, NULL);
+}
+
+void writeEncPhy(void)
+{
+    uint8_t reg = encRegs[MIREGADR] & 0x1F;
+    if (reg != PHSTAT1 && reg != PHSTAT2 && reg != PHID1 && reg != PHID2)
+        encPhy[reg] = encRegs[MIWRL] | (encRegs[MIWRH] << 8);
+}
+
+uint8_t readEncRegister(uint8_t address)
+{
+    return encRegs[address];
+}
+
+void writeEncRegister(uint8_t address, uint8_t value)
+{
+    uint8_t old = encRegs[address];
+
+    switch (address)
+    {
+        case EIR:
+            // PKTIF is read-only
+            encRegs[EIR] = (value & ~PKTIF) | (old & PKTIF);
+            updateEncInt();
+            break;
+        case ESTAT:
+            // only TXABORT can be cleared
+            encRegs[ESTAT] &= value | ~TXABORT;
+            break;
+        case ECON2:
+            encRegs[ECON2] = value & ~PKTDEC;
+            if ((value & PKTDEC) && encRegs[EPKTCNT] > 0)
+            {
+                encRegs[EPKTCNT]--;
+                updateEncInt();
+            }
+            break;
+        case ECON1:
+            encRegs[ECON1] = value;
+            // TXRST, or clearing TXRTS, aborts the frame on the wire
+            if (encTxBusy && ((value & TXRST) || !(value & TXRTS)))
+                endEncTx(true);
+            else if ((value & TXRTS) && !(old & TXRTS) && !(value & TXRST))
+                transmitEnc28j60Frame();
+            // only the checksum mode of the DMA is modelled
+            if ((value & DMAST) && !(old & DMAST))
+            {
+                if (value & CSUMEN)
+                    startEncDmaChecksum();
+                else
+                    encRegs[ECON1] &= ~DMAST;
+            }
+            else if (old & DMAST)
+                encRegs[ECON1] |= DMAST;            // cannot be cleared
+            break;
+        case EIE:
+            encRegs[EIE] = value;
+            updateEncInt();
+            break;
+        case EPKTCNT:
+        case MISTAT:
+        case MIRDL:
+        case MIRDH:
+        case EREVID:
+            break;
+        case ERXSTL:
+        case ERXSTH:
+            // ERXWRPT follows ERXST
+            encRegs[address] = value;
+            setEncPointer(ERXWRPTL, getEncPointer(ERXSTL));
+            break;
+        case MICMD:
+            encRegs[MICMD] = value;
+            if (value & MIIRD)
+            {
+                encRegs[MIRDL] = encPhy[encRegs[MIREGADR] & 0x1F] & 0xFF;
+                encRegs[MIRDH] = encPhy[encRegs[MIREGADR] & 0x1F] >> 8;
+            }
+            break;
+        case MIWRH:
+            encRegs[MIWRH] = value;
+            writeEncPhy();
+            break;
+        default:
+            encRegs[address] = value;
+    }
+}
+
+uint8_t readEncBuffer(void)
+{
+    uint16_t address = getEncPointer(ERDPTL);
+    uint8_t data = encSram[address];
+    if (encRegs[ECON2] & AUTOINC)
+        setEncPointer(ERDPTL, getEncRxNext(address));
+    return data;
+}
+
+void writeEncBuffer(uint8_t data)
+{
+    uint16_t address = getEncPointer(EWRPTL);
+    encSram[address] = data;
+    if (encRegs[ECON2] & AUTOINC)
+        setEncPointer(EWRPTL, (address + 1) & SRAM_MASK);
+}
+
+// CS is active low; each low period is one transaction
+void selectEnc28j60(bool cs)
+{
+    encSelected = !cs;
+    encByteIndex = 0;
+    if (encSelected)
+        encStats.transactions++;
+}
+
+// Exchanges one byte on the SPI bus and returns the byte shifted out
+uint8_t transferEnc28j60(uint8_t data)
+{
+    uint8_t out = 0;
+
+    if (!encSelected)
+        return 0xFF;
+    encStats.bytes++;
+    if (encByteIndex == 0)
+    {
+        serviceEncTx();
+        serviceEncDma();
+        encOpcode = data >> 5;
+        encAddress = getEncAddress(data & 0x1F);
+        encStats.opTransactions[encOpcode]++;
+        if (data == 0xFF)
+            resetEnc28j60();
+        encSelected = encOpcode != ENC_SRC || data != 0xFF;
+    }
+    else
+    {
+        switch (encOpcode)
+        {
+            case ENC_RCR:
+                if (isEncMacRegister(encAddress) && encByteIndex == 1)
+                    out = 0;                            // dummy byte
+                else
+                    out = readEncRegister(encAddress);
+                break;
+            case ENC_RBM:
+                out = readEncBuffer();
+                break;
+            case ENC_WCR:
+                if (encByteIndex == 1)
+                    writeEncRegister(encAddress, data);
+                break;
+            case ENC_WBM:
+                writeEncBuffer(data);
+                break;
+            case ENC_BFS:
+                if (encByteIndex == 1 && !isEncMacRegister(encAddress))
+                    writeEncRegister(encAddress, encRegs[encAddress] | data);
+                break;
+            case ENC_BFC:
+                if (encByteIndex == 1 && !isEncMacRegister(encAddress))
+                    writeEncRegister(encAddress, encRegs[encAddress] & ~data);
+                break;
+        }
+    }
+    encStats.opBytes[encOpcode]++;
+    encByteIndex++;
+    return out;
+}
+
+uint32_t getEncCrc(const uint8_t data[], uint16_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    uint16_t i;
+    uint8_t j;
+
+    for (i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// Pattern match filter: the IP checksum of the bytes EPMM selects from the
+// 64 byte window at EPMO has to equal EPMCS
+// The window has to fit in the frame as sent, padded to 60 bytes plus the
+// FCS; padding reads as 0 (the FCS itself is never selected here)
+bool isEncPatternMatch(const uint8_t frame[], uint16_t size)
+{
+    uint16_t offset = getEncPointer(EPMOL);
+    uint16_t wireSize = ((size < MIN_FRAME_SIZE) ? MIN_FRAME_SIZE : size) + CRC_SIZE;
+    uint32_t sum = 0;
+    bool odd = false;
+    uint8_t i, data;
+
+    if (offset + PATTERN_SIZE > wireSize)
+        return false;
+    for (i = 0; i < PATTERN_SIZE; i++)
+    {
+        if ((encRegs[EPMM0 + i / 8] & (1 << (i % 8))) == 0)
+            continue;
+        data = (offset + i < size) ? frame[offset + i] : 0;
+        sum += odd ? data : (data << 8);
+        odd = !odd;
+    }
+    while ((sum >> 16) != 0)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    // EPMCS is a full 16 bits, unlike the buffer pointers
+    return (uint16_t)~sum == (encRegs[EPMCSL] | (encRegs[EPMCSH] << 8));
+}
+
+// Hash table filter: bits 28:23 of the CRC of the destination address pick
+// a bit of EHT0-7
+bool isEncHashMatch(const uint8_t frame[])
+{
+    uint8_t bit = (getEncCrc(frame, 6) >> 23) & 0x3F;
+    return (encRegs[EHT0 + bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+// Applies ERXFCON (OR mode unless ANDOR is set)
+// The magic packet filter never matches here
+bool isEncFrameAccepted(const uint8_t frame[], uint16_t size)
+{
+    static const uint8_t broadcast[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+    uint8_t filters = encRegs[ERXFCON];
+    uint8_t matches = 0;
+    bool isBroadcast = memcmp(frame, broadcast, sizeof(broadcast)) == 0;
+
+    if ((filters & ~(CRCEN | ANDOR)) == 0)
+        return true;                                    // promiscuous
+    if (!isBroadcast && !(frame[0] & 1) &&
+        frame[0] == encRegs[MAADR5] && frame[1] == encRegs[MAADR4] &&
+        frame[2] == encRegs[MAADR3] && frame[3] == encRegs[MAADR2] &&
+        frame[4] == encRegs[MAADR1] && frame[5] == encRegs[MAADR0])
+        matches |= UCEN;
+    if (isBroadcast)
+        matches |= BCEN;
+    if (!isBroadcast && (frame[0] & 1))
+        matches |= MCEN;
+    if ((filters & PMEN) && isEncPatternMatch(frame, size))
+        matches |= PMEN;
+    if ((filters & HTEN) && isEncHashMatch(frame))
+        matches |= HTEN;
+    if (filters & ANDOR)
+        return (matches & filters & ~(CRCEN | ANDOR)) == (filters & ~(CRCEN | ANDOR));
+    return (matches & filters) != 0;
+}
+
+// Free space in the RX ring as computed by the datasheet (section 7.2.4)
+uint16_t getEncRxFreeSpace(void)
+{
+    uint16_t start = getEncPointer(ERXSTL);
+    uint16_t end = getEncPointer(ERXNDL);
+    uint16_t wr = getEncPointer(ERXWRPTL);
+    uint16_t rd = getEncPointer(ERXRDPTL);
+
+    if (wr > rd)
+        return (end - start) - (wr - rd);
+    if (wr == rd)
+        return end - start;
+    return rd - wr - 1;
+}
+
+// Delivers a frame from the wire (without FCS) into the RX ring
+// Returns false if the frame was filtered or dropped
+bool receiveEnc28j60Frame(const uint8_t frame[], uint16_t size)
+{
+    uint16_t count = size + CRC_SIZE;
+    uint16_t needed = RX_HEADER_SIZE + count;
+    uint16_t address = getEncPointer(ERXWRPTL);
+    uint16_t next;
+    uint32_t crc;
+    uint8_t header[RX_HEADER_SIZE];
+    uint16_t i;
+
+    if (!(encRegs[ECON1] & RXEN) || size < 14)
+        return false;
+    if (!isEncFrameAccepted(frame, size))
+    {
+        encStats.rxFiltered++;
+        return false;
+    }
+    if (needed & 1)
+        needed++;                                       // next packet starts even
+    if (needed > getEncRxFreeSpace() || encRegs[EPKTCNT] == 0xFF)
+    {
+        encStats.rxOverflows++;
+        encRegs[EIR] |= RXERIF;
+        updateEncInt();
+        return false;
+    }
+
+    next = address;
+    for (i = 0; i < needed; i++)
+        next = getEncRxNext(next);
+    header[0] = next & 0xFF;
+    header[1] = next >> 8;
+    header[2] = count & 0xFF;
+    header[3] = count >> 8;
+    header[4] = 0x80;                                   // received ok
+    header[5] = 0;
+    if (frame[0] & 1)
+        header[5] = (memcmp(frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0) ? 0x02 : 0x01;
+    for (i = 0; i < RX_HEADER_SIZE; i++)
+    {
+        encSram[address] = header[i];
+        address = getEncRxNext(address);
+    }
+    for (i = 0; i < size; i++)
+    {
+        encSram[address] = frame[i];
+        address = getEncRxNext(address);
+    }
+    crc = getEncCrc(frame, size);
+    for (i = 0; i < CRC_SIZE; i++)
+    {
+        encSram[address] = crc >> (8 * i);
+        address = getEncRxNext(address);
+    }
+    setEncPointer(ERXWRPTL, next);
+    encRegs[EPKTCNT]++;
+    encStats.rxFrames++;
+    updateEncInt();
+    return true;
+}
+
+uint8_t getEnc28j60PacketCount(void)
+{
+    return encRegs[EPKTCNT];
+}
+
+void getEnc28j60Stats(enc28j60Stats *stats)
+{
+    *stats = encStats;
+}
@@ -0,0 +1,75 @@
+// ENC28J60 Model Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Register-level model of the Microchip ENC28J60 as seen from its SPI port:
+// banked control registers, MAC/MII registers (with the dummy byte the chip
+// shifts out before their value), PHY registers through MIREGADR/MICMD,
+// the ERXFCON unicast, broadcast, multicast, pattern match and hash filters,
+// the 8 KB buffer SRAM with RBM/WBM auto-increment and RX wrap-around, the
+// RX ring (next packet pointer, status vector, ERXWRPT/ERXRDPT free space,
+// EPKTCNT and PKTDEC), TXRTS transmission with the TX status vector, the
+// EIR flags and the INT pin.
+// A transmission keeps TXRTS set for the frame's time on the wire at
+// 10 Mb/s (host time, see host.h), then sets TXIF; TXRST aborts it.
+// The DMA computes checksums (CSUMEN) at 80 ns per byte; copies are not
+// modelled.
+//
+// Every SPI byte and chip-select framed transaction is counted, in total and
+// per opcode.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef ENC28J60_H_
+#define ENC28J60_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// SPI opcodes (top 3 bits of the first byte of a transaction)
+#define ENC_RCR 0                   // read control register
+#define ENC_RBM 1                   // read buffer memory
+#define ENC_WCR 2                   // write control register
+#define ENC_WBM 3                   // write buffer memory
+#define ENC_BFS 4                   // bit field set
+#define ENC_BFC 5                   // bit field clear
+#define ENC_SRC 7                   // system reset command
+#define ENC_OPCODES 8
+
+typedef struct _enc28j60Stats
+{
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t opTransactions[ENC_OPCODES];
+    uint32_t opBytes[ENC_OPCODES];
+    uint32_t rxFrames;              // written to the RX ring
+    uint32_t rxFiltered;            // rejected by ERXFCON
+    uint32_t rxOverflows;           // no room in the RX ring or EPKTCNT full
+    uint32_t txFrames;
+} enc28j60Stats;
+
+typedef void (*_enc28j60TxHandler)(const uint8_t frame[], uint16_t size);
+typedef void (*_enc28j60IntHandler)(bool value);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void attachEnc28j60(_enc28j60TxHandler txHandler, _enc28j60IntHandler intHandler);
+void resetEnc28j60(void);
+void selectEnc28j60(bool cs);
+uint8_t transferEnc28j60(uint8_t data);
+bool receiveEnc28j60Frame(const uint8_t frame[], uint16_t size);
+uint8_t getEnc28j60PacketCount(void);
+void getEnc28j60Stats(enc28j60Stats *stats);
+
+#endif
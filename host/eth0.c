@@ -0,0 +1,307 @@
+// ETH0 Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Frame-level stand-in for the ENC28J60.  Frames come from and go to the
+// wire model (etherWire.c); with no configuration nothing is received and
+// transmitted frames are counted and discarded.  Received frames go through
+// the same unicast/broadcast/multicast filter the ENC28J60 applies for the
+// initEther() mode and the stack's setEtherRxFilter() peek, then wait in
+// a receive buffer of the size eth0.c gives the ENC28J60; a frame that does
+// not fit is lost and isEtherOverflow() reports it once.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eth0.h"
+#include "etherWire.h"
+
+#define MAX_FRAME_SIZE 1522
+#define RX_BUFFER_SIZE 0x1800           // ERXST to ERXND in eth0.c
+#define RX_HEADER_SIZE 6                // next pointer and status vector
+#define MAX_RX_FRAMES  128
+#define MIN_FRAME_SIZE 60               // padded, without the FCS
+#define CRC_SIZE       4
+
+typedef struct _etherRxFrame
+{
+    uint16_t size;
+    uint8_t data[MAX_FRAME_SIZE];
+} etherRxFrame;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t sequenceId = 1;
+uint8_t hwAddress[HW_ADD_LENGTH] = {2,3,4,5,6,7};
+uint16_t etherMode = 0;
+uint16_t etherPatternOffset = 0;
+uint8_t etherPattern[ETHER_PATTERN_SIZE];
+uint8_t etherPatternMask[ETHER_PATTERN_SIZE / 8];
+
+etherRxFrame etherRxFrames[MAX_RX_FRAMES];
+uint8_t etherRxHead = 0;
+uint8_t etherRxCount = 0;
+uint16_t etherRxUsed = 0;           // bytes of the receive buffer in use
+bool etherRxOverflowed = false;
+uint32_t etherRxFiltered = 0;
+uint32_t etherRxOverflows = 0;
+uint32_t etherRxTaken = 0;
+uint32_t etherRxDropped = 0;            // by the stack's rx filter
+_etherRxFilter etherRxFilter = NULL;
+uint32_t etherTxFrames = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool isEtherLinkUp(void)
+{
+    return true;
+}
+
+// Compares the bytes the pattern mask selects (the ENC28J60 compares their
+// checksum instead); the window has to fit in the frame padded to 60 bytes
+// plus the FCS
+bool isEtherPatternMatch(const uint8_t frame[], uint16_t size)
+{
+    uint16_t wireSize = ((size < MIN_FRAME_SIZE) ? MIN_FRAME_SIZE : size) + CRC_SIZE;
+    uint8_t i, data;
+
+    if (etherPatternOffset + ETHER_PATTERN_SIZE > wireSize)
+        return false;
+    for (i = 0; i < ETHER_PATTERN_SIZE; i++)
+    {
+        if ((etherPatternMask[i / 8] & (1 << (i % 8))) == 0)
+            continue;
+        data = (etherPatternOffset + i < size) ? frame[etherPatternOffset + i] : 0;
+        if (data != etherPattern[i])
+            return false;
+    }
+    return true;
+}
+
+// Applies the receive filters selected by the initEther() or
+// setEtherFilterMode() mode (OR'ed, hash table not modeled)
+bool isEtherFrameAccepted(const uint8_t frame[], uint16_t size)
+{
+    static const uint8_t broadcast[HW_ADD_LENGTH] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+
+    if (size < sizeof(etherHeader))
+        return false;
+    if ((etherMode & ETHER_PATTERNMATCH) && isEtherPatternMatch(frame, size))
+        return true;
+    if (memcmp(frame, broadcast, HW_ADD_LENGTH) == 0)
+        return (etherMode & ETHER_BROADCAST) != 0;
+    if (frame[0] & 1)
+        return (etherMode & ETHER_MULTICAST) != 0;
+    return (etherMode & ETHER_UNICAST) != 0 && memcmp(frame, hwAddress, HW_ADD_LENGTH) == 0;
+}
+
+// Space a frame takes in the ENC28J60 receive buffer, CRC included
+uint16_t getEtherRxSpace(uint16_t size)
+{
+    return (RX_HEADER_SIZE + size + CRC_SIZE + 1) & ~1;
+}
+
+// Frames that finish arriving from the wire
+void receiveEtherFrame(const uint8_t frame[], uint16_t size)
+{
+    etherRxFrame *f;
+
+    if (!isEtherFrameAccepted(frame, size))
+    {
+        etherRxFiltered++;
+        return;
+    }
+    if (etherRxFilter != NULL &&
+        !(*etherRxFilter)((etherHeader*)frame, (size < ETHER_PEEK_SIZE) ? size : ETHER_PEEK_SIZE))
+    {
+        etherRxDropped++;
+        return;
+    }
+    if (etherRxCount == MAX_RX_FRAMES || etherRxUsed + getEtherRxSpace(size) > RX_BUFFER_SIZE)
+    {
+        etherRxOverflows++;
+        etherRxOverflowed = true;
+        return;
+    }
+    f = &etherRxFrames[(etherRxHead + etherRxCount) % MAX_RX_FRAMES];
+    f->size = size;
+    memcpy(f->data, frame, size);
+    etherRxUsed += getEtherRxSpace(size);
+    etherRxCount++;
+}
+
+void initEther(uint16_t mode)
+{
+    etherMode = mode;
+    initEtherWire();
+    attachEtherWireReceiver(receiveEtherFrame);
+}
+
+void reportEtherBackend(void)
+{
+    fprintf(stderr, "  filtered: %u frames, overflowed: %u frames\n", etherRxFiltered, etherRxOverflows);
+}
+
+// A replay keeps one frame waiting
+bool isEtherDataAvailable(void)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint16_t size;
+
+    endEtherWireFrame();
+    while (etherRxCount == 0 && isEtherWireReplaying())
+    {
+        size = getEtherWireFrame(frame, MAX_FRAME_SIZE);
+        receiveEtherFrame(frame, size);
+    }
+    return etherRxCount != 0;
+}
+
+bool isEtherOverflow(void)
+{
+    bool overflowed = etherRxOverflowed;
+    etherRxOverflowed = false;
+    return overflowed;
+}
+
+uint16_t getEtherPacket(etherHeader *ether, uint16_t maxSize)
+{
+    etherRxFrame *f = &etherRxFrames[etherRxHead];
+    uint16_t size;
+
+    if (etherRxCount == 0)
+        return 0;
+    size = f->size;
+    if (size > maxSize)
+        size = maxSize;
+    memcpy(ether, f->data, size);
+    etherRxUsed -= getEtherRxSpace(f->size);
+    etherRxTaken++;
+    etherRxHead = (etherRxHead + 1) % MAX_RX_FRAMES;
+    etherRxCount--;
+    if (size > 0)
+        startEtherWireFrame(size);
+    return size;
+}
+
+void setEtherFilterMode(uint16_t mode)
+{
+    etherMode = mode;
+}
+
+void setEtherPatternFilter(uint16_t offset, const uint8_t pattern[ETHER_PATTERN_SIZE],
+                           const uint8_t mask[ETHER_PATTERN_SIZE / 8])
+{
+    etherPatternOffset = offset;
+    memcpy(etherPattern, pattern, ETHER_PATTERN_SIZE);
+    memcpy(etherPatternMask, mask, ETHER_PATTERN_SIZE / 8);
+}
+
+void setEtherRxFilter(_etherRxFilter filter)
+{
+    etherRxFilter = filter;
+}
+
+// Frames are taken straight from the receive buffer, so the ring never stalls
+void getEtherRxStats(etherRxStats *stats)
+{
+    stats->frames = etherRxTaken;
+    stats->filtered = etherRxDropped;
+    stats->badChecksums = 0;
+    stats->stalls = 0;
+    stats->overflows = etherRxOverflows;
+    stats->queued = etherRxCount;
+}
+
+// There is no checksum engine here; the stack sums in software
+void setEtherChecksumOffload(bool enable)
+{
+}
+
+bool isEtherChecksumOffload(uint16_t size)
+{
+    return false;
+}
+
+void setEtherTxChecksum(etherHeader *ether, uint16_t start, uint16_t field)
+{
+}
+
+bool isEtherTcpChecksumVerified(etherHeader *ether)
+{
+    return false;
+}
+
+// Frames go straight to the wire, so none is ever waiting for a slot
+void getEtherTxStats(etherTxStats *stats)
+{
+    stats->frames = etherTxFrames;
+    stats->aborts = 0;
+    stats->waits = 0;
+    stats->queued = 0;
+}
+
+bool putEtherPacket(etherHeader *ether, uint16_t size)
+{
+    putEtherWireFrame((uint8_t*)ether, size);
+    etherTxFrames++;
+    return true;
+}
+
+// Converts from host to network order and vice versa
+uint16_t htons(uint16_t value)
+{
+    return ((value & 0xFF00) >> 8) + ((value & 0x00FF) << 8);
+}
+
+uint32_t htonl(uint32_t value)
+{
+    return ((value & 0xFF000000) >> 24) + ((value & 0x00FF0000) >> 8) +
+           ((value & 0x0000FF00) << 8) + ((value & 0x000000FF) << 24);
+}
+
+uint16_t getEtherId(void)
+{
+    return htons(sequenceId);
+}
+
+void incEtherId(void)
+{
+    sequenceId++;
+}
+
+// Sets MAC address
+void setEtherMacAddress(uint8_t mac0, uint8_t mac1, uint8_t mac2, uint8_t mac3, uint8_t mac4, uint8_t mac5)
+{
+    hwAddress[0] = mac0;
+    hwAddress[1] = mac1;
+    hwAddress[2] = mac2;
+    hwAddress[3] = mac3;
+    hwAddress[4] = mac4;
+    hwAddress[5] = mac5;
+}
+
+// Gets MAC address
+void getEtherMacAddress(uint8_t mac[HW_ADD_LENGTH])
+{
+    uint8_t i;
+    for (i = 0; i < HW_ADD_LENGTH; i++)
+        mac[i] = hwAddress[i];
+}
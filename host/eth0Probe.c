@@ -0,0 +1,220 @@
+// ETH0 Probe Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build, ETH=enc28j60)
+// Target uC:       -
+// System Clock:    -
+
+// Runs the target eth0.c against the ENC28J60 model on spi0 (CS on PA3,
+// INT on PC6) and connects the model to the wire (etherWire.c).
+//
+// The eth0.h entry points used by the stack are wrapped at link time
+// (-Wl,--wrap) so the SPI traffic each call generates can be charged to it:
+//   rx   etherIsr(), attached to PORTC in place of the GPIO Port C vector,
+//        per frame it drains into the receive ring, filters out or drops
+//        for a bad checksum
+//   tx   putEtherPacket()
+//   poll isEtherDataAvailable() and isEtherOverflow()
+//   init initEther()
+// Everything else (link status, MAC address) is reported as other.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "eth0.h"
+#include "gpio.h"
+#include "host.h"
+#include "enc28j60.h"
+#include "etherWire.h"
+
+#define MAX_FRAME_SIZE 1522
+#define SPI0_BAUD_RATE 10e6
+
+typedef enum _ethProbe
+{
+    PROBE_INIT, PROBE_POLL, PROBE_RX, PROBE_TX, PROBE_OTHER, PROBE_COUNT
+} ethProbe;
+
+typedef struct _ethProbeStats
+{
+    uint32_t calls;
+    uint32_t transactions;
+    uint32_t bytes;
+} ethProbeStats;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+ethProbeStats ethProbes[PROBE_COUNT];
+enc28j60Stats ethProbeStart;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void __real_initEther(uint16_t mode);
+bool __real_isEtherDataAvailable(void);
+bool __real_isEtherOverflow(void);
+uint16_t __real_getEtherPacket(etherHeader *ether, uint16_t maxSize);
+bool __real_putEtherPacket(etherHeader *ether, uint16_t size);
+void etherIsr(void);
+
+void startEthProbe(void)
+{
+    getEnc28j60Stats(&ethProbeStart);
+}
+
+void endEthProbe(ethProbe probe, uint32_t calls)
+{
+    enc28j60Stats now;
+    getEnc28j60Stats(&now);
+    ethProbes[probe].calls += calls;
+    ethProbes[probe].transactions += now.transactions - ethProbeStart.transactions;
+    ethProbes[probe].bytes += now.bytes - ethProbeStart.bytes;
+}
+
+void sendWireFrame(const uint8_t frame[], uint16_t size)
+{
+    putEtherWireFrame(frame, size);
+}
+
+void setEtherIntPin(bool value)
+{
+    setPinValue(PORTC, 6, value);
+}
+
+// GPIO Port C vector: the frames etherIsr() drains are charged to rx, and
+// not to the call it interrupted
+void etherPortIsr(void)
+{
+    enc28j60Stats interrupted = ethProbeStart;
+    enc28j60Stats start, end;
+    etherRxStats before, after;
+
+    getEtherRxStats(&before);
+    startEthProbe();
+    start = ethProbeStart;
+    etherIsr();
+    getEtherRxStats(&after);
+    endEthProbe(PROBE_RX, after.frames + after.filtered + after.badChecksums
+                          - before.frames - before.filtered - before.badChecksums);
+    getEnc28j60Stats(&end);
+    interrupted.transactions += end.transactions - start.transactions;
+    interrupted.bytes += end.bytes - start.bytes;
+    ethProbeStart = interrupted;
+}
+
+void receiveWireFrame(const uint8_t frame[], uint16_t size)
+{
+    receiveEnc28j60Frame(frame, size);
+}
+
+void __wrap_initEther(uint16_t mode)
+{
+    attachEnc28j60(sendWireFrame, setEtherIntPin);
+    attachSpi0Device(transferEnc28j60);
+    attachPinHook(PORTA, 3, selectEnc28j60);
+    attachPortIsr(PORTC, etherPortIsr);
+    setPinValue(PORTA, 3, 1);
+    setPinValue(PORTC, 6, 1);
+    initEtherWire();
+    attachEtherWireReceiver(receiveWireFrame);
+    startEthProbe();
+    __real_initEther(mode);
+    endEthProbe(PROBE_INIT, 1);
+}
+
+// Keeps one replayed frame waiting, in the ENC28J60 or in the ring
+// etherIsr() drains it into (frames the rx filter drops don't count)
+bool __wrap_isEtherDataAvailable(void)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint16_t size;
+    bool ok;
+
+    endEtherWireFrame();
+    while (isEtherWireReplaying() && getEnc28j60PacketCount() == 0 && !__real_isEtherDataAvailable())
+    {
+        size = getEtherWireFrame(frame, MAX_FRAME_SIZE);
+        receiveEnc28j60Frame(frame, size);
+    }
+    startEthProbe();
+    ok = __real_isEtherDataAvailable();
+    endEthProbe(PROBE_POLL, 1);
+    return ok;
+}
+
+bool __wrap_isEtherOverflow(void)
+{
+    bool ok;
+    startEthProbe();
+    ok = __real_isEtherOverflow();
+    endEthProbe(PROBE_POLL, 1);
+    return ok;
+}
+
+uint16_t __wrap_getEtherPacket(etherHeader *ether, uint16_t maxSize)
+{
+    uint16_t size = __real_getEtherPacket(ether, maxSize);
+    startEtherWireFrame(size);
+    return size;
+}
+
+bool __wrap_putEtherPacket(etherHeader *ether, uint16_t size)
+{
+    bool ok;
+    startEthProbe();
+    ok = __real_putEtherPacket(ether, size);
+    endEthProbe(PROBE_TX, 1);
+    return ok;
+}
+
+void reportEthProbe(const char *name, ethProbe probe, const char *per)
+{
+    ethProbeStats *p = &ethProbes[probe];
+    if (p->calls == 0)
+        return;
+    fprintf(stderr, "    %-5s %8u %-6s %7.1f transactions %8.1f bytes per %s\n", name, p->calls,
+            per, (double)p->transactions / p->calls, (double)p->bytes / p->calls, per);
+}
+
+void reportEtherBackend(void)
+{
+    static const char *opNames[ENC_OPCODES] = {"RCR", "RBM", "WCR", "WBM", "BFS", "BFC", "-", "SRC"};
+    enc28j60Stats stats;
+    uint32_t known = 0;
+    uint8_t i;
+
+    getEnc28j60Stats(&stats);
+    for (i = 0; i < PROBE_OTHER; i++)
+        known += ethProbes[i].bytes;
+    ethProbes[PROBE_OTHER].calls = 1;
+    ethProbes[PROBE_OTHER].bytes = stats.bytes - known;
+    ethProbes[PROBE_OTHER].transactions = stats.transactions;
+    for (i = 0; i < PROBE_OTHER; i++)
+        ethProbes[PROBE_OTHER].transactions -= ethProbes[i].transactions;
+
+    fprintf(stderr, "  enc28j60: %u frames received, %u filtered, %u overflowed, %u sent\n",
+            stats.rxFrames, stats.rxFiltered, stats.rxOverflows, stats.txFrames);
+    fprintf(stderr, "  spi0: %u transactions, %u bytes (%.3f ms at %.0f MHz)\n",
+            stats.transactions, stats.bytes, stats.bytes * 8 / SPI0_BAUD_RATE * 1e3, SPI0_BAUD_RATE / 1e6);
+    reportEthProbe("rx", PROBE_RX, "frame");
+    reportEthProbe("tx", PROBE_TX, "frame");
+    reportEthProbe("poll", PROBE_POLL, "call");
+    reportEthProbe("init", PROBE_INIT, "call");
+    reportEthProbe("other", PROBE_OTHER, "run");
+    fprintf(stderr, "    opcodes:");
+    for (i = 0; i < ENC_OPCODES; i++)
+        if (stats.opTransactions[i] != 0)
+            fprintf(stderr, " %s %u/%u", opNames[i], stats.opTransactions[i], stats.opBytes[i]);
+    fprintf(stderr, " (transactions/bytes)\n");
+}
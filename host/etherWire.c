@@ -0,0 +1,262 @@
+// Ethernet Wire Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "etherWire.h"
+#include "host.h"
+#include "pcap.h"
+#include "mqttBroker.h"
+
+#define MAX_FRAME_SIZE  1522
+#define MAX_WIRE_FRAMES 256
+#define WIRE_TICK_US    20
+#define WIRE_BYTE_NS    800             // 10 Mb/s
+#define WIRE_OVERHEAD   24              // preamble, CRC and interframe gap
+
+typedef struct _wireFrame
+{
+    uint64_t due;                       // ns, last bit received
+    uint16_t size;
+    uint8_t data[MAX_FRAME_SIZE];
+} wireFrame;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+pcapFile wireRxPcap = {NULL};
+pcapFile wireTxPcap = {NULL};
+const char *wireTxPath = NULL;
+uint32_t wireLoopsLeft = 0;
+
+uint32_t wireRxFrames = 0;
+uint32_t wireRxBytes = 0;
+uint32_t wireTxFrames = 0;
+uint32_t wireTxBytes = 0;
+
+uint64_t wireReplayStart = 0;       // ns
+uint64_t wireFrameStart = 0;        // ns, 0 when no frame is being processed
+uint64_t wireFrameTotal = 0;        // ns
+uint64_t wireFrameMin = UINT64_MAX;
+uint64_t wireFrameMax = 0;
+
+_etherWireReceiver wireReceiver = NULL;
+wireFrame wireQueue[MAX_WIRE_FRAMES];
+uint16_t wireQueueHead = 0;
+uint16_t wireQueueCount = 0;
+uint64_t wireDelayNs = 500000;
+uint64_t wireFreeNs = 0;            // the far end's transmitter is busy until then
+bool wireTimerAttached = false;
+uint32_t wireQueued = 0;
+uint32_t wireQueueDrops = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEtherWire(void)
+{
+    if (getenv("ETH0_PCAP_IN") != NULL)
+    {
+        if (!openPcapReader(&wireRxPcap, getenv("ETH0_PCAP_IN")))
+        {
+            fprintf(stderr, "eth0: cannot read pcap %s\n", getenv("ETH0_PCAP_IN"));
+            exit(1);
+        }
+        wireLoopsLeft = 1;
+        if (getenv("ETH0_PCAP_LOOPS") != NULL)
+            wireLoopsLeft = strtoul(getenv("ETH0_PCAP_LOOPS"), NULL, 0);
+    }
+    wireTxPath = getenv("ETH0_PCAP_OUT");
+    if (wireTxPath != NULL && !openPcapWriter(&wireTxPcap, wireTxPath))
+    {
+        fprintf(stderr, "eth0: cannot write pcap %s\n", wireTxPath);
+        exit(1);
+    }
+    if (getenv("ETH0_WIRE_US") != NULL)
+        wireDelayNs = strtoull(getenv("ETH0_WIRE_US"), NULL, 0) * 1000;
+    initMqttBroker();
+    if (isMqttBrokerAttached() && isEtherWireReplaying())
+    {
+        fprintf(stderr, "eth0: ETH0_PCAP_IN and MQTT_BROKER cannot be used together\n");
+        exit(1);
+    }
+}
+
+bool isEtherWireReplaying(void)
+{
+    return wireRxPcap.file != NULL;
+}
+
+void reportEtherWire(void)
+{
+    uint64_t elapsed = getHostTimeNs() - wireReplayStart;
+
+    fprintf(stderr, "eth0 replay: %u frames (%u bytes) in %.3f ms\n",
+            wireRxFrames, wireRxBytes, elapsed / 1e6);
+    if (wireRxFrames > 0)
+    {
+        fprintf(stderr, "  rx: %.0f frames/s wall, %.0f frames/s processing\n",
+                wireRxFrames / (elapsed / 1e9), wireRxFrames / (wireFrameTotal / 1e9));
+        fprintf(stderr, "  per frame: avg %.3f us, min %.3f us, max %.3f us\n",
+                wireFrameTotal / 1e3 / wireRxFrames, wireFrameMin / 1e3, wireFrameMax / 1e3);
+    }
+    fprintf(stderr, "  tx: %u frames (%u bytes)%s%s\n", wireTxFrames, wireTxBytes,
+            wireTxPath != NULL ? " -> " : "", wireTxPath != NULL ? wireTxPath : "");
+    reportEtherBackend();
+}
+
+// Returns the next frame from the replay file, or 0 if there is none
+// The report is printed and the process ends after the last loop
+uint16_t getEtherWireFrame(uint8_t frame[], uint16_t maxSize)
+{
+    int32_t size = PCAP_EOF;
+
+    if (wireRxPcap.file == NULL)
+        return 0;
+    if (wireReplayStart == 0)
+        wireReplayStart = getHostTimeNs();
+    while (size == PCAP_EOF)
+    {
+        size = readPcapFrame(&wireRxPcap, frame, maxSize, NULL);
+        if (size == PCAP_EOF)
+        {
+            if (wireLoopsLeft > 1)
+            {
+                wireLoopsLeft--;
+                rewindPcap(&wireRxPcap);
+                continue;
+            }
+            reportEtherWire();
+            closePcap(&wireRxPcap);
+            closePcap(&wireTxPcap);
+            exit(0);
+        }
+    }
+    markHostActivity();
+    return size;
+}
+
+void putEtherWireFrame(const uint8_t frame[], uint16_t size)
+{
+    wireTxFrames++;
+    wireTxBytes += size;
+    markHostActivity();
+    if (wireTxPcap.file != NULL)
+        writePcapFrame(&wireTxPcap, frame, size, getHostTime());
+    receiveMqttBrokerFrame(frame, size);
+}
+
+void attachEtherWireReceiver(_etherWireReceiver receiver)
+{
+    wireReceiver = receiver;
+}
+
+// Hands the frames that have finished arriving to the backend
+void tickEtherWire(void)
+{
+    uint64_t now = getHostTimeNs();
+    wireFrame *f;
+
+    while (wireQueueCount != 0 && wireQueue[wireQueueHead].due <= now)
+    {
+        f = &wireQueue[wireQueueHead];
+        if (wireReceiver != NULL)
+            (*wireReceiver)(f->data, f->size);
+        wireQueueHead = (wireQueueHead + 1) % MAX_WIRE_FRAMES;
+        wireQueueCount--;
+        markHostActivity();
+    }
+}
+
+// Returns how many wire ticks will pass before a frame finishes arriving
+uint32_t getEtherWireIdleTicks(void)
+{
+    uint64_t now = getHostTimeNs();
+    uint64_t due;
+
+    if (wireQueueCount == 0)
+        return UINT32_MAX;
+    due = wireQueue[wireQueueHead].due;
+    if (due <= now + WIRE_TICK_US * 1000)
+        return 0;
+    return (due - now) / (WIRE_TICK_US * 1000) - 1;
+}
+
+// Sends a frame from the far end; it starts to arrive ETH0_WIRE_US later,
+// or once the frames ahead of it have gone out
+bool queueEtherWireFrame(const uint8_t frame[], uint16_t size)
+{
+    uint64_t start = getHostTimeNs() + wireDelayNs;
+    wireFrame *f;
+
+    if (wireQueueCount == MAX_WIRE_FRAMES || size > MAX_FRAME_SIZE)
+    {
+        wireQueueDrops++;
+        return false;
+    }
+    if (!wireTimerAttached)
+        wireTimerAttached = attachHostTimer(tickEtherWire, WIRE_TICK_US, getEtherWireIdleTicks, NULL);
+    if (start < wireFreeNs)
+        start = wireFreeNs;
+    f = &wireQueue[(wireQueueHead + wireQueueCount) % MAX_WIRE_FRAMES];
+    f->due = start + (uint64_t)(size + WIRE_OVERHEAD) * WIRE_BYTE_NS;
+    f->size = size;
+    memcpy(f->data, frame, size);
+    wireFreeNs = f->due;
+    wireQueueCount++;
+    wireQueued++;
+    return true;
+}
+
+void getEtherWireStats(etherWireStats *stats)
+{
+    stats->rxFrames = wireRxFrames;
+    stats->rxBytes = wireRxBytes;
+    stats->txFrames = wireTxFrames;
+    stats->txBytes = wireTxBytes;
+    stats->queued = wireQueued;
+    stats->queueDrops = wireQueueDrops;
+    stats->frameNs = wireFrameTotal;
+    stats->frameMaxNs = wireFrameMax;
+}
+
+// Marks a frame handed to the stack
+void startEtherWireFrame(uint16_t size)
+{
+    wireRxFrames++;
+    wireRxBytes += size;
+    wireFrameStart = getHostTimeNs();
+}
+
+// Ends the processing time of the frame last handed to the stack
+void endEtherWireFrame(void)
+{
+    uint64_t time;
+
+    if (wireFrameStart == 0)
+        return;
+    time = getHostTimeNs() - wireFrameStart;
+    wireFrameTotal += time;
+    if (time < wireFrameMin)
+        wireFrameMin = time;
+    if (time > wireFrameMax)
+        wireFrameMax = time;
+    wireFrameStart = 0;
+}
@@ -0,0 +1,78 @@
+// Ethernet Wire Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// The far side of the Ethernet cable for the host eth0 backends.
+//
+// Environment:
+//   ETH0_PCAP_IN=file     replay the frames in file through main()'s loop as
+//                         fast as it consumes them, then print a report to
+//                         stderr and exit
+//   ETH0_PCAP_LOOPS=n     replay the file n times (default 1)
+//   ETH0_PCAP_OUT=file    write every transmitted frame to file
+//   ETH0_WIRE_US=us       delay from a frame leaving the far end until it
+//                         starts to arrive, default 500 (a LAN round trip)
+//
+// The far end (mqttBroker.c) answers transmitted frames and queues frames
+// of its own with queueEtherWireFrame().  Those go out one after another at
+// 10 Mb/s and are handed to the backend's receiver as they finish arriving,
+// from an interrupt, so they can overrun its receive buffer while the
+// firmware is busy, as they would the ENC28J60's.
+//
+// The processing time of a frame runs from startEtherWireFrame() until
+// endEtherWireFrame(); the backends mark these from getEtherPacket() and
+// isEtherDataAvailable(), so a frame's time covers the packet handlers plus
+// one pass of the shell, transmission and wireless tasks, but not the pcap
+// file reads.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef ETHERWIRE_H_
+#define ETHERWIRE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*_etherWireReceiver)(const uint8_t frame[], uint16_t size);
+
+typedef struct _etherWireStats
+{
+    uint32_t rxFrames;              // handed to the stack
+    uint32_t rxBytes;
+    uint32_t txFrames;
+    uint32_t txBytes;
+    uint32_t queued;                // sent by the far end
+    uint32_t queueDrops;            // far end sent faster than the wire queue holds
+    uint64_t frameNs;               // processing time of the frames handed to the stack
+    uint64_t frameMaxNs;
+} etherWireStats;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEtherWire(void);
+bool isEtherWireReplaying(void);
+uint16_t getEtherWireFrame(uint8_t frame[], uint16_t maxSize);
+void putEtherWireFrame(const uint8_t frame[], uint16_t size);
+void startEtherWireFrame(uint16_t size);
+void endEtherWireFrame(void);
+void getEtherWireStats(etherWireStats *stats);
+
+// Frames sent by the far end
+void attachEtherWireReceiver(_etherWireReceiver receiver);
+bool queueEtherWireFrame(const uint8_t frame[], uint16_t size);
+
+// Supplied by the eth0 backend, called at the end of the replay report
+void reportEtherBackend(void);
+
+#endif
@@ -0,0 +1,273 @@
+// GPIO Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Hardware configuration:
+// Pin levels are kept in RAM; inputs read back whatever was last written
+// (pull-ups read as 1 until driven)
+// Pin interrupts follow the GPIO IS/IBE/IEV/IM/RIS registers: edges are
+// latched until cleared, levels are pending while they hold, and the port
+// isr attached with attachPortIsr() is called at the next poll point
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "gpio.h"
+#include "host.h"
+
+#define PORT_COUNT 6
+#define MAX_PIN_HOOKS 8
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t portData[PORT_COUNT];
+uint8_t portPullup[PORT_COUNT];
+uint8_t portIs[PORT_COUNT];         // level sensitive
+uint8_t portIbe[PORT_COUNT];        // both edges
+uint8_t portIev[PORT_COUNT];        // rising edge or high level
+uint8_t portIm[PORT_COUNT];
+uint8_t portRis[PORT_COUNT];        // latched edges
+_hostIsr portIsrs[PORT_COUNT];
+
+typedef struct _pinHookEntry
+{
+    _hostPinHook hook;
+    uint8_t port;
+    uint8_t pin;
+} pinHookEntry;
+
+pinHookEntry pinHooks[MAX_PIN_HOOKS];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t getPortIndex(PORT port)
+{
+    switch(port)
+    {
+        case PORTA: return 0;
+        case PORTB: return 1;
+        case PORTC: return 2;
+        case PORTD: return 3;
+        case PORTE: return 4;
+        default:    return 5;
+    }
+}
+
+void enablePort(PORT port)
+{
+}
+
+void disablePort(PORT port)
+{
+}
+
+void selectPinPushPullOutput(PORT port, uint8_t pin)
+{
+}
+
+void selectPinOpenDrainOutput(PORT port, uint8_t pin)
+{
+}
+
+void selectPinDigitalInput(PORT port, uint8_t pin)
+{
+}
+
+void selectPinAnalogInput(PORT port, uint8_t pin)
+{
+}
+
+void setPinCommitControl(PORT port, uint8_t pin)
+{
+}
+
+void enablePinPullup(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portPullup[i] |= 1 << pin;
+    portData[i] |= 1 << pin;
+}
+
+void disablePinPullup(PORT port, uint8_t pin)
+{
+    portPullup[getPortIndex(port)] &= ~(1 << pin);
+}
+
+void enablePinPulldown(PORT port, uint8_t pin)
+{
+}
+
+void disablePinPulldown(PORT port, uint8_t pin)
+{
+}
+
+void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn)
+{
+}
+
+void selectPinInterruptRisingEdge(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portIs[i] &= ~(1 << pin);
+    portIbe[i] &= ~(1 << pin);
+    portIev[i] |= 1 << pin;
+}
+
+void selectPinInterruptFallingEdge(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portIs[i] &= ~(1 << pin);
+    portIbe[i] &= ~(1 << pin);
+    portIev[i] &= ~(1 << pin);
+}
+
+void selectPinInterruptBothEdges(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portIs[i] &= ~(1 << pin);
+    portIbe[i] |= 1 << pin;
+}
+
+void selectPinInterruptHighLevel(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portIs[i] |= 1 << pin;
+    portIev[i] |= 1 << pin;
+}
+
+void selectPinInterruptLowLevel(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portIs[i] |= 1 << pin;
+    portIev[i] &= ~(1 << pin);
+}
+
+// Pins of a port whose interrupt is asserted and unmasked
+uint8_t getPortPending(uint8_t i)
+{
+    uint8_t level = portIs[i] & ~(portIev[i] ^ portData[i]);
+    return (level | (portRis[i] & ~portIs[i])) & portIm[i];
+}
+
+// Lets a pending interrupt in as soon as the firmware can take it
+void raisePortIsr(uint8_t i)
+{
+    if (portIsrs[i] != NULL && getPortPending(i) != 0)
+    {
+        markHostActivity();
+        pollHost();
+    }
+}
+
+void enablePinInterrupt(PORT port, uint8_t pin)
+{
+    uint8_t i = getPortIndex(port);
+    portIm[i] |= 1 << pin;
+    raisePortIsr(i);
+}
+
+void disablePinInterrupt(PORT port, uint8_t pin)
+{
+    portIm[getPortIndex(port)] &= ~(1 << pin);
+}
+
+void clearPinInterrupt(PORT port, uint8_t pin)
+{
+    portRis[getPortIndex(port)] &= ~(1 << pin);
+}
+
+// The host equivalent of the GPIO port vector
+bool attachPortIsr(PORT port, _hostIsr isr)
+{
+    portIsrs[getPortIndex(port)] = isr;
+    return true;
+}
+
+// Calls the isr of the first port with an interrupt pending
+// Returns false if none was
+bool servicePortIsrs(void)
+{
+    uint8_t i;
+    for (i = 0; i < PORT_COUNT; i++)
+    {
+        if (portIsrs[i] != NULL && getPortPending(i) != 0)
+        {
+            (*portIsrs[i])();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Calls the model watching a pin when its level changes
+bool attachPinHook(PORT port, uint8_t pin, _hostPinHook hook)
+{
+    uint8_t i = 0;
+    bool found = false;
+    while (i < MAX_PIN_HOOKS && !found)
+    {
+        found = pinHooks[i].hook == NULL;
+        if (found)
+        {
+            pinHooks[i].hook = hook;
+            pinHooks[i].port = getPortIndex(port);
+            pinHooks[i].pin = pin;
+        }
+        i++;
+    }
+    return found;
+}
+
+void setPinValue(PORT port, uint8_t pin, bool value)
+{
+    uint8_t i = getPortIndex(port);
+    uint8_t old = portData[i];
+    uint8_t j;
+    if (value)
+        portData[i] |= 1 << pin;
+    else
+        portData[i] &= ~(1 << pin);
+    if (portData[i] == old)
+        return;
+    for (j = 0; j < MAX_PIN_HOOKS; j++)
+        if (pinHooks[j].hook != NULL && pinHooks[j].port == i && pinHooks[j].pin == pin)
+            (*pinHooks[j].hook)(value);
+    if ((portIbe[i] & (1 << pin)) || ((portIev[i] >> pin) & 1) == value)
+        portRis[i] |= 1 << pin;
+    raisePortIsr(i);
+}
+
+void togglePinValue(PORT port, uint8_t pin)
+{
+    setPinValue(port, pin, !getPinValue(port, pin));
+}
+
+bool getPinValue(PORT port, uint8_t pin)
+{
+    return (portData[getPortIndex(port)] >> pin) & 1;
+}
+
+void setPortValue(PORT port, uint8_t value)
+{
+    portData[getPortIndex(port)] = value;
+}
+
+uint8_t getPortValue(PORT port)
+{
+    return portData[getPortIndex(port)];
+}
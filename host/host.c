@@ -0,0 +1,394 @@
+// Host Support Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Environment:
+//   HOST_CLOCK     "virtual" runs the firmware on a simulated clock: busy
+//                  waits and charged bus time advance it exactly, interrupts
+//                  are delivered at their due times, and once the superloop
+//                  has made HOST_IDLE_PASSES passes without anything
+//                  happening the clock skips to the next interrupt that has
+//                  work to do.  Nothing depends on the wall clock, so a run
+//                  is repeatable bit for bit, and hours of idle time pass in
+//                  moments.  Default "real" follows CLOCK_MONOTONIC.
+//   HOST_SECONDS   ends the run after that much host time, default 0 (never)
+//   HOST_SEED      seed of getHostRandom(), default fixed
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host.h"
+
+#define MAX_HOST_ISRS    8
+#define HOST_IDLE_PASSES 2              // quiet superloop passes before the clock skips
+#define HOST_SPIN_US     100            // shorter waits spin instead of sleeping
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+typedef struct _hostIsrEntry
+{
+    _hostIsr isr;
+    _hostIdleTicks idle;            // NULL if every tick may do work
+    _hostSkipTicks skip;
+    uint32_t period;                // us
+    uint64_t due;                   // us
+} hostIsrEntry;
+
+hostIsrEntry hostIsrs[MAX_HOST_ISRS];
+bool hostInIsr = false;
+bool hostReady = false;
+uint64_t hostStartTime = 0;
+uint32_t hostRandomState = 0x2545F491;
+uint32_t hostChargedNs = 0;           // charged but not yet spent
+
+bool hostClockVirtual = false;
+uint64_t hostVirtualNs = 0;
+uint64_t hostEndNs = 0;               // 0 to run until the firmware exits
+bool hostActivity = false;
+uint8_t hostIdlePasses = 0;
+uint64_t hostIsrCalls = 0;
+uint64_t hostSkips = 0;
+uint64_t hostSkippedNs = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint64_t readMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void reportHostClock(void)
+{
+    double wall = (readMonotonicNs() - hostStartTime) / 1e9;
+    double simulated = hostVirtualNs / 1e9;
+
+    fprintf(stderr, "host clock: %.3f s simulated in %.3f s (%.0fx), %llu interrupts, %llu skips over %.3f s\n",
+            simulated, wall, wall > 0 ? simulated / wall : 0.0, (unsigned long long)hostIsrCalls,
+            (unsigned long long)hostSkips, hostSkippedNs / 1e9);
+}
+
+// Reads the environment on first use
+void initHost(void)
+{
+    const char *clock = getenv("HOST_CLOCK");
+
+    hostReady = true;
+    hostStartTime = readMonotonicNs();
+    hostClockVirtual = clock != NULL && strcmp(clock, "virtual") == 0;
+    if (getenv("HOST_SECONDS") != NULL)
+        hostEndNs = strtoull(getenv("HOST_SECONDS"), NULL, 0) * 1000000000ULL;
+    if (getenv("HOST_SEED") != NULL)
+        seedHostRandom(strtoul(getenv("HOST_SEED"), NULL, 0));
+    if (hostClockVirtual)
+        atexit(reportHostClock);
+}
+
+bool isHostClockVirtual(void)
+{
+    if (!hostReady)
+        initHost();
+    return hostClockVirtual;
+}
+
+// Returns nanoseconds since the first call
+uint64_t getHostTimeNs(void)
+{
+    if (!hostReady)
+        initHost();
+    if (hostClockVirtual)
+        return hostVirtualNs;
+    return readMonotonicNs() - hostStartTime;
+}
+
+// Returns microseconds since the first call
+uint64_t getHostTime(void)
+{
+    return getHostTimeNs() / 1000;
+}
+
+// Delivers every interrupt that has come due, oldest first
+// Interrupts are not nested, so calls made from an isr return immediately
+void pollHost(void)
+{
+    uint64_t now;
+    hostIsrEntry *e;
+    uint8_t i, next;
+    bool found = true;
+
+    if (hostInIsr)
+        return;
+    hostInIsr = true;
+    now = getHostTime();
+    while (found)
+    {
+        // Pin interrupts are already asserted, so they go first
+        found = servicePortIsrs();
+        if (found)
+        {
+            hostActivity = true;
+            hostIsrCalls++;
+            continue;
+        }
+        next = 0;
+        for (i = 0; i < MAX_HOST_ISRS; i++)
+        {
+            if (hostIsrs[i].isr != NULL && hostIsrs[i].due <= now &&
+                (!found || hostIsrs[i].due < hostIsrs[next].due))
+            {
+                next = i;
+                found = true;
+            }
+        }
+        if (found)
+        {
+            e = &hostIsrs[next];
+            if (e->idle == NULL || (*e->idle)() == 0)
+                hostActivity = true;
+            e->due += e->period;
+            hostIsrCalls++;
+            (*e->isr)();
+        }
+    }
+    hostInIsr = false;
+}
+
+// Returns the due time of the next interrupt (us), or UINT64_MAX
+uint64_t getNextHostIsr(void)
+{
+    uint64_t due = UINT64_MAX;
+    uint8_t i;
+    for (i = 0; i < MAX_HOST_ISRS; i++)
+        if (hostIsrs[i].isr != NULL && hostIsrs[i].due < due)
+            due = hostIsrs[i].due;
+    return due;
+}
+
+// Passes over the ticks due before until (us) that would only count down
+void skipIdleTicks(uint64_t until)
+{
+    uint64_t ticks;
+    uint32_t idle;
+    hostIsrEntry *e;
+    uint8_t i;
+
+    for (i = 0; i < MAX_HOST_ISRS; i++)
+    {
+        e = &hostIsrs[i];
+        if (e->isr == NULL || e->idle == NULL || e->due >= until)
+            continue;
+        ticks = (until - e->due + e->period - 1) / e->period;
+        idle = (*e->idle)();
+        if (ticks > idle)
+            ticks = idle;
+        if (e->skip != NULL && ticks != 0)
+            (*e->skip)(ticks);
+        e->due += ticks * e->period;
+    }
+}
+
+// Advances the virtual clock to end (ns), delivering interrupts at their due
+// times; inside an isr they wait, as they would on the target
+void runHostClock(uint64_t end)
+{
+    uint64_t due;
+
+    while (!hostInIsr && (due = getNextHostIsr()) != UINT64_MAX && due * 1000 <= end)
+    {
+        skipIdleTicks(end / 1000 + 1);
+        due = getNextHostIsr();
+        if (due == UINT64_MAX || due * 1000 > end)
+            break;
+        if (due * 1000 > hostVirtualNs)
+            hostVirtualNs = due * 1000;
+        pollHost();
+    }
+    if (end > hostVirtualNs)
+        hostVirtualNs = end;
+}
+
+// Moves the virtual clock to the next interrupt that has work to do
+void skipHostClock(void)
+{
+    uint64_t now = getHostTime();
+    uint64_t next = UINT64_MAX;
+    uint64_t due;
+    uint32_t idle;
+    uint8_t i;
+
+    for (i = 0; i < MAX_HOST_ISRS; i++)
+    {
+        if (hostIsrs[i].isr == NULL)
+            continue;
+        due = hostIsrs[i].due;
+        if (hostIsrs[i].idle != NULL)
+        {
+            idle = (*hostIsrs[i].idle)();
+            due = (idle == UINT32_MAX) ? UINT64_MAX : due + (uint64_t)idle * hostIsrs[i].period;
+        }
+        if (due < next)
+            next = due;
+    }
+    if (next == UINT64_MAX)
+        next = now + 1000;
+    if (hostEndNs != 0 && next * 1000 > hostEndNs)
+        next = hostEndNs / 1000;
+    if (next <= now)
+        return;
+    hostSkips++;
+    hostSkippedNs += next * 1000 - hostVirtualNs;
+    runHostClock(next * 1000);
+}
+
+// Called once per superloop pass (uart polling): delivers due interrupts
+// and, on the virtual clock, skips idle time
+void idleHost(void)
+{
+    pollHost();
+    if (hostEndNs != 0 && getHostTimeNs() >= hostEndNs)
+        exit(0);
+    if (!hostClockVirtual)
+        return;
+    if (hostActivity)
+    {
+        hostActivity = false;
+        hostIdlePasses = 0;
+    }
+    else if (++hostIdlePasses == HOST_IDLE_PASSES)
+    {
+        hostIdlePasses = 0;
+        skipHostClock();
+    }
+}
+
+// Device models call this when something happens the firmware has to see
+// (a frame arrives, a packet is heard, a character is typed or printed)
+void markHostActivity(void)
+{
+    hostActivity = true;
+}
+
+// Blocks for us microseconds, servicing interrupts as they come due
+void spendHostTime(uint32_t us)
+{
+    uint64_t end = getHostTime() + us;
+    uint64_t now;
+    uint64_t wake;
+    struct timespec ts;
+
+    if (hostClockVirtual)
+    {
+        runHostClock(getHostTimeNs() + (uint64_t)us * 1000);
+        return;
+    }
+    pollHost();
+    while ((now = getHostTime()) < end)
+    {
+        wake = getNextHostIsr();
+        if (wake > end)
+            wake = end;
+        if (wake > now + HOST_SPIN_US)
+        {
+            ts.tv_sec = (wake - now) / 1000000;
+            ts.tv_nsec = ((wake - now) % 1000000) * 1000;
+            nanosleep(&ts, NULL);
+        }
+        pollHost();
+    }
+}
+
+// Charges time the modelled hardware keeps the CPU waiting (bus transfers,
+// busy flags); it is spent in whole microseconds, like a busy wait
+void chargeHostTime(uint32_t ns)
+{
+    if (isHostClockVirtual())
+    {
+        runHostClock(hostVirtualNs + ns);
+        return;
+    }
+    hostChargedNs += ns;
+    if (hostChargedNs >= 1000)
+    {
+        spendHostTime(hostChargedNs / 1000);
+        hostChargedNs %= 1000;
+    }
+}
+
+// Attaches a periodic interrupt source (the host equivalent of a timer isr)
+bool attachHostIsr(_hostIsr isr, uint32_t periodUs)
+{
+    return attachHostTimer(isr, periodUs, NULL, NULL);
+}
+
+// Attaches a periodic interrupt source whose ticks are mostly count downs:
+// idle returns how many of the coming ticks will do nothing else, and skip
+// applies that many at once when the virtual clock passes over them
+bool attachHostTimer(_hostIsr isr, uint32_t periodUs, _hostIdleTicks idle, _hostSkipTicks skip)
+{
+    uint8_t i = 0;
+    bool found = false;
+    while (i < MAX_HOST_ISRS && !found)
+    {
+        found = hostIsrs[i].isr == NULL || hostIsrs[i].isr == isr;
+        if (found)
+        {
+            hostIsrs[i].isr = isr;
+            hostIsrs[i].idle = idle;
+            hostIsrs[i].skip = skip;
+            hostIsrs[i].period = periodUs;
+            hostIsrs[i].due = getHostTime() + periodUs;
+        }
+        i++;
+    }
+    return found;
+}
+
+bool detachHostIsr(_hostIsr isr)
+{
+    uint8_t i = 0;
+    bool found = false;
+    while (i < MAX_HOST_ISRS && !found)
+    {
+        found = hostIsrs[i].isr == isr;
+        if (found)
+            hostIsrs[i].isr = NULL;
+        i++;
+    }
+    return found;
+}
+
+// xorshift32, seeded to a fixed value so runs are repeatable by default
+void seedHostRandom(uint32_t seed)
+{
+    hostRandomState = (seed != 0) ? seed : 0x2545F491;
+}
+
+uint32_t getHostRandom(void)
+{
+    if (!hostReady)
+        initHost();
+    hostRandomState ^= hostRandomState << 13;
+    hostRandomState ^= hostRandomState >> 17;
+    hostRandomState ^= hostRandomState << 5;
+    return hostRandomState;
+}
@@ -0,0 +1,66 @@
+// Host Support Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Stands in for the NVIC and the free-running timers when the firmware is
+// built for the host.  Interrupt sources attached here are delivered at poll
+// points (uart polling, busy waits and bus models), in time order.
+// Host time is either the monotonic clock or, with HOST_CLOCK=virtual, a
+// simulated clock that only waits, charged bus time and idle skips advance
+// (see host.c).
+// Device models see their chip selects through pin hooks and exchange one
+// byte per SPI transfer through the attached device function; the pins they
+// drive raise the port isrs attached in place of the GPIO vectors.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio.h"
+
+typedef void (*_hostIsr)(void);
+typedef uint32_t (*_hostIdleTicks)(void);
+typedef void (*_hostSkipTicks)(uint32_t ticks);
+typedef void (*_hostPinHook)(bool value);
+typedef uint8_t (*_hostSpiDevice)(uint8_t data);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint64_t getHostTime(void);
+uint64_t getHostTimeNs(void);
+void spendHostTime(uint32_t us);
+void chargeHostTime(uint32_t ns);
+void pollHost(void);
+void idleHost(void);
+void markHostActivity(void);
+bool isHostClockVirtual(void);
+
+bool attachHostIsr(_hostIsr isr, uint32_t periodUs);
+bool attachHostTimer(_hostIsr isr, uint32_t periodUs, _hostIdleTicks idle, _hostSkipTicks skip);
+bool detachHostIsr(_hostIsr isr);
+
+void seedHostRandom(uint32_t seed);
+uint32_t getHostRandom(void);
+
+// Device models attach here (implemented by the host gpio and spi drivers)
+bool attachPinHook(PORT port, uint8_t pin, _hostPinHook hook);
+bool attachPortIsr(PORT port, _hostIsr isr);
+bool servicePortIsrs(void);
+void attachSpi0Device(_hostSpiDevice device);
+void attachSpi1Device(_hostSpiDevice device);
+
+#endif
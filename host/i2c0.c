@@ -0,0 +1,81 @@
+// I2C0 Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Hardware configuration:
+// Register-style devices are not modeled; the bus reads back 0xFF
+// The 24LC512 is modeled in i2cEeprom.c
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c0.h"
+#include "busStats.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initI2c0(void)
+{
+}
+
+void writeI2c0Data(uint8_t add, uint8_t data)
+{
+    countBusBytes(BUS_I2C0, 2);
+}
+
+uint8_t readI2c0Data(uint8_t add)
+{
+    countBusBytes(BUS_I2C0, 2);
+    return 0xFF;
+}
+
+void writeI2c0Register(uint8_t add, uint8_t reg, uint8_t data)
+{
+    countBusBytes(BUS_I2C0, 3);
+}
+
+void writeI2c0Registers(uint8_t add, uint8_t reg, const uint8_t data[], uint8_t size)
+{
+    countBusBytes(BUS_I2C0, 2 + size);
+}
+
+uint8_t readI2c0Register(uint8_t add, uint8_t reg)
+{
+    countBusBytes(BUS_I2C0, 4);
+    return 0xFF;
+}
+
+void readI2c0Registers(uint8_t add, uint8_t reg, uint8_t data[], uint8_t size)
+{
+    uint8_t i;
+    countBusBytes(BUS_I2C0, 3 + size);
+    for (i = 0; i < size; i++)
+        data[i] = 0xFF;
+}
+
+bool pollI2c0Address(uint8_t add)
+{
+    countBusBytes(BUS_I2C0, 1);
+    return false;
+}
+
+bool isI2c0Error(void)
+{
+    return false;
+}
@@ -0,0 +1,129 @@
+// I2C EEPROM Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Models the 64 KB 24LC512 as a RAM array that starts erased (0xFF), with
+// the bus and write cycle timing described in storage.h
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "i2cEeprom.h"
+#include "perfStats.h"
+#include "host.h"
+#include "storage.h"
+#include "busStats.h"
+
+#define I2C_EEPROM_SIZE 65536
+#define I2C_BIT_NS      10000           // 100 kHz (I2C0_MTPR_R = 19)
+#define WRITE_BITS      38              // S, address, location H/L, data, P
+#define READ_BITS       48              // S, address, location H/L, Sr, address, data, P
+#define WRITE_CYCLE_NS  5000000         // tWC
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t i2cEepromBytes[I2C_EEPROM_SIZE];
+bool i2cEepromInitialized = false;
+FILE *i2cEepromFile = NULL;
+uint64_t i2cEepromBusyUntil = 0;        // ns, end of the current write cycle
+i2cEepromStats i2cEepromTotals;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initI2cEepromModel(void)
+{
+    uint32_t i;
+    if (i2cEepromInitialized)
+        return;
+    for (i = 0; i < I2C_EEPROM_SIZE; i++)
+        i2cEepromBytes[i] = 0xFF;
+    i2cEepromInitialized = true;
+
+    // HOST_I2C_EEPROM names an image file that keeps the contents across runs
+    if (getenv("HOST_I2C_EEPROM") != NULL)
+    {
+        i2cEepromFile = fopen(getenv("HOST_I2C_EEPROM"), "r+b");
+        if (i2cEepromFile == NULL)
+        {
+            i2cEepromFile = fopen(getenv("HOST_I2C_EEPROM"), "w+b");
+            if (i2cEepromFile != NULL)
+                fwrite(i2cEepromBytes, 1, I2C_EEPROM_SIZE, i2cEepromFile);
+        }
+        else
+            fread(i2cEepromBytes, 1, I2C_EEPROM_SIZE, i2cEepromFile);
+    }
+}
+
+// Clocks one transaction; returns false if the chip did not acknowledge
+bool transferI2cEeprom(uint8_t bits)
+{
+    bool ack = getHostTimeNs() >= i2cEepromBusyUntil;
+    if (!ack)
+        i2cEepromTotals.naks++;
+    i2cEepromTotals.busNs += bits * I2C_BIT_NS;
+    chargeHostTime(bits * I2C_BIT_NS);
+    return ack;
+}
+
+uint8_t i2cEepromRead(uint8_t add, uint16_t location)
+{
+    uint32_t perfStart = PERF_START();
+    uint8_t data = 0xFF;
+    initI2cEepromModel();
+    i2cEepromTotals.reads++;
+    countBusBytes(BUS_I2C0, 5);
+    if (transferI2cEeprom(READ_BITS))
+        data = i2cEepromBytes[location];
+    PERF_STOP(PERF_I2C_EEPROM, perfStart);
+    return data;
+}
+
+void i2cEepromReset(uint8_t add, uint16_t location)
+{
+    i2cEepromWrite(add, location, 0xFF);
+}
+
+void i2cEepromWrite(uint8_t add, uint16_t location, uint8_t data)
+{
+    uint32_t perfStart = PERF_START();
+    initI2cEepromModel();
+    i2cEepromTotals.writes++;
+    countBusBytes(BUS_I2C0, 4);
+    countBusWriteCycle();
+    if (!transferI2cEeprom(WRITE_BITS))
+    {
+        PERF_STOP(PERF_I2C_EEPROM, perfStart);
+        return;
+    }
+    i2cEepromBusyUntil = getHostTimeNs() + WRITE_CYCLE_NS;
+    i2cEepromTotals.writeCycleNs += WRITE_CYCLE_NS;
+    i2cEepromBytes[location] = data;
+    if (i2cEepromFile != NULL)
+    {
+        fseek(i2cEepromFile, location, SEEK_SET);
+        fputc(data, i2cEepromFile);
+        fflush(i2cEepromFile);
+    }
+    PERF_STOP(PERF_I2C_EEPROM, perfStart);
+}
+
+void getI2cEepromStats(i2cEepromStats *stats)
+{
+    *stats = i2cEepromTotals;
+}
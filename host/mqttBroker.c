@@ -0,0 +1,1077 @@
+// MQTT Broker Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Answers the bridge the way a broker on the other side of the LAN would:
+// ARP for any address the bridge asks about, one TCP connection on port
+// 1883, and MQTT 3.1.1 CONNECT/CONNACK, SUBSCRIBE/SUBACK,
+// UNSUBSCRIBE/UNSUBACK, PUBLISH at QoS 0 and 1 (PUBACK), PINGREQ/PINGRESP
+// and DISCONNECT.  Segments with a bad IP or TCP checksum are counted and
+// dropped; malformed MQTT packets are counted and answered where possible.
+// Data the bridge has not acknowledged is sent again after BROKER_RTO_US.
+//
+// A publish generator plays the broker's other clients.  It publishes
+// under uta_iot/feeds/, and every message on a topic the bridge subscribed
+// to is forwarded within the window the bridge advertises; the rest wait in
+// the broker.  Payloads start with "#<seq>" and queuePushMsg() is wrapped at
+// link time, so the time from a message being published to the bridge
+// queueing it for a device is measured.
+//
+// Environment (the broker is only attached when MQTT_BROKER is set):
+//   MQTT_BROKER      any value
+//   MQTT_PUB_TOPICS  comma separated feeds to publish to, under
+//                    uta_iot/feeds/ unless they contain a '/'; default every
+//                    topic the bridge has subscribed to
+//   MQTT_PUB_RATE    messages per second, default 10 (0 for none)
+//   MQTT_PUB_BURST   messages published back to back each time, default 1
+//   MQTT_PUB_SIZE    payload bytes, default 8 (never less than the tag)
+//   MQTT_PUB_QOS     0 or 1, default 0
+//   MQTT_PUB_PACK    messages carried per TCP segment, default 1
+//   MQTT_PUB_SECONDS stop publishing this far into the run, so what is
+//                    still on its way can arrive before the report; default
+//                    never
+//   MQTT_LOSS        probability a segment from the bridge is lost on the
+//                    way, default 0
+//
+// The report goes to stderr when the run ends (HOST_SECONDS).
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eth0.h"
+#include "ip.h"
+#include "arp.h"
+#include "tcp.h"
+#include "mqtt.h"
+#include "wireless.h"
+#include "host.h"
+#include "etherWire.h"
+#include "mqttBroker.h"
+
+#define BROKER_TICK_US    100
+#define BROKER_RTO_US     1000000
+#define BROKER_MSS        1460
+#define BROKER_WINDOW     4096          // advertised to the bridge
+#define MAX_FRAME_SIZE    1514
+#define MIN_FRAME_SIZE    60
+#define MAX_SUBSCRIPTIONS 32
+#define MAX_TOPIC_SIZE    80
+#define MAX_PUB_TOPICS    16
+#define MAX_PUB_SIZE      1024
+#define MAX_SEGMENTS      64
+#define MAX_OUTBOX        4096
+#define MAX_TRACKED       65536
+#define MAX_LATENCIES     65536
+#define MAX_STREAM        4096
+#define FEED_PREFIX       "uta_iot/feeds/"
+
+typedef enum _brokerState
+{
+    BROKER_CLOSED, BROKER_SYN_RECEIVED, BROKER_ESTABLISHED, BROKER_CLOSING
+} brokerState;
+
+typedef struct _brokerSegment
+{
+    uint32_t seq;
+    uint16_t size;
+    uint64_t sentAt;                    // us
+    uint8_t data[BROKER_MSS];
+} brokerSegment;
+
+typedef struct _brokerMessage
+{
+    uint32_t seq;
+    char topic[MAX_TOPIC_SIZE];
+} brokerMessage;
+
+typedef struct _brokerPublish
+{
+    uint64_t publishedAt;               // us
+    bool seen;                          // reached queuePushMsg()
+} brokerPublish;
+
+typedef struct _brokerLatencies
+{
+    uint32_t samples[MAX_LATENCIES];    // us
+    uint32_t count;
+    uint64_t sum;
+    uint32_t max;
+} brokerLatencies;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+bool brokerActive = false;
+uint64_t brokerStart = 0;               // ns
+uint8_t brokerMac[HW_ADD_LENGTH] = {0x02, 0x42, 0x52, 0x4F, 0x4B, 0x52};
+uint8_t brokerIp[IP_ADD_LENGTH];        // whichever address the bridge connects to
+uint8_t bridgeMac[HW_ADD_LENGTH];
+uint8_t bridgeIp[IP_ADD_LENGTH];
+uint16_t bridgePort = 0;
+uint16_t brokerIpId = 0;
+
+brokerState brokerTcpState = BROKER_CLOSED;
+uint32_t brokerRcvNxt = 0;
+uint32_t brokerSndUna = 0;
+uint32_t brokerSndNxt = 0;
+uint16_t brokerSndWnd = 0;
+bool brokerAckPending = false;
+brokerSegment brokerSegments[MAX_SEGMENTS];
+uint8_t brokerSegmentHead = 0;
+uint8_t brokerSegmentCount = 0;
+uint8_t brokerStream[MAX_STREAM];
+uint16_t brokerStreamSize = 0;
+
+bool brokerMqttConnected = false;
+char brokerSubs[MAX_SUBSCRIPTIONS][MAX_TOPIC_SIZE];
+char brokerPubTopics[MAX_PUB_TOPICS][MAX_TOPIC_SIZE];
+uint8_t brokerPubTopicCount = 0;
+uint8_t brokerNextTopic = 0;
+
+double brokerLoss = 0;
+uint32_t brokerPubRate = 10;
+uint32_t brokerPubBurst = 1;
+uint32_t brokerPubSize = 8;
+uint32_t brokerPubQos = 0;
+uint32_t brokerPubPack = 1;
+uint64_t brokerPubInterval = 100000;    // us between bursts
+uint64_t brokerPubNext = 0;             // us
+uint64_t brokerPubEnd = UINT64_MAX;     // us
+uint32_t brokerPubSeq = 0;
+brokerMessage brokerOutbox[MAX_OUTBOX];
+uint16_t brokerOutboxHead = 0;
+uint16_t brokerOutboxCount = 0;
+brokerPublish brokerPublishes[MAX_TRACKED];
+brokerLatencies brokerLatency;
+
+uint32_t brokerArps = 0;
+uint32_t brokerConnections = 0;
+uint32_t brokerConnects = 0;
+uint32_t brokerSubscribes = 0;
+uint32_t brokerUnsubscribes = 0;
+uint32_t brokerPings = 0;
+uint32_t brokerDisconnects = 0;
+uint32_t brokerMalformed = 0;
+uint32_t brokerBadChecksums = 0;
+uint32_t brokerSegmentsSent = 0;
+uint32_t brokerRetransmits = 0;
+uint32_t brokerDuplicates = 0;          // segments from the bridge already received
+uint32_t brokerOutOfOrder = 0;
+uint32_t brokerResets = 0;
+uint32_t brokerLost = 0;                // MQTT_LOSS
+uint32_t brokerBridgePublishes = 0;
+uint64_t brokerBridgeBytes = 0;
+uint32_t brokerPubacks = 0;
+uint32_t brokerGenerated = 0;
+uint32_t brokerUnrouted = 0;            // no subscription from the bridge
+uint32_t brokerOutboxDrops = 0;
+uint32_t brokerForwarded = 0;
+uint32_t brokerPushesQueued = 0;
+uint32_t brokerPushesRejected = 0;
+uint32_t brokerPushDuplicates = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool __real_queuePushMsg(pushMessage *pushMsg, uint8_t devNum);
+
+uint32_t getBrokerEnv(const char *name, uint32_t value)
+{
+    if (getenv(name) != NULL)
+        value = strtoul(getenv(name), NULL, 0);
+    return value;
+}
+
+void addBrokerLatency(brokerLatencies *l, uint64_t us)
+{
+    if (l->count < MAX_LATENCIES)
+        l->samples[l->count] = us;
+    l->count++;
+    l->sum += us;
+    if (us > l->max)
+        l->max = us;
+}
+
+int compareBrokerLatency(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void reportBrokerLatency(const char *name, brokerLatencies *l)
+{
+    uint32_t n = (l->count < MAX_LATENCIES) ? l->count : MAX_LATENCIES;
+    if (n == 0)
+    {
+        fprintf(stderr, "  %s latency: no samples\n", name);
+        return;
+    }
+    qsort(l->samples, n, sizeof(uint32_t), compareBrokerLatency);
+    fprintf(stderr, "  %s latency: min %.1f avg %.1f p99 %.1f max %.1f ms (%u samples)\n", name,
+            l->samples[0] / 1e3, (double)l->sum / l->count / 1e3, l->samples[(n * 99) / 100] / 1e3,
+            l->max / 1e3, l->count);
+}
+
+// One's complement sum of big endian 16-bit words
+uint32_t sumBrokerWords(const uint8_t data[], uint16_t size, uint32_t sum)
+{
+    uint16_t i;
+    for (i = 0; i + 1 < size; i += 2)
+        sum += (data[i] << 8) | data[i + 1];
+    if (size & 1)
+        sum += data[size - 1] << 8;
+    return sum;
+}
+
+uint16_t foldBrokerSum(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
+// Checksum over the pseudo header and segment; 0 for an intact segment
+uint16_t getBrokerTcpSum(const ipHeader *ip, const uint8_t tcp[], uint16_t tcpSize)
+{
+    uint32_t sum = sumBrokerWords(ip->sourceIp, 2 * IP_ADD_LENGTH, 0);
+    sum += PROTOCOL_TCP + tcpSize;
+    return foldBrokerSum(sumBrokerWords(tcp, tcpSize, sum));
+}
+
+void sendBrokerSegment(uint16_t port, uint16_t flags, uint32_t seq, uint32_t ack, const uint8_t data[],
+                       uint16_t size)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    etherHeader *ether = (etherHeader*)frame;
+    ipHeader *ip = (ipHeader*)ether->data;
+    tcpHeader *tcp = (tcpHeader*)ip->data;
+    uint16_t tcpSize = sizeof(tcpHeader) + size;
+    uint16_t frameSize = sizeof(etherHeader) + sizeof(ipHeader) + tcpSize;
+
+    memset(frame, 0, MIN_FRAME_SIZE);
+    memcpy(ether->destAddress, bridgeMac, HW_ADD_LENGTH);
+    memcpy(ether->sourceAddress, brokerMac, HW_ADD_LENGTH);
+    ether->frameType = htons(TYPE_IP);
+    ip->rev = 4;
+    ip->size = sizeof(ipHeader) / 4;
+    ip->typeOfService = 0;
+    ip->length = htons(sizeof(ipHeader) + tcpSize);
+    ip->id = htons(brokerIpId++);
+    ip->flagsAndOffset = htons(0x4000);             // don't fragment
+    ip->ttl = 64;
+    ip->protocol = PROTOCOL_TCP;
+    ip->headerChecksum = 0;
+    memcpy(ip->sourceIp, brokerIp, IP_ADD_LENGTH);
+    memcpy(ip->destIp, bridgeIp, IP_ADD_LENGTH);
+    ip->headerChecksum = htons(foldBrokerSum(sumBrokerWords((uint8_t*)ip, sizeof(ipHeader), 0)));
+
+    tcp->sourcePort = htons(MQTT_PORT);
+    tcp->destPort = htons(port);
+    tcp->sequenceNumber = htonl(seq);
+    tcp->acknowledgementNumber = (flags & ACK) ? htonl(ack) : 0;
+    tcp->offsetFields = htons((sizeof(tcpHeader) / 4) << OFS_SHIFT | flags);
+    tcp->windowSize = htons(BROKER_WINDOW);
+    tcp->checksum = 0;
+    tcp->urgentPointer = 0;
+    if (size != 0)
+        memcpy(tcp->data, data, size);
+    tcp->checksum = htons(getBrokerTcpSum(ip, (uint8_t*)tcp, tcpSize));
+
+    if (frameSize < MIN_FRAME_SIZE)
+        frameSize = MIN_FRAME_SIZE;
+    brokerSegmentsSent++;
+    queueEtherWireFrame(frame, frameSize);
+}
+
+void sendBrokerTcp(uint16_t flags, uint32_t seq, const uint8_t data[], uint16_t size)
+{
+    sendBrokerSegment(bridgePort, flags, seq, brokerRcvNxt, data, size);
+    brokerAckPending = false;
+}
+
+// Sends data on the connection and keeps it until the bridge acknowledges it
+bool sendBrokerData(const uint8_t data[], uint16_t size)
+{
+    brokerSegment *s;
+
+    if (brokerSegmentCount == MAX_SEGMENTS)
+        return false;
+    s = &brokerSegments[(brokerSegmentHead + brokerSegmentCount) % MAX_SEGMENTS];
+    s->seq = brokerSndNxt;
+    s->size = size;
+    s->sentAt = getHostTime();
+    memcpy(s->data, data, size);
+    brokerSegmentCount++;
+    brokerSndNxt += size;
+    sendBrokerTcp(PSH | ACK, s->seq, data, size);
+    return true;
+}
+
+// Releases the data the bridge has acknowledged
+void ackBrokerData(uint32_t ack)
+{
+    brokerSegment *s;
+
+    if ((int32_t)(ack - brokerSndUna) <= 0 || (int32_t)(ack - brokerSndNxt) > 0)
+        return;
+    brokerSndUna = ack;
+    while (brokerSegmentCount != 0)
+    {
+        s = &brokerSegments[brokerSegmentHead];
+        if ((int32_t)(s->seq + s->size - ack) > 0)
+            break;
+        brokerSegmentHead = (brokerSegmentHead + 1) % MAX_SEGMENTS;
+        brokerSegmentCount--;
+    }
+}
+
+void closeBrokerConnection(void)
+{
+    brokerTcpState = BROKER_CLOSED;
+    brokerMqttConnected = false;
+    brokerSegmentCount = 0;
+    brokerStreamSize = 0;
+    brokerAckPending = false;
+}
+
+// Encodes an MQTT control packet into out, returning its size
+uint16_t buildBrokerPacket(uint8_t out[], uint8_t header, const uint8_t body[], uint16_t size)
+{
+    uint16_t n = 0;
+    uint16_t length = size;
+
+    out[n++] = header;
+    do
+    {
+        out[n] = length & 0x7F;
+        length >>= 7;
+        if (length != 0)
+            out[n] |= 0x80;
+        n++;
+    } while (length != 0);
+    memcpy(&out[n], body, size);
+    return n + size;
+}
+
+void sendBrokerPacket(uint8_t header, const uint8_t body[], uint16_t size)
+{
+    uint8_t packet[4 + MAX_SUBSCRIPTIONS + 2];
+    sendBrokerData(packet, buildBrokerPacket(packet, header, body, size));
+}
+
+//-----------------------------------------------------------------------------
+// Subscriptions and the publish generator
+//-----------------------------------------------------------------------------
+
+bool matchBrokerTopic(const char *filter, const char *topic)
+{
+    while (*filter != '\0')
+    {
+        if (*filter == '#')
+            return true;
+        if (*filter == '+')
+        {
+            while (*topic != '\0' && *topic != '/')
+                topic++;
+            filter++;
+        }
+        else
+        {
+            if (*filter != *topic)
+                return false;
+            filter++;
+            topic++;
+        }
+    }
+    return *topic == '\0';
+}
+
+bool isBrokerTopicSubscribed(const char *topic)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+        if (brokerSubs[i][0] != '\0' && matchBrokerTopic(brokerSubs[i], topic))
+            return true;
+    return false;
+}
+
+void addBrokerSubscription(const char *filter)
+{
+    int8_t free = -1;
+    uint8_t i;
+
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+    {
+        if (strcmp(brokerSubs[i], filter) == 0)
+            return;
+        if (free < 0 && brokerSubs[i][0] == '\0')
+            free = i;
+    }
+    if (free >= 0)
+        strcpy(brokerSubs[free], filter);
+}
+
+void removeBrokerSubscription(const char *filter)
+{
+    uint8_t i;
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+        if (strcmp(brokerSubs[i], filter) == 0)
+            brokerSubs[i][0] = '\0';
+}
+
+// Next topic to publish to: MQTT_PUB_TOPICS in turn, or else the bridge's
+// own subscriptions that name a single topic
+const char* getBrokerPubTopic(void)
+{
+    uint8_t i, index;
+
+    if (brokerPubTopicCount != 0)
+        return brokerPubTopics[brokerNextTopic++ % brokerPubTopicCount];
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+    {
+        index = brokerNextTopic++ % MAX_SUBSCRIPTIONS;
+        if (brokerSubs[index][0] != '\0' && strpbrk(brokerSubs[index], "+#") == NULL)
+            return brokerSubs[index];
+    }
+    return NULL;
+}
+
+void generateBrokerPublish(uint64_t now)
+{
+    const char *topic = getBrokerPubTopic();
+    brokerMessage *m;
+    brokerPublish *p;
+
+    brokerGenerated++;
+    if (topic == NULL || !isBrokerTopicSubscribed(topic))
+    {
+        brokerUnrouted++;
+        return;
+    }
+    if (brokerOutboxCount == MAX_OUTBOX)
+    {
+        brokerOutboxDrops++;
+        return;
+    }
+    m = &brokerOutbox[(brokerOutboxHead + brokerOutboxCount) % MAX_OUTBOX];
+    m->seq = brokerPubSeq++;
+    strcpy(m->topic, topic);
+    brokerOutboxCount++;
+    p = &brokerPublishes[m->seq % MAX_TRACKED];
+    p->publishedAt = now;
+    p->seen = false;
+}
+
+// Encodes a waiting message as a PUBLISH, or returns 0 if it needs more
+// than space bytes
+uint16_t buildBrokerPublish(const brokerMessage *m, uint8_t out[], uint16_t space)
+{
+    uint8_t body[2 + MAX_TOPIC_SIZE + 2 + MAX_PUB_SIZE];
+    uint16_t topicSize = strlen(m->topic);
+    uint16_t n = 0;
+    uint16_t id;
+    int tagSize;
+
+    body[n++] = topicSize >> 8;
+    body[n++] = topicSize & 0xFF;
+    memcpy(&body[n], m->topic, topicSize);
+    n += topicSize;
+    if (brokerPubQos != 0)
+    {
+        id = m->seq % 0xFFFF + 1;
+        body[n++] = id >> 8;
+        body[n++] = id & 0xFF;
+    }
+    tagSize = snprintf((char*)&body[n], MAX_PUB_SIZE, "#%u", m->seq);
+    if (tagSize < (int)brokerPubSize)
+    {
+        memset(&body[n + tagSize], 'x', brokerPubSize - tagSize);
+        tagSize = brokerPubSize;
+    }
+    n += tagSize;
+    if (n + 4 > space)
+        return 0;
+    return buildBrokerPacket(out, PUBLISH | (brokerPubQos << 1), body, n);
+}
+
+// Forwards waiting messages while the bridge's window has room
+void sendBrokerOutbox(void)
+{
+    uint8_t data[BROKER_MSS];
+    uint32_t flight;
+    uint16_t size, packet;
+    uint8_t n;
+    bool blocked = false;
+
+    while (!blocked && brokerTcpState == BROKER_ESTABLISHED && brokerMqttConnected && brokerOutboxCount != 0 &&
+           brokerSegmentCount < MAX_SEGMENTS)
+    {
+        flight = brokerSndNxt - brokerSndUna;
+        size = 0;
+        n = 0;
+        while (n < brokerPubPack && brokerOutboxCount != 0)
+        {
+            packet = buildBrokerPublish(&brokerOutbox[brokerOutboxHead], &data[size], BROKER_MSS - size);
+            if (packet == 0 || flight + size + packet > brokerSndWnd)
+                break;
+            size += packet;
+            brokerOutboxHead = (brokerOutboxHead + 1) % MAX_OUTBOX;
+            brokerOutboxCount--;
+            brokerForwarded++;
+            n++;
+        }
+        if (size == 0)
+            blocked = true;
+        else
+            sendBrokerData(data, size);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// MQTT
+//-----------------------------------------------------------------------------
+
+void handleBrokerConnect(const uint8_t body[], uint32_t size)
+{
+    uint8_t connack[2] = {0, 0};
+
+    brokerConnects++;
+    if (size < 10 || body[0] != 0 || body[1] != 4 || memcmp(&body[2], "MQTT", 4) != 0 || body[6] != 4)
+        connack[1] = 1;                             // unacceptable protocol version
+    else if (body[7] & MQTT_CLEAN)
+        memset(brokerSubs, 0, sizeof(brokerSubs));
+    sendBrokerPacket(CONNACK, connack, sizeof(connack));
+    brokerMqttConnected = connack[1] == 0;
+    if (brokerMqttConnected)
+        brokerPubNext = getHostTime() + brokerPubInterval;
+}
+
+void handleBrokerSubscribe(uint8_t header, const uint8_t body[], uint32_t size, bool subscribe)
+{
+    uint8_t reply[2 + MAX_SUBSCRIPTIONS];
+    char filter[MAX_TOPIC_SIZE];
+    uint32_t i = 2;
+    uint16_t n = 2;
+    uint16_t length;
+
+    if (subscribe)
+        brokerSubscribes++;
+    else
+        brokerUnsubscribes++;
+    if (size < 2 || (header & 0x0F) != 0x02)
+    {
+        brokerMalformed++;
+        if (size < 2)
+            return;
+    }
+    reply[0] = body[0];
+    reply[1] = body[1];
+    while (i + 2 <= size)
+    {
+        length = (body[i] << 8) | body[i + 1];
+        i += 2;
+        if (i + length + (subscribe ? 1 : 0) > size || length >= MAX_TOPIC_SIZE)
+        {
+            brokerMalformed++;
+            break;
+        }
+        memcpy(filter, &body[i], length);
+        filter[length] = '\0';
+        i += length;
+        if (subscribe)
+        {
+            addBrokerSubscription(filter);
+            if (n < sizeof(reply))
+                reply[n++] = (body[i] > 1) ? ((body[i] > 2) ? 0x80 : 1) : body[i];
+            i++;
+        }
+        else
+            removeBrokerSubscription(filter);
+    }
+    if (subscribe)
+        sendBrokerPacket(SUBACK, reply, n);
+    else
+        sendBrokerPacket(UNSUBACK, reply, 2);
+}
+
+void handleBrokerPublish(uint8_t header, const uint8_t body[], uint32_t size)
+{
+    uint8_t qos = (header >> 1) & 3;
+    uint32_t i;
+    uint16_t length;
+
+    if (size < 2 || qos > 1)
+    {
+        brokerMalformed++;
+        return;
+    }
+    length = (body[0] << 8) | body[1];
+    i = 2 + length + (qos ? 2 : 0);
+    if (i > size)
+    {
+        brokerMalformed++;
+        return;
+    }
+    brokerBridgePublishes++;
+    brokerBridgeBytes += size - i;
+    if (qos == 1)
+        sendBrokerPacket(PUBACK, &body[2 + length], 2);
+}
+
+void handleBrokerPacket(uint8_t header, const uint8_t body[], uint32_t size)
+{
+    switch (header & 0xF0)
+    {
+        case CONNECT:
+            handleBrokerConnect(body, size);
+            break;
+        case SUBSCRIBE:
+            handleBrokerSubscribe(header, body, size, true);
+            break;
+        case UNSUBSCRIBE:
+            handleBrokerSubscribe(header, body, size, false);
+            break;
+        case PUBLISH:
+            handleBrokerPublish(header, body, size);
+            break;
+        case PUBACK:
+            if (size == 2)
+                brokerPubacks++;
+            else
+                brokerMalformed++;
+            break;
+        case PINGREQ:
+            brokerPings++;
+            if (size != 0)
+                brokerMalformed++;
+            sendBrokerPacket(PINGRESP, NULL, 0);
+            break;
+        case DISCONNECT:
+            brokerDisconnects++;
+            brokerMqttConnected = false;
+            brokerTcpState = BROKER_CLOSING;
+            sendBrokerTcp(FIN | ACK, brokerSndNxt++, NULL, 0);
+            break;
+        default:
+            brokerMalformed++;
+            break;
+    }
+}
+
+// Returns the size of the fixed header at data, 0 if more bytes are needed,
+// or -1 if the remaining length is malformed
+int8_t decodeBrokerHeader(const uint8_t data[], uint16_t size, uint32_t *length)
+{
+    uint8_t i = 1;
+
+    *length = 0;
+    while (i < size && i <= 4)
+    {
+        *length |= (uint32_t)(data[i] & 0x7F) << (7 * (i - 1));
+        if ((data[i++] & 0x80) == 0)
+            return i;
+    }
+    return (i > 4) ? -1 : 0;
+}
+
+// Handles every complete packet received so far
+void parseBrokerStream(void)
+{
+    uint16_t used = 0;
+    uint32_t length;
+    int8_t header = 1;
+
+    while (header > 0 && used < brokerStreamSize)
+    {
+        header = decodeBrokerHeader(&brokerStream[used], brokerStreamSize - used, &length);
+        if (header < 0 || length > MAX_STREAM - 5)
+        {
+            brokerMalformed++;
+            closeBrokerConnection();
+            sendBrokerSegment(bridgePort, RST, brokerSndNxt, 0, NULL, 0);
+            return;
+        }
+        if (header == 0 || used + header + length > brokerStreamSize)
+            header = 0;
+        else
+        {
+            handleBrokerPacket(brokerStream[used], &brokerStream[used + header], length);
+            used += header + length;
+        }
+    }
+    memmove(brokerStream, &brokerStream[used], brokerStreamSize - used);
+    brokerStreamSize -= used;
+}
+
+//-----------------------------------------------------------------------------
+// TCP and ARP
+//-----------------------------------------------------------------------------
+
+// Takes the part of a segment not received yet; there is no reassembly, a
+// segment beyond a gap is dropped and the gap acknowledged again
+void receiveBrokerData(uint32_t seq, const uint8_t data[], uint16_t size)
+{
+    uint32_t skip = brokerRcvNxt - seq;
+
+    brokerAckPending = true;
+    if ((int32_t)skip < 0)
+    {
+        brokerOutOfOrder++;
+        return;
+    }
+    if (skip >= size)
+    {
+        brokerDuplicates++;
+        return;
+    }
+    data += skip;
+    size -= skip;
+    if (brokerStreamSize + size > MAX_STREAM)
+    {
+        brokerMalformed++;
+        return;
+    }
+    memcpy(&brokerStream[brokerStreamSize], data, size);
+    brokerStreamSize += size;
+    brokerRcvNxt += size;
+    parseBrokerStream();
+}
+
+void acceptBrokerConnection(const ipHeader *ip, const tcpHeader *tcp)
+{
+    closeBrokerConnection();
+    memcpy(bridgeIp, ip->sourceIp, IP_ADD_LENGTH);
+    memcpy(brokerIp, ip->destIp, IP_ADD_LENGTH);
+    bridgePort = ntohs(tcp->sourcePort);
+    brokerRcvNxt = ntohl(tcp->sequenceNumber) + 1;
+    brokerSndUna = getHostRandom();
+    brokerSndNxt = brokerSndUna + 1;
+    brokerSndWnd = ntohs(tcp->windowSize);
+    brokerTcpState = BROKER_SYN_RECEIVED;
+    brokerConnections++;
+    sendBrokerTcp(SYN | ACK, brokerSndUna, NULL, 0);
+}
+
+void receiveBrokerTcp(const etherHeader *ether, const ipHeader *ip, uint16_t ipSize)
+{
+    uint8_t headerSize = ip->size * 4;
+    const tcpHeader *tcp = (const tcpHeader*)((const uint8_t*)ip + headerSize);
+    uint16_t tcpSize = ipSize - headerSize;
+    uint16_t offset = (ntohs(tcp->offsetFields) >> OFS_SHIFT) * 4;
+    uint16_t flags = ntohs(tcp->offsetFields) & 0x1FF;
+    uint32_t seq = ntohl(tcp->sequenceNumber);
+    uint16_t port = ntohs(tcp->sourcePort);
+    uint16_t dataSize;
+
+    if (tcpSize < sizeof(tcpHeader) || ntohs(tcp->destPort) != MQTT_PORT)
+        return;
+    if (brokerLoss != 0 && getHostRandom() < brokerLoss * UINT32_MAX)
+    {
+        brokerLost++;
+        return;
+    }
+    if (foldBrokerSum(sumBrokerWords((const uint8_t*)ip, headerSize, 0)) != 0 ||
+        getBrokerTcpSum(ip, (const uint8_t*)tcp, tcpSize) != 0 || offset < sizeof(tcpHeader) || offset > tcpSize)
+    {
+        brokerBadChecksums++;
+        return;
+    }
+    dataSize = tcpSize - offset;
+    memcpy(bridgeMac, ether->sourceAddress, HW_ADD_LENGTH);
+
+    if (flags & RST)
+    {
+        if (port == bridgePort)
+        {
+            brokerResets++;
+            closeBrokerConnection();
+        }
+        return;
+    }
+    if ((flags & SYN) && !(flags & ACK))
+    {
+        acceptBrokerConnection(ip, tcp);
+        return;
+    }
+    if (brokerTcpState == BROKER_CLOSED || port != bridgePort)
+    {
+        // Nothing listens for it, as a real stack would answer
+        brokerResets++;
+        memcpy(bridgeIp, ip->sourceIp, IP_ADD_LENGTH);
+        memcpy(brokerIp, ip->destIp, IP_ADD_LENGTH);
+        sendBrokerSegment(port, RST | ACK, (flags & ACK) ? ntohl(tcp->acknowledgementNumber) : 0,
+                          seq + dataSize + ((flags & (SYN | FIN)) ? 1 : 0), NULL, 0);
+        return;
+    }
+
+    if (flags & ACK)
+    {
+        if (brokerTcpState == BROKER_SYN_RECEIVED && ntohl(tcp->acknowledgementNumber) == brokerSndNxt)
+        {
+            brokerSndUna = brokerSndNxt;
+            brokerTcpState = BROKER_ESTABLISHED;
+        }
+        else
+            ackBrokerData(ntohl(tcp->acknowledgementNumber));
+        brokerSndWnd = ntohs(tcp->windowSize);
+    }
+    if (brokerTcpState == BROKER_ESTABLISHED && dataSize != 0)
+        receiveBrokerData(seq, (const uint8_t*)tcp + offset, dataSize);
+    if ((flags & FIN) && seq + dataSize == brokerRcvNxt)
+    {
+        brokerRcvNxt++;
+        if (brokerTcpState == BROKER_CLOSING)
+            sendBrokerTcp(ACK, brokerSndNxt, NULL, 0);
+        else
+            sendBrokerTcp(FIN | ACK, brokerSndNxt, NULL, 0);
+        closeBrokerConnection();
+    }
+    if (brokerAckPending && brokerTcpState != BROKER_CLOSED)
+        sendBrokerTcp(ACK, brokerSndNxt, NULL, 0);
+    sendBrokerOutbox();
+}
+
+// Answers for every address but the bridge's own, as the rest of the LAN
+void answerBrokerArp(const etherHeader *ether, uint16_t size)
+{
+    const arpPacket *arp = (const arpPacket*)ether->data;
+    uint8_t frame[MIN_FRAME_SIZE] = {0};
+    etherHeader *reply = (etherHeader*)frame;
+    arpPacket *a = (arpPacket*)reply->data;
+
+    if (size < sizeof(etherHeader) + sizeof(arpPacket) || arp->op != htons(1) ||
+        memcmp(arp->sourceIp, arp->destIp, IP_ADD_LENGTH) == 0)
+        return;
+    memcpy(reply->destAddress, arp->sourceAddress, HW_ADD_LENGTH);
+    memcpy(reply->sourceAddress, brokerMac, HW_ADD_LENGTH);
+    reply->frameType = htons(TYPE_ARP);
+    a->hardwareType = htons(1);
+    a->protocolType = htons(TYPE_IP);
+    a->hardwareSize = HW_ADD_LENGTH;
+    a->protocolSize = IP_ADD_LENGTH;
+    a->op = htons(2);
+    memcpy(a->sourceAddress, brokerMac, HW_ADD_LENGTH);
+    memcpy(a->sourceIp, arp->destIp, IP_ADD_LENGTH);
+    memcpy(a->destAddress, arp->sourceAddress, HW_ADD_LENGTH);
+    memcpy(a->destIp, arp->sourceIp, IP_ADD_LENGTH);
+    brokerArps++;
+    queueEtherWireFrame(frame, sizeof(frame));
+}
+
+void receiveMqttBrokerFrame(const uint8_t frame[], uint16_t size)
+{
+    const etherHeader *ether = (const etherHeader*)frame;
+    const ipHeader *ip = (const ipHeader*)ether->data;
+    uint16_t ipSize;
+
+    if (!brokerActive || size < sizeof(etherHeader) + sizeof(ipHeader))
+        return;
+    if (ether->frameType == htons(TYPE_ARP))
+        answerBrokerArp(ether, size);
+    else if (ether->frameType == htons(TYPE_IP) && ip->protocol == PROTOCOL_TCP)
+    {
+        ipSize = ntohs(ip->length);
+        if (ipSize <= size - sizeof(etherHeader) && ipSize >= ip->size * 4)
+            receiveBrokerTcp(ether, ip, ipSize);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Timing, measurement and report
+//-----------------------------------------------------------------------------
+
+void tickMqttBroker(void)
+{
+    uint64_t now = getHostTime();
+    brokerSegment *s;
+    uint32_t i;
+
+    while (brokerMqttConnected && brokerPubRate != 0 && now >= brokerPubNext && brokerPubNext < brokerPubEnd)
+    {
+        for (i = 0; i < brokerPubBurst; i++)
+            generateBrokerPublish(brokerPubNext);
+        brokerPubNext += brokerPubInterval;
+    }
+    if (brokerSegmentCount != 0)
+    {
+        s = &brokerSegments[brokerSegmentHead];
+        if (now >= s->sentAt + BROKER_RTO_US)
+        {
+            brokerRetransmits++;
+            s->sentAt = now;
+            sendBrokerTcp(PSH | ACK, s->seq, s->data, s->size);
+        }
+    }
+    sendBrokerOutbox();
+}
+
+// Returns how many broker ticks will pass before it has something to do
+// (for the virtual clock)
+uint32_t getBrokerIdleTicks(void)
+{
+    uint64_t now = getHostTime();
+    uint64_t next = UINT64_MAX;
+    uint64_t rto;
+
+    if (brokerMqttConnected && brokerPubRate != 0 && brokerPubNext < brokerPubEnd)
+        next = brokerPubNext;
+    if (brokerSegmentCount != 0)
+    {
+        rto = brokerSegments[brokerSegmentHead].sentAt + BROKER_RTO_US;
+        if (rto < next)
+            next = rto;
+    }
+    if (next == UINT64_MAX)
+        return UINT32_MAX;
+    if (next <= now + BROKER_TICK_US)
+        return 0;
+    if ((next - now) / BROKER_TICK_US > UINT32_MAX)
+        return UINT32_MAX - 1;
+    return (next - now) / BROKER_TICK_US - 1;
+}
+
+// Matches the "#<seq>" tag of the message against the publishes sent
+bool __wrap_queuePushMsg(pushMessage *pushMsg, uint8_t devNum)
+{
+    bool ok = __real_queuePushMsg(pushMsg, devNum);
+    char tag[sizeof(pushMsg->topicMessage) + 1];
+    brokerPublish *p;
+    uint32_t seq;
+
+    if (!brokerActive || pushMsg->topicMessage[0] != '#')
+        return ok;
+    memcpy(tag, pushMsg->topicMessage, sizeof(pushMsg->topicMessage));
+    tag[sizeof(pushMsg->topicMessage)] = '\0';
+    seq = strtoul(&tag[1], NULL, 10);
+    if (seq >= brokerPubSeq || brokerPubSeq - seq > MAX_TRACKED)
+        return ok;
+    p = &brokerPublishes[seq % MAX_TRACKED];
+    if (p->seen)
+        brokerPushDuplicates++;
+    else
+    {
+        p->seen = true;
+        if (ok)
+        {
+            brokerPushesQueued++;
+            addBrokerLatency(&brokerLatency, getHostTime() - p->publishedAt);
+        }
+        else
+            brokerPushesRejected++;
+    }
+    return ok;
+}
+
+void reportMqttBroker(void)
+{
+    uint64_t elapsed = getHostTimeNs() - brokerStart;
+    uint64_t publishing = elapsed;
+    uint32_t unseen = brokerForwarded - brokerPushesQueued - brokerPushesRejected;
+    etherWireStats wire;
+
+    getEtherWireStats(&wire);
+    if (brokerPubEnd != UINT64_MAX && brokerPubEnd * 1000 - brokerStart < elapsed)
+        publishing = brokerPubEnd * 1000 - brokerStart;
+    fprintf(stderr, "mqtt broker: %u connections, %u connects, %u subscribes, %u unsubscribes, %u pings,"
+            " %u disconnects, %u malformed\n", brokerConnections, brokerConnects, brokerSubscribes,
+            brokerUnsubscribes, brokerPings, brokerDisconnects, brokerMalformed);
+    fprintf(stderr, "  published: %u messages (%u byte payloads, qos %u, %u per segment) in %.3f s,"
+            " %u unrouted, %u dropped (broker queue full), %u waiting\n", brokerGenerated, brokerPubSize,
+            brokerPubQos, brokerPubPack, publishing / 1e9, brokerUnrouted, brokerOutboxDrops, brokerOutboxCount);
+    fprintf(stderr, "  forwarded: %u messages, %u reached queuePushMsg, %u rejected (push buffer full),"
+            " %u not seen, %u duplicates\n", brokerForwarded, brokerPushesQueued, brokerPushesRejected,
+            unseen, brokerPushDuplicates);
+    reportBrokerLatency("push", &brokerLatency);
+    fprintf(stderr, "  from the bridge: %u publishes (%llu payload bytes), %u pubacks\n",
+            brokerBridgePublishes, (unsigned long long)brokerBridgeBytes, brokerPubacks);
+    fprintf(stderr, "  tcp: %u segments sent, %u retransmitted, %u resets; received %u bad, %u duplicate,"
+            " %u out of order, %u lost\n", brokerSegmentsSent, brokerRetransmits, brokerResets, brokerBadChecksums,
+            brokerDuplicates, brokerOutOfOrder, brokerLost);
+    fprintf(stderr, "  eth0: %u frames to the bridge (%u dropped on the wire), %u handled, %u sent;"
+            " %.1f%% of the run in the frame path (max %.3f ms)\n", wire.queued, wire.queueDrops,
+            wire.rxFrames, wire.txFrames, elapsed ? 100.0 * wire.frameNs / elapsed : 0.0, wire.frameMaxNs / 1e6);
+    reportEtherBackend();
+}
+
+bool isMqttBrokerAttached(void)
+{
+    return brokerActive;
+}
+
+// Puts the broker on the wire without a publish generator or report, for
+// the benchmarks to stream to
+void attachMqttBroker(void)
+{
+    if (brokerActive)
+        return;
+    brokerActive = true;
+    brokerPubRate = 0;
+    attachHostTimer(tickMqttBroker, BROKER_TICK_US, getBrokerIdleTicks, NULL);
+    brokerStart = getHostTimeNs();
+}
+
+void setMqttBrokerLoss(double loss)
+{
+    brokerLoss = loss;
+}
+
+void initMqttBroker(void)
+{
+    char topics[MAX_PUB_TOPICS * MAX_TOPIC_SIZE];
+    char *name;
+
+    brokerActive = getenv("MQTT_BROKER") != NULL;
+    if (!brokerActive)
+        return;
+    if (getenv("MQTT_LOSS") != NULL)
+        brokerLoss = strtod(getenv("MQTT_LOSS"), NULL);
+    brokerPubRate = getBrokerEnv("MQTT_PUB_RATE", 10);
+    brokerPubBurst = getBrokerEnv("MQTT_PUB_BURST", 1);
+    brokerPubSize = getBrokerEnv("MQTT_PUB_SIZE", 8);
+    brokerPubQos = getBrokerEnv("MQTT_PUB_QOS", 0) != 0;
+    brokerPubPack = getBrokerEnv("MQTT_PUB_PACK", 1);
+    if (getenv("MQTT_PUB_SECONDS") != NULL)
+        brokerPubEnd = (uint64_t)getBrokerEnv("MQTT_PUB_SECONDS", 0) * 1000000;
+    if (brokerPubBurst == 0)
+        brokerPubBurst = 1;
+    if (brokerPubPack == 0)
+        brokerPubPack = 1;
+    if (brokerPubSize > MAX_PUB_SIZE)
+        brokerPubSize = MAX_PUB_SIZE;
+    if (brokerPubRate != 0)
+        brokerPubInterval = (uint64_t)brokerPubBurst * 1000000 / brokerPubRate;
+    if (brokerPubInterval == 0)
+        brokerPubInterval = 1;
+
+    if (getenv("MQTT_PUB_TOPICS") != NULL)
+    {
+        snprintf(topics, sizeof(topics), "%s", getenv("MQTT_PUB_TOPICS"));
+        name = strtok(topics, ",");
+        while (name != NULL && brokerPubTopicCount < MAX_PUB_TOPICS)
+        {
+            snprintf(brokerPubTopics[brokerPubTopicCount++], MAX_TOPIC_SIZE, "%s%s",
+                     strchr(name, '/') ? "" : FEED_PREFIX, name);
+            name = strtok(NULL, ",");
+        }
+    }
+
+    attachHostTimer(tickMqttBroker, BROKER_TICK_US, getBrokerIdleTicks, NULL);
+    brokerStart = getHostTimeNs();
+    atexit(reportMqttBroker);
+}
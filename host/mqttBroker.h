@@ -0,0 +1,38 @@
+// MQTT Broker Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Stand-in for the MQTT broker (Adafruit IO) at the far end of the wire
+// (etherWire.c), so the bridge's TCP/MQTT path in ethernet.c can be loaded
+// end to end without a live account.  See mqttBroker.c for the environment.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef MQTTBROKER_H_
+#define MQTTBROKER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initMqttBroker(void);
+void attachMqttBroker(void);
+bool isMqttBrokerAttached(void);
+void setMqttBrokerLoss(double loss);
+
+// Frames transmitted by the bridge
+void receiveMqttBrokerFrame(const uint8_t frame[], uint16_t size);
+
+#endif
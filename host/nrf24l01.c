@@ -0,0 +1,348 @@
+// nRF24L01+ Model Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "nrf24l01.h"
+#include "radioChannel.h"
+
+#define REG_COUNT   32
+#define ADDR_SIZE   5
+#define FIFO_DEPTH  3
+
+// Registers
+#define CONFIG      0x00
+#define PRIM_RX 0x01
+#define PWR_UP  0x02
+#define EN_AA       0x01
+#define EN_RXADDR   0x02
+#define SETUP_AW    0x03
+#define SETUP_RETR  0x04
+#define RF_CH       0x05
+#define RF_SETUP    0x06
+#define RF_DR_HIGH 0x08
+#define RF_DR_LOW  0x20
+#define STATUS      0x07
+#define MAX_RT  0x10
+#define TX_DS   0x20
+#define RX_DR   0x40
+#define RX_P_NO 0x0E
+#define TX_FULL 0x01
+#define RX_ADDR_P0  0x0A
+#define RX_ADDR_P1  0x0B
+#define TX_ADDR     0x10
+#define FIFO_STATUS 0x17
+#define RX_EMPTY 0x01
+#define RX_FULL  0x02
+#define TX_EMPTY 0x10
+#define FIFO_TX_FULL 0x20
+#define FEATURE     0x1D
+
+// Commands
+#define R_REGISTER          0x00
+#define W_REGISTER          0x20
+#define R_RX_PL_WID         0x60
+#define R_RX_PAYLOAD        0x61
+#define W_TX_PAYLOAD        0xA0
+#define W_TX_PAYLOAD_NO_ACK 0xB0
+#define FLUSH_TX            0xE1
+#define FLUSH_RX            0xE2
+#define NOP                 0xFF
+
+typedef struct _nrfPayload
+{
+    uint8_t size;
+    uint8_t data[MAX_RADIO_PAYLOAD];
+} nrfPayload;
+
+typedef struct _nrfFifo
+{
+    nrfPayload entries[FIFO_DEPTH];
+    uint8_t head;
+    uint8_t count;
+} nrfFifo;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t nrfRegs[REG_COUNT];
+uint8_t nrfAddrs[3][ADDR_SIZE];     // RX_ADDR_P0, RX_ADDR_P1, TX_ADDR
+nrfFifo nrfTxFifo;
+nrfFifo nrfRxFifo;
+nrfPayload nrfStaged;               // W_TX_PAYLOAD bytes of the current frame
+
+bool nrfSelected = false;
+bool nrfCe = false;
+bool nrfSending = false;
+uint8_t nrfCommand = NOP;
+uint8_t nrfIndex = 0;               // bytes clocked since CS went low
+uint8_t nrfNode = 0;
+_nrf24l01Reader nrfReader = NULL;
+nrf24l01Stats nrfStats;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+nrfPayload* getNrfHead(nrfFifo *fifo)
+{
+    return &fifo->entries[fifo->head];
+}
+
+void pushNrfFifo(nrfFifo *fifo, const uint8_t data[], uint8_t size)
+{
+    nrfPayload *p = &fifo->entries[(fifo->head + fifo->count) % FIFO_DEPTH];
+    p->size = size;
+    memcpy(p->data, data, size);
+    fifo->count++;
+}
+
+void popNrfFifo(nrfFifo *fifo)
+{
+    fifo->head = (fifo->head + 1) % FIFO_DEPTH;
+    fifo->count--;
+}
+
+uint16_t getNrf24l01DataRate(void)
+{
+    if (nrfRegs[RF_SETUP] & RF_DR_LOW)
+        return 250;
+    return (nrfRegs[RF_SETUP] & RF_DR_HIGH) ? 2000 : 1000;
+}
+
+uint8_t getNrfStatus(void)
+{
+    uint8_t status = nrfRegs[STATUS] & (RX_DR | TX_DS | MAX_RT);
+    if (nrfRxFifo.count == 0)
+        status |= RX_P_NO;          // pipe 0 otherwise
+    if (nrfTxFifo.count == FIFO_DEPTH)
+        status |= TX_FULL;
+    return status;
+}
+
+uint8_t getNrfFifoStatus(void)
+{
+    uint8_t status = 0;
+    if (nrfTxFifo.count == FIFO_DEPTH)
+        status |= FIFO_TX_FULL;
+    if (nrfTxFifo.count == 0)
+        status |= TX_EMPTY;
+    if (nrfRxFifo.count == FIFO_DEPTH)
+        status |= RX_FULL;
+    if (nrfRxFifo.count == 0)
+        status |= RX_EMPTY;
+    return status;
+}
+
+// Follows CE and CONFIG: PRX listens, PTX sends the head of the TX FIFO
+void updateNrfMode(void)
+{
+    bool powered = nrfRegs[CONFIG] & PWR_UP;
+    bool prx = nrfRegs[CONFIG] & PRIM_RX;
+    nrfPayload *p;
+
+    setRadioListening(nrfNode, powered && prx && nrfCe && !nrfSending);
+    if (powered && !prx && nrfCe && !nrfSending && nrfTxFifo.count != 0)
+    {
+        p = getNrfHead(&nrfTxFifo);
+        nrfSending = startRadioTransmission(nrfNode, p->data, p->size);
+    }
+}
+
+void receiveNrfPayload(uint8_t node, const uint8_t data[], uint8_t size)
+{
+    if (nrfRxFifo.count == FIFO_DEPTH)
+        nrfStats.rxOverflows++;
+    else
+    {
+        pushNrfFifo(&nrfRxFifo, data, size);
+        nrfRegs[STATUS] |= RX_DR;
+        nrfStats.rxPackets++;
+    }
+}
+
+void finishNrfPayload(uint8_t node)
+{
+    nrfSending = false;
+    if (nrfTxFifo.count != 0)
+        popNrfFifo(&nrfTxFifo);
+    nrfRegs[STATUS] |= TX_DS;
+    nrfStats.txPackets++;
+    updateNrfMode();
+}
+
+void resetNrf24l01(void)
+{
+    memset(nrfRegs, 0, sizeof(nrfRegs));
+    nrfRegs[CONFIG] = 0x08;
+    nrfRegs[EN_AA] = 0x3F;
+    nrfRegs[EN_RXADDR] = 0x03;
+    nrfRegs[SETUP_AW] = 0x03;
+    nrfRegs[SETUP_RETR] = 0x03;
+    nrfRegs[RF_CH] = 0x02;
+    nrfRegs[RF_SETUP] = 0x0E;
+    memset(nrfAddrs[0], 0xE7, ADDR_SIZE);
+    memset(nrfAddrs[1], 0xC2, ADDR_SIZE);
+    memset(nrfAddrs[2], 0xE7, ADDR_SIZE);
+    memset(&nrfTxFifo, 0, sizeof(nrfTxFifo));
+    memset(&nrfRxFifo, 0, sizeof(nrfRxFifo));
+    nrfSending = false;
+    tuneRadioNode(nrfNode, nrfRegs[RF_CH], getNrf24l01DataRate());
+    updateNrfMode();
+}
+
+void attachNrf24l01(_nrf24l01Reader reader)
+{
+    nrfReader = reader;
+    nrfNode = addRadioNode(receiveNrfPayload, finishNrfPayload);
+    resetNrf24l01();
+}
+
+int8_t getNrfAddrIndex(uint8_t reg)
+{
+    if (reg == RX_ADDR_P0)
+        return 0;
+    if (reg == RX_ADDR_P1)
+        return 1;
+    if (reg == TX_ADDR)
+        return 2;
+    return -1;
+}
+
+uint8_t readNrfRegister(uint8_t reg, uint8_t index)
+{
+    int8_t addr = getNrfAddrIndex(reg);
+    if (addr >= 0)
+        return nrfAddrs[addr][index % ADDR_SIZE];
+    if (reg == STATUS)
+        return getNrfStatus();
+    if (reg == FIFO_STATUS)
+        return getNrfFifoStatus();
+    return nrfRegs[reg];
+}
+
+void writeNrfRegister(uint8_t reg, uint8_t index, uint8_t value)
+{
+    int8_t addr = getNrfAddrIndex(reg);
+    if (addr >= 0)
+        nrfAddrs[addr][index % ADDR_SIZE] = value;
+    else if (reg == STATUS)
+        nrfRegs[STATUS] &= ~(value & (RX_DR | TX_DS | MAX_RT));
+    else if (reg != FIFO_STATUS)
+        nrfRegs[reg] = value;
+    if (reg == RF_CH || reg == RF_SETUP)
+        tuneRadioNode(nrfNode, nrfRegs[RF_CH] & 0x7F, getNrf24l01DataRate());
+    if (reg == CONFIG)
+        updateNrfMode();
+}
+
+// Payload commands take effect when CS goes high
+void selectNrf24l01(bool cs)
+{
+    updateRadioChannel();
+    if (!cs && !nrfSelected)
+    {
+        nrfSelected = true;
+        nrfCommand = NOP;
+        nrfIndex = 0;
+        nrfStaged.size = 0;
+        nrfStats.transactions++;
+    }
+    else if (cs && nrfSelected)
+    {
+        nrfSelected = false;
+        if (nrfCommand == R_RX_PAYLOAD && nrfIndex > 1 && nrfRxFifo.count != 0)
+        {
+            nrfPayload *p = getNrfHead(&nrfRxFifo);
+            nrfStats.rxRead++;
+            if (nrfReader != NULL)
+                (*nrfReader)(p->data, p->size);
+            popNrfFifo(&nrfRxFifo);
+        }
+        if ((nrfCommand == W_TX_PAYLOAD || nrfCommand == W_TX_PAYLOAD_NO_ACK) && nrfStaged.size != 0 &&
+            nrfTxFifo.count < FIFO_DEPTH)
+        {
+            pushNrfFifo(&nrfTxFifo, nrfStaged.data, nrfStaged.size);
+            updateNrfMode();
+        }
+    }
+}
+
+void enableNrf24l01(bool ce)
+{
+    updateRadioChannel();
+    nrfCe = ce;
+    updateNrfMode();
+}
+
+// The first byte of every command clocks STATUS back
+uint8_t transferNrf24l01(uint8_t data)
+{
+    uint8_t reply = 0;
+    uint8_t reg, index;
+
+    updateRadioChannel();
+    nrfStats.bytes++;
+    if (!nrfSelected)
+        return 0xFF;
+    if (nrfIndex++ == 0)
+    {
+        nrfCommand = data;
+        if (data == FLUSH_TX)
+        {
+            nrfStats.txFlushed += nrfTxFifo.count - (nrfSending ? 1 : 0);
+            nrfTxFifo.count = nrfSending ? 1 : 0;
+        }
+        else if (data == FLUSH_RX)
+        {
+            nrfStats.rxFlushed += nrfRxFifo.count;
+            nrfRxFifo.count = 0;
+        }
+        return getNrfStatus();
+    }
+
+    index = nrfIndex - 2;
+    if (nrfCommand < W_REGISTER)
+    {
+        reg = nrfCommand & 0x1F;
+        reply = readNrfRegister(reg, index);
+    }
+    else if (nrfCommand < R_RX_PL_WID)
+    {
+        reg = nrfCommand & 0x1F;
+        writeNrfRegister(reg, index, data);
+    }
+    else if (nrfCommand == R_RX_PL_WID)
+        reply = (nrfRxFifo.count != 0) ? getNrfHead(&nrfRxFifo)->size : 0;
+    else if (nrfCommand == R_RX_PAYLOAD)
+    {
+        if (nrfRxFifo.count != 0 && index < getNrfHead(&nrfRxFifo)->size)
+            reply = getNrfHead(&nrfRxFifo)->data[index];
+    }
+    else if (nrfCommand == W_TX_PAYLOAD || nrfCommand == W_TX_PAYLOAD_NO_ACK)
+    {
+        if (nrfStaged.size < MAX_RADIO_PAYLOAD)
+            nrfStaged.data[nrfStaged.size++] = data;
+    }
+    return reply;
+}
+
+void getNrf24l01Stats(nrf24l01Stats *stats)
+{
+    *stats = nrfStats;
+}
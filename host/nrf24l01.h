@@ -0,0 +1,60 @@
+// nRF24L01+ Model Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Register level model of the bridge's nRF24L01+ on spi1 (CS on PD1, CE on
+// PB1), transmitting on the shared radio channel (radioChannel.h).
+//
+// Modelled: the SPI command set (R/W_REGISTER, R_RX_PL_WID, R_RX_PAYLOAD,
+// W_TX_PAYLOAD, W_TX_PAYLOAD_NO_ACK, FLUSH_TX, FLUSH_RX, NOP), STATUS with
+// write-1-to-clear flags and RX_P_NO, FIFO_STATUS, 3-deep TX and RX FIFOs,
+// PRX listening while CE is high and PTX sending one payload per CE pulse
+// (or back to back while CE stays high), with the airtime of the data rate
+// selected in RF_SETUP.  Every payload goes out as NO_ACK on pipe 0; auto
+// acknowledge, retransmission and the IRQ pin are not modelled.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef NRF24L01_H_
+#define NRF24L01_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Called when the MCU has read a payload out of the RX FIFO
+typedef void (*_nrf24l01Reader)(const uint8_t data[], uint8_t size);
+
+typedef struct _nrf24l01Stats
+{
+    uint32_t transactions;          // chip selects
+    uint32_t bytes;                 // bytes clocked
+    uint32_t txPackets;             // payloads sent
+    uint32_t rxPackets;             // payloads accepted into the RX FIFO
+    uint32_t rxRead;                // payloads read out by the MCU
+    uint32_t rxOverflows;           // payloads dropped, RX FIFO full
+    uint32_t rxFlushed;             // payloads discarded by FLUSH_RX
+    uint32_t txFlushed;             // payloads discarded by FLUSH_TX
+} nrf24l01Stats;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void attachNrf24l01(_nrf24l01Reader reader);
+void resetNrf24l01(void);
+void selectNrf24l01(bool cs);
+void enableNrf24l01(bool ce);
+uint8_t transferNrf24l01(uint8_t data);
+uint16_t getNrf24l01DataRate(void);
+void getNrf24l01Stats(nrf24l01Stats *stats);
+
+#endif
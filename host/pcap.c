@@ -0,0 +1,157 @@
+// pcap File Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "pcap.h"
+
+#define PCAP_MAGIC_US       0xA1B2C3D4
+#define PCAP_MAGIC_NS       0xA1B23C4D
+#define PCAP_HEADER_SIZE    24
+#define PCAP_RECORD_SIZE    16
+#define PCAP_SNAPLEN        65535
+#define LINKTYPE_ETHERNET   1
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint32_t swap32(uint32_t value)
+{
+    return ((value & 0xFF000000) >> 24) + ((value & 0x00FF0000) >> 8) +
+           ((value & 0x0000FF00) << 8) + ((value & 0x000000FF) << 24);
+}
+
+uint32_t getPcapWord(pcapFile *pcap, const uint8_t bytes[4])
+{
+    uint32_t value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return pcap->swapped ? swap32(value) : value;
+}
+
+void putPcapWord(uint8_t bytes[4], uint32_t value)
+{
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+    bytes[2] = value >> 16;
+    bytes[3] = value >> 24;
+}
+
+// Opens a capture for reading and checks that it carries Ethernet frames
+bool openPcapReader(pcapFile *pcap, const char *path)
+{
+    uint8_t header[PCAP_HEADER_SIZE];
+    uint32_t magic;
+    bool ok = false;
+
+    pcap->swapped = false;
+    pcap->nanosec = false;
+    pcap->file = fopen(path, "rb");
+    if (pcap->file == NULL)
+        return false;
+    if (fread(header, 1, PCAP_HEADER_SIZE, pcap->file) == PCAP_HEADER_SIZE)
+    {
+        magic = getPcapWord(pcap, &header[0]);
+        if (magic == swap32(PCAP_MAGIC_US) || magic == swap32(PCAP_MAGIC_NS))
+        {
+            pcap->swapped = true;
+            magic = swap32(magic);
+        }
+        pcap->nanosec = (magic == PCAP_MAGIC_NS);
+        ok = (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) &&
+             (getPcapWord(pcap, &header[20]) & 0xFFFF) == LINKTYPE_ETHERNET;
+    }
+    if (!ok)
+        closePcap(pcap);
+    return ok;
+}
+
+// Creates (or truncates) a capture and writes the global header
+bool openPcapWriter(pcapFile *pcap, const char *path)
+{
+    uint8_t header[PCAP_HEADER_SIZE];
+
+    pcap->swapped = false;
+    pcap->nanosec = false;
+    pcap->file = fopen(path, "wb");
+    if (pcap->file == NULL)
+        return false;
+    putPcapWord(&header[0], PCAP_MAGIC_US);
+    header[4] = 2;                  // version 2.4
+    header[5] = 0;
+    header[6] = 4;
+    header[7] = 0;
+    putPcapWord(&header[8], 0);     // thiszone
+    putPcapWord(&header[12], 0);    // sigfigs
+    putPcapWord(&header[16], PCAP_SNAPLEN);
+    putPcapWord(&header[20], LINKTYPE_ETHERNET);
+    return fwrite(header, 1, PCAP_HEADER_SIZE, pcap->file) == PCAP_HEADER_SIZE;
+}
+
+// Returns the captured length of the next frame or PCAP_EOF
+// Frames longer than maxSize are truncated to maxSize
+int32_t readPcapFrame(pcapFile *pcap, uint8_t data[], uint16_t maxSize, uint64_t *timeUs)
+{
+    uint8_t record[PCAP_RECORD_SIZE];
+    uint32_t length;
+    uint32_t fraction;
+
+    if (pcap->file == NULL || fread(record, 1, PCAP_RECORD_SIZE, pcap->file) != PCAP_RECORD_SIZE)
+        return PCAP_EOF;
+    length = getPcapWord(pcap, &record[8]);
+    if (timeUs != NULL)
+    {
+        fraction = getPcapWord(pcap, &record[4]);
+        *timeUs = (uint64_t)getPcapWord(pcap, &record[0]) * 1000000 +
+                  (pcap->nanosec ? fraction / 1000 : fraction);
+    }
+    if (length > maxSize)
+    {
+        if (fread(data, 1, maxSize, pcap->file) != maxSize ||
+            fseek(pcap->file, length - maxSize, SEEK_CUR) != 0)
+            return PCAP_EOF;
+        return maxSize;
+    }
+    if (fread(data, 1, length, pcap->file) != length)
+        return PCAP_EOF;
+    return length;
+}
+
+// Moves back to the first frame
+bool rewindPcap(pcapFile *pcap)
+{
+    return pcap->file != NULL && fseek(pcap->file, PCAP_HEADER_SIZE, SEEK_SET) == 0;
+}
+
+bool writePcapFrame(pcapFile *pcap, const uint8_t data[], uint16_t size, uint64_t timeUs)
+{
+    uint8_t record[PCAP_RECORD_SIZE];
+
+    if (pcap->file == NULL)
+        return false;
+    putPcapWord(&record[0], timeUs / 1000000);
+    putPcapWord(&record[4], timeUs % 1000000);
+    putPcapWord(&record[8], size);
+    putPcapWord(&record[12], size);
+    return fwrite(record, 1, PCAP_RECORD_SIZE, pcap->file) == PCAP_RECORD_SIZE &&
+           fwrite(data, 1, size, pcap->file) == size;
+}
+
+void closePcap(pcapFile *pcap)
+{
+    if (pcap->file != NULL)
+        fclose(pcap->file);
+    pcap->file = NULL;
+}
@@ -0,0 +1,47 @@
+// pcap File Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Reads and writes classic libpcap capture files (LINKTYPE_ETHERNET) so
+// frames can be replayed into and captured from the host eth0 backends.
+// Both byte orders and the nanosecond variant are accepted when reading.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PCAP_H_
+#define PCAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct _pcapFile
+{
+    FILE *file;
+    bool swapped;                   // file written with the other byte order
+    bool nanosec;                   // timestamps in ns instead of us
+} pcapFile;
+
+#define PCAP_EOF -1
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool openPcapReader(pcapFile *pcap, const char *path);
+bool openPcapWriter(pcapFile *pcap, const char *path);
+int32_t readPcapFrame(pcapFile *pcap, uint8_t data[], uint16_t maxSize, uint64_t *timeUs);
+bool rewindPcap(pcapFile *pcap);
+bool writePcapFrame(pcapFile *pcap, const uint8_t data[], uint16_t size, uint64_t timeUs);
+void closePcap(pcapFile *pcap);
+
+#endif
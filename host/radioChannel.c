@@ -0,0 +1,243 @@
+// Radio Channel Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "host.h"
+#include "radioChannel.h"
+
+#define MAX_RADIO_FLIGHTS 16
+#define NOT_LISTENING     UINT64_MAX
+
+// Enhanced ShockBurst frame around the payload: 1 byte preamble, 5 byte
+// address, 9 bit packet control field and a 2 byte CRC
+#define RADIO_OVERHEAD_BITS ((1 + 5 + 2) * 8 + 9)
+
+typedef struct _radioNode
+{
+    _radioReceive receive;
+    _radioTxDone txDone;
+    uint8_t channel;
+    uint16_t kbps;
+    uint64_t listeningSince;        // us, NOT_LISTENING when deaf
+} radioNode;
+
+typedef struct _radioFlight
+{
+    bool active;
+    bool collided;
+    uint8_t node;
+    uint8_t channel;
+    uint16_t kbps;
+    uint8_t size;
+    uint8_t data[MAX_RADIO_PAYLOAD];
+    uint64_t start;                 // us
+    uint64_t end;                   // us
+} radioFlight;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+radioNode radioNodes[MAX_RADIO_NODES];
+uint8_t radioNodeCount = 0;
+radioFlight radioFlights[MAX_RADIO_FLIGHTS];
+uint32_t radioLossThreshold = 0;    // loss probability scaled to 2^32
+uint16_t radioForcedKbps = 0;
+_radioObserver radioObserver = NULL;
+radioStats radioTotals;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t addRadioNode(_radioReceive receive, _radioTxDone txDone)
+{
+    radioNode *n = &radioNodes[radioNodeCount];
+    n->receive = receive;
+    n->txDone = txDone;
+    n->channel = 2;
+    n->kbps = 2000;
+    n->listeningSince = NOT_LISTENING;
+    return radioNodeCount++;
+}
+
+void tuneRadioNode(uint8_t node, uint8_t channel, uint16_t kbps)
+{
+    radioNodes[node].channel = channel;
+    radioNodes[node].kbps = kbps;
+}
+
+// A receiver only hears packets that started after it began listening
+void setRadioListening(uint8_t node, bool listening)
+{
+    radioNode *n = &radioNodes[node];
+    if (!listening)
+        n->listeningSince = NOT_LISTENING;
+    else if (n->listeningSince == NOT_LISTENING)
+        n->listeningSince = getHostTime();
+}
+
+// Probability (0 to 1) that a receiver misses an otherwise clean packet
+void setRadioLoss(double loss)
+{
+    if (loss <= 0)
+        radioLossThreshold = 0;
+    else if (loss >= 1)
+        radioLossThreshold = UINT32_MAX;
+    else
+        radioLossThreshold = loss * 4294967296.0;
+}
+
+// Overrides the data rate every node is tuned to (0 uses the node's own)
+void forceRadioDataRate(uint16_t kbps)
+{
+    radioForcedKbps = kbps;
+}
+
+uint16_t getNodeDataRate(uint8_t node)
+{
+    return (radioForcedKbps != 0) ? radioForcedKbps : radioNodes[node].kbps;
+}
+
+// Returns the time on air of one packet in us, not counting TX settling
+uint32_t getRadioAirtime(uint8_t size, uint16_t kbps)
+{
+    uint32_t bits = RADIO_OVERHEAD_BITS + size * 8;
+    return (bits * 1000 + kbps - 1) / kbps;
+}
+
+void setRadioObserver(_radioObserver observer)
+{
+    radioObserver = observer;
+}
+
+// Puts a packet on the air once the transmitter has settled
+// Returns false if the channel model has no room for another transmission
+bool startRadioTransmission(uint8_t node, const uint8_t data[], uint8_t size)
+{
+    radioFlight *f = NULL;
+    uint8_t i;
+
+    updateRadioChannel();
+    for (i = 0; i < MAX_RADIO_FLIGHTS && f == NULL; i++)
+        if (!radioFlights[i].active)
+            f = &radioFlights[i];
+    if (f == NULL)
+        return false;
+    if (size > MAX_RADIO_PAYLOAD)
+        size = MAX_RADIO_PAYLOAD;
+
+    f->active = true;
+    f->collided = false;
+    f->node = node;
+    f->channel = radioNodes[node].channel;
+    f->kbps = getNodeDataRate(node);
+    f->size = size;
+    memcpy(f->data, data, size);
+    f->start = getHostTime() + RADIO_SETTLE_US;
+    f->end = f->start + getRadioAirtime(size, f->kbps);
+
+    for (i = 0; i < MAX_RADIO_FLIGHTS; i++)
+    {
+        radioFlight *g = &radioFlights[i];
+        if (g != f && g->active && g->channel == f->channel && g->start < f->end && f->start < g->end)
+        {
+            g->collided = true;
+            f->collided = true;
+        }
+    }
+    return true;
+}
+
+void finishRadioFlight(radioFlight *f)
+{
+    radioNode *n;
+    uint8_t i;
+
+    f->active = false;
+    radioTotals.packets++;
+    radioTotals.airtime += f->end - f->start;
+    if (f->collided)
+        radioTotals.collided++;
+    else
+    {
+        for (i = 0; i < radioNodeCount; i++)
+        {
+            n = &radioNodes[i];
+            if (i != f->node && n->listeningSince <= f->start && n->channel == f->channel &&
+                getNodeDataRate(i) == f->kbps && n->receive != NULL)
+            {
+                if (radioLossThreshold != 0 && getHostRandom() <= radioLossThreshold)
+                    radioTotals.lost++;
+                else
+                {
+                    radioTotals.delivered++;
+                    markHostActivity();
+                    (*n->receive)(i, f->data, f->size);
+                }
+            }
+        }
+    }
+    if (radioObserver != NULL)
+        (*radioObserver)(f->node, f->data, f->size, f->start, f->end, f->collided);
+    n = &radioNodes[f->node];
+    if (n->txDone != NULL)
+        (*n->txDone)(f->node);
+}
+
+// Delivers every transmission that has left the air, oldest first
+void updateRadioChannel(void)
+{
+    static bool updating = false;
+    uint64_t now = getHostTime();
+    radioFlight *next;
+    uint8_t i;
+
+    if (updating)
+        return;
+    updating = true;
+    do
+    {
+        next = NULL;
+        for (i = 0; i < MAX_RADIO_FLIGHTS; i++)
+        {
+            radioFlight *f = &radioFlights[i];
+            if (f->active && f->end <= now && (next == NULL || f->end < next->end))
+                next = f;
+        }
+        if (next != NULL)
+            finishRadioFlight(next);
+    } while (next != NULL);
+    updating = false;
+}
+
+void getRadioStats(radioStats *stats)
+{
+    *stats = radioTotals;
+}
+
+// Returns when the next transmission leaves the air (us), or UINT64_MAX
+uint64_t getRadioNextEvent(void)
+{
+    uint64_t end = UINT64_MAX;
+    uint8_t i;
+    for (i = 0; i < MAX_RADIO_FLIGHTS; i++)
+        if (radioFlights[i].active && radioFlights[i].end < end)
+            end = radioFlights[i].end;
+    return end;
+}
@@ -0,0 +1,69 @@
+// Radio Channel Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// The air shared by the bridge's nRF24L01+ model and the simulated devices.
+// Every node tunes to an RF channel and data rate; a transmission occupies
+// the channel for its ShockBurst airtime after the 130 us TX settling time.
+// Transmissions that overlap on the same RF channel are all lost (no capture
+// effect).  The others reach every node that was listening on the same
+// channel and data rate for the whole packet, less a configurable random
+// loss.  Time is host time; completed transmissions are delivered by
+// updateRadioChannel().
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef RADIO_CHANNEL_H_
+#define RADIO_CHANNEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_RADIO_NODES   40
+#define MAX_RADIO_PAYLOAD 32
+#define RADIO_SETTLE_US   130
+
+// Called when a packet is heard, and on the sender when its packet has left
+typedef void (*_radioReceive)(uint8_t node, const uint8_t data[], uint8_t size);
+typedef void (*_radioTxDone)(uint8_t node);
+// Called once per finished transmission (start and end are on-air times, us)
+typedef void (*_radioObserver)(uint8_t node, const uint8_t data[], uint8_t size,
+                               uint64_t start, uint64_t end, bool collided);
+
+typedef struct _radioStats
+{
+    uint32_t packets;               // transmissions completed
+    uint32_t collided;              // of those, overlapped by another
+    uint32_t delivered;             // copies heard by a receiver
+    uint32_t lost;                  // copies dropped by the loss model
+    uint64_t airtime;               // us on air
+} radioStats;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t addRadioNode(_radioReceive receive, _radioTxDone txDone);
+void tuneRadioNode(uint8_t node, uint8_t channel, uint16_t kbps);
+void setRadioListening(uint8_t node, bool listening);
+
+void setRadioLoss(double loss);
+void forceRadioDataRate(uint16_t kbps);
+uint32_t getRadioAirtime(uint8_t size, uint16_t kbps);
+void setRadioObserver(_radioObserver observer);
+
+bool startRadioTransmission(uint8_t node, const uint8_t data[], uint8_t size);
+void updateRadioChannel(void);
+uint64_t getRadioNextEvent(void);
+void getRadioStats(radioStats *stats);
+
+#endif
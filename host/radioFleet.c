@@ -0,0 +1,743 @@
+// Radio Fleet Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Puts the bridge's wireless.c on a simulated channel with a fleet of
+// devices, then reports goodput, slot utilisation and push latency.
+//
+// The bridge runs unmodified against the nRF24L01+ model (nrf24l01.c) on
+// spi1.  The devices are behavioural models of the device side of the
+// protocol in wireless.c: they follow the bridge's SYNC to find the access
+// slot and their uplink slot (getMySlot), send JOIN REQ and sensor PUSH
+// frames there, and listen to the downlink slot for JOIN RESP, PUSH and
+// DEVCAPS or PING requests, which they answer in their next uplink slot.
+// Every node shares the channel model (radioChannel.c), so airtime,
+// collisions and loss apply to bridge and devices alike.
+//
+// initWireless() and processWireless() are wrapped at link time: the first
+// attaches the model, the second injects pushes from the main loop (as
+// ethernet.c does for MQTT PUBLISH) and ends the run.
+//
+// Environment (the fleet is only attached when NRF_DEVICES is set):
+//   NRF_DEVICES    number of devices, 0 to MAX_FLEET_DEVICES
+//   NRF_JOIN       1: devices join one at a time through the access slot
+//                  with the bridge's JOIN button held; otherwise they are
+//                  provisioned in the bridge EEPROM (HOST_EEPROM is updated)
+//   NRF_SECONDS    run length before the report, default 30
+//   NRF_UPLINK_MS  interval between sensor reports on each device, default 1000
+//   NRF_PUSH_MS    interval between pushes queued for devices, default 1000
+//   NRF_DEVCAPS_MS interval between DEVCAPS requests, default 0 (none); the
+//                  bridge stores the answer in the binding table
+//   NRF_LOSS       probability a receiver misses a clean packet, default 0
+//   NRF_RATE       data rate forced on every node (250, 1000, 2000 kbps)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpio.h"
+#include "spi1.h"
+#include "eeprom.h"
+#include "wireless.h"
+#include "host.h"
+#include "radioChannel.h"
+#include "nrf24l01.h"
+#include "storage.h"
+
+#define MAX_FLEET_DEVICES  32
+#define MAX_QUEUED_REPORTS 4
+#define MAX_TRACKED_PUSHES 1024
+#define MAX_LATENCIES      4096
+#define FLEET_TICK_US      100
+#define MAX_JOIN_REQUESTS  10           // nrfJoinCount limit in wireless.c
+#define DEV_RECORD_SIZE    7            // device number and MAC in the bridge EEPROM
+
+typedef enum _fleetSlot
+{
+    SLOT_SYNC, SLOT_DL, SLOT_FACK, SLOT_ACCESS, SLOT_UL, SLOT_COUNT
+} fleetSlot;
+
+typedef struct _fleetDevice
+{
+    uint8_t node;
+    uint8_t devNum;                     // 0 until joined
+    uint8_t mac[6];
+    bool joining;
+    uint8_t joinRequests;
+    uint64_t joinStart;                 // us, join button pressed
+    uint64_t accessAt;                  // us, next JOIN REQ, 0 for none
+    uint64_t uplinkAt;                  // us, next uplink slot, 0 for none
+    uint64_t nextReport;                // us
+    uint64_t reportTimes[MAX_QUEUED_REPORTS];
+    uint8_t reports;
+    uint64_t sentReport;                // us, generation time of the report last sent
+    uint16_t seq;
+    uint8_t request;                    // DL request to answer in the next uplink slot
+} fleetDevice;
+
+typedef struct _fleetPush
+{
+    uint64_t queuedAt;                  // us
+    uint8_t devNum;
+    bool delivered;
+} fleetPush;
+
+typedef struct _fleetLatencies
+{
+    uint32_t samples[MAX_LATENCIES];    // us
+    uint32_t count;
+    uint64_t sum;
+    uint32_t max;
+} fleetLatencies;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+bool fleetActive = false;
+bool fleetJoinMode = false;
+uint8_t fleetSize = 0;
+fleetDevice fleet[MAX_FLEET_DEVICES];
+// The bridge compares MACs with strncmp(), so they must not contain 0x00
+uint8_t fleetMac[6] = {0x02, 0x46, 0x4C, 0x45, 0x45, 0x54};
+uint64_t fleetStart = 0;
+uint64_t fleetEnd = 0;
+uint32_t fleetUplinkUs = 1000000;
+uint32_t fleetPushUs = 1000000;
+uint64_t fleetNextPush = 0;
+uint8_t fleetNextTarget = 0;
+uint32_t fleetDevCapsUs = 0;
+uint64_t fleetNextDevCaps = 0;
+uint8_t fleetNextDevCapsTarget = 0;
+storageProbe joinProbe;
+bool joinProbeArmed = false;
+
+fleetPush fleetPushes[MAX_TRACKED_PUSHES];
+uint16_t fleetPushSeq = 0;
+uint32_t pushesQueued = 0;
+uint32_t pushesRejected = 0;
+uint32_t pushesToTarget = 0;
+uint32_t pushesToOthers = 0;
+fleetLatencies pushLatency;
+fleetLatencies uplinkLatency;
+
+uint32_t reportsDropped = 0;
+uint32_t uplinkPackets = 0;
+uint64_t uplinkBytes = 0;
+uint32_t downlinkPackets = 0;
+uint64_t downlinkBytes = 0;
+uint32_t joinRequests = 0;
+uint32_t joinFailures = 0;
+uint64_t joinTime = 0;              // us, summed over joined devices
+uint8_t joinedCount = 0;
+
+uint32_t superframes = 0;
+uint64_t firstSync = 0;
+uint64_t lastSync = 0;
+uint64_t slotAirtime[SLOT_COUNT];
+uint32_t uplinkSlotsUsed = 0;
+uint32_t uplinkSlotsOffered = 0;
+uint8_t slotsUsedThisFrame = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void __real_initWireless(void);
+void __real_processWireless(void);
+
+uint32_t getFleetEnv(const char *name, uint32_t value)
+{
+    if (getenv(name) != NULL)
+        value = strtoul(getenv(name), NULL, 0);
+    return value;
+}
+
+void addLatency(fleetLatencies *l, uint64_t us)
+{
+    if (l->count < MAX_LATENCIES)
+        l->samples[l->count] = us;
+    l->count++;
+    l->sum += us;
+    if (us > l->max)
+        l->max = us;
+}
+
+int compareLatency(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void reportLatency(const char *name, fleetLatencies *l)
+{
+    uint32_t n = (l->count < MAX_LATENCIES) ? l->count : MAX_LATENCIES;
+    if (n == 0)
+    {
+        fprintf(stderr, "  %s latency: no samples\n", name);
+        return;
+    }
+    qsort(l->samples, n, sizeof(uint32_t), compareLatency);
+    fprintf(stderr, "  %s latency: min %.1f avg %.1f p99 %.1f max %.1f ms (%u samples)\n", name,
+            l->samples[0] / 1e3, (double)l->sum / l->count / 1e3, l->samples[(n * 99) / 100] / 1e3,
+            l->max / 1e3, l->count);
+}
+
+fleetDevice* getFleetDevice(uint8_t devNum)
+{
+    uint8_t i;
+    for (i = 0; i < fleetSize; i++)
+        if (fleet[i].devNum == devNum && devNum != 0)
+            return &fleet[i];
+    return NULL;
+}
+
+uint32_t getFrameDevBits(const uint8_t data[])
+{
+    return data[5] | (data[6] << 8) | (data[7] << 16) | ((uint32_t)data[8] << 24);
+}
+
+bool isSyncFrame(const uint8_t data[], uint8_t size)
+{
+    return size == sizeof(syncMsg) && memcmp(data, syncMsg, sizeof(syncMsg) - 2) == 0;
+}
+
+bool isStartFrame(const uint8_t data[], uint8_t size)
+{
+    return size > META_DATA_SIZE - 1 && memcmp(data, startCode, sizeof(startCode)) == 0;
+}
+
+// Frames a packet the way nrf24l0TxMsg() does
+uint8_t buildFleetFrame(uint8_t frame[], uint8_t slot, uint32_t devBits, const uint8_t data[], uint8_t size)
+{
+    uint16_t remlen = size + 1 + sizeof(devBits);
+    memset(frame, 0, DATA_MAX_SIZE);
+    memcpy(frame, startCode, sizeof(startCode));
+    frame[2] = slot;
+    frame[3] = remlen & 0xFF;
+    frame[4] = remlen >> 8;
+    frame[5] = devBits & 0xFF;
+    frame[6] = (devBits >> 8) & 0xFF;
+    frame[7] = (devBits >> 16) & 0xFF;
+    frame[8] = devBits >> 24;
+    memcpy(&frame[META_DATA_SIZE - 1], data, size);
+    frame[size + META_DATA_SIZE - 1] = nrf24l0GetChecksum(frame, size + META_DATA_SIZE);
+    return size + META_DATA_SIZE;
+}
+
+// Same layout as nrf24l0TxJoinReq_DEV()
+void sendJoinRequest(fleetDevice *d)
+{
+    uint8_t frame[15] = {0};
+    memcpy(frame, startCode, sizeof(startCode));
+    frame[2] = 3;
+    frame[3] = 1 + sizeof(d->mac);
+    frame[4] = 0x80;
+    memcpy(&frame[5], d->mac, sizeof(d->mac));
+    frame[11] = nrf24l0GetChecksum(frame, sizeof(frame));
+    setRadioListening(d->node, false);
+    if (startRadioTransmission(d->node, frame, sizeof(frame)))
+    {
+        joinRequests++;
+        d->joinRequests++;
+    }
+}
+
+bool sendUplinkPacket(fleetDevice *d, const uint8_t data[], uint8_t size)
+{
+    uint8_t frame[DATA_MAX_SIZE];
+    size = buildFleetFrame(frame, d->devNum + 4, 0xFFFF0000 | d->devNum, data, size);
+    setRadioListening(d->node, false);
+    return startRadioTransmission(d->node, frame, size);
+}
+
+// Answers a DEVCAPS_REQUEST with one input capability, or a PING_REQUEST;
+// like reports, responses fill the whole payload the bridge checksums
+void sendUplinkResponse(fleetDevice *d)
+{
+    uint8_t data[MAX_WIRELESS_PACKET_SIZE] = {0};
+    wirelessPacket *wp = (wirelessPacket*)data;
+    deviceCaps *caps = (deviceCaps*)wp->data;
+
+    if (d->request == DEVCAPS_REQUEST)
+    {
+        wp->packetType = DEVCAPS_RESPONSE;
+        caps->deviceNum = '0' + d->devNum;
+        caps->numOfCaps = '1';
+        caps->caps[0].inputOrOutput = INPUT;
+        memcpy(caps->caps[0].capDescription, "TEMPF", sizeof(caps->caps[0].capDescription));
+        sendUplinkPacket(d, data, sizeof(data));
+    }
+    else
+    {
+        wp->packetType = PING_RESPONSE;
+        sendUplinkPacket(d, data, sizeof(data));
+    }
+    d->request = 0;
+}
+
+void sendUplinkReport(fleetDevice *d)
+{
+    uint8_t data[MAX_WIRELESS_PACKET_SIZE] = {0};
+    wirelessPacket *wp = (wirelessPacket*)data;
+    pushMessage *msg = (pushMessage*)wp->data;
+    uint8_t i;
+
+    wp->packetType = PUSH;
+    memcpy(msg->topicName, "TEMPF", sizeof(msg->topicName));
+    snprintf(msg->topicMessage, sizeof(msg->topicMessage), "%u", d->seq++);
+    if (sendUplinkPacket(d, data, sizeof(data)))
+    {
+        d->sentReport = d->reportTimes[0];
+        for (i = 1; i < d->reports; i++)
+            d->reportTimes[i - 1] = d->reportTimes[i];
+        d->reports--;
+    }
+}
+
+void queueFleetReport(fleetDevice *d, uint64_t now)
+{
+    uint8_t i;
+    if (d->reports == MAX_QUEUED_REPORTS)
+    {
+        for (i = 1; i < d->reports; i++)
+            d->reportTimes[i - 1] = d->reportTimes[i];
+        d->reports--;
+        reportsDropped++;
+    }
+    d->reportTimes[d->reports++] = now;
+}
+
+void receivePush(fleetDevice *d, const uint8_t data[], uint8_t size, bool mine)
+{
+    const pushMessage *msg = (const pushMessage*)&data[META_DATA_SIZE];
+    char text[sizeof(msg->topicMessage) + 1] = {0};
+    fleetPush *p;
+    uint16_t seq;
+
+    if (size < META_DATA_SIZE + 1 + sizeof(pushMessage))
+        return;
+    memcpy(text, msg->topicMessage, sizeof(msg->topicMessage));
+    seq = strtoul(text, NULL, 10);
+    p = &fleetPushes[seq % MAX_TRACKED_PUSHES];
+    if (p->queuedAt != 0 && !p->delivered)
+    {
+        p->delivered = true;
+        addLatency(&pushLatency, getHostTime() - p->queuedAt);
+    }
+    if (mine)
+    {
+        if (p->devNum == d->devNum)
+            pushesToTarget++;
+        else
+            pushesToOthers++;
+        downlinkPackets++;
+        downlinkBytes += size - META_DATA_SIZE;
+    }
+}
+
+// Device side of parsenrf24l01DataPacket() and nrf24l0RxMsg()
+void receiveFleetFrame(uint8_t node, const uint8_t data[], uint8_t size)
+{
+    uint64_t now = getHostTime();
+    fleetDevice *d = NULL;
+    uint32_t devBits;
+    bool mine;
+    uint8_t type, i;
+
+    for (i = 0; i < fleetSize && d == NULL; i++)
+        if (fleet[i].node == node)
+            d = &fleet[i];
+    if (d == NULL)
+        return;
+
+    if (isSyncFrame(data, size))
+    {
+        if (d->joining && d->joinRequests == MAX_JOIN_REQUESTS)
+        {
+            d->joining = false;
+            joinFailures++;
+        }
+        else if (d->joining)
+            d->accessAt = now + (uint32_t)(ACCESS_SLOT) * 1000 + TX_RX_DELAY;
+        else if (d->devNum != 0)
+            d->uplinkAt = now + getMySlot(d->devNum) * 1000 + TX_RX_DELAY;
+    }
+    else if (isStartFrame(data, size) && data[2] == 1)
+    {
+        if (data[4] == 0x80)
+        {
+            if (d->joining)
+            {
+                d->devNum = data[5];
+                d->joining = false;
+                d->accessAt = 0;
+                joinedCount++;
+                joinTime += now - d->joinStart;
+            }
+        }
+        else
+        {
+            devBits = getFrameDevBits(data);
+            mine = d->devNum != 0 && d->devNum < 32 && (devBits & 0xFFFF0000) == 0 &&
+                   (devBits & (1UL << d->devNum)) != 0;
+            type = data[META_DATA_SIZE - 1];
+            if (type == PUSH)
+                receivePush(d, data, size, mine);
+            else if (mine && (type == DEVCAPS_REQUEST || type == PING_REQUEST))
+                d->request = type;
+        }
+    }
+}
+
+void finishFleetFrame(uint8_t node)
+{
+    setRadioListening(node, true);
+}
+
+// Payloads the bridge firmware has read out of its RX FIFO
+void readBridgeFrame(const uint8_t data[], uint8_t size)
+{
+    uint32_t devBits;
+    fleetDevice *d;
+
+    if (isStartFrame(data, size) && data[2] == 3 && data[4] == 0x80)
+    {
+        startStorageProbe(&joinProbe);
+        joinProbeArmed = true;
+    }
+    if (!isStartFrame(data, size) || data[2] <= 3)
+        return;
+    devBits = getFrameDevBits(data);
+    if ((devBits & 0xFFFF0000) == 0)
+        return;
+    uplinkPackets++;
+    uplinkBytes += size - META_DATA_SIZE;
+    d = getFleetDevice(devBits & 0xFFFF);
+    if (d != NULL && d->sentReport != 0)
+    {
+        addLatency(&uplinkLatency, getHostTime() - d->sentReport);
+        d->sentReport = 0;
+    }
+}
+
+// Charges each transmission to the slot it was sent in
+void observeFleetFrame(uint8_t node, const uint8_t data[], uint8_t size, uint64_t start, uint64_t end, bool collided)
+{
+    fleetSlot slot = SLOT_UL;
+
+    if (isSyncFrame(data, size))
+    {
+        if (superframes != 0)
+        {
+            uplinkSlotsOffered += joinedCount;
+            uplinkSlotsUsed += slotsUsedThisFrame;
+        }
+        else
+            firstSync = start;
+        lastSync = start;
+        superframes++;
+        slotsUsedThisFrame = 0;
+        slot = SLOT_SYNC;
+    }
+    else if (isStartFrame(data, size))
+    {
+        if (data[2] == 1)
+            slot = SLOT_DL;
+        else if (data[2] == 2)
+            slot = SLOT_FACK;
+        else if (data[2] == 3)
+            slot = SLOT_ACCESS;
+        else if (!collided)
+            slotsUsedThisFrame++;
+    }
+    if (superframes != 0)
+        slotAirtime[slot] += end - start;
+}
+
+void tickRadioFleet(void)
+{
+    uint64_t now = getHostTime();
+    fleetDevice *d;
+    uint8_t i;
+
+    updateRadioChannel();
+    for (i = 0; i < fleetSize; i++)
+    {
+        d = &fleet[i];
+        while (d->nextReport != 0 && now >= d->nextReport)
+        {
+            queueFleetReport(d, now);
+            d->nextReport += fleetUplinkUs;
+        }
+        if (d->accessAt != 0 && now >= d->accessAt)
+        {
+            d->accessAt = 0;
+            sendJoinRequest(d);
+        }
+        if (d->uplinkAt != 0 && now >= d->uplinkAt)
+        {
+            d->uplinkAt = 0;
+            if (d->request != 0)
+                sendUplinkResponse(d);
+            else if (d->reports != 0)
+                sendUplinkReport(d);
+        }
+    }
+}
+
+// Returns how many fleet ticks will pass before a device, the channel or the
+// push and request generators have something to do (for the virtual clock)
+uint32_t getFleetIdleTicks(void)
+{
+    uint64_t now = getHostTime();
+    uint64_t next = getRadioNextEvent();
+    fleetDevice *d;
+    uint8_t i;
+
+    for (i = 0; i < fleetSize; i++)
+    {
+        d = &fleet[i];
+        if (d->nextReport != 0 && d->nextReport < next)
+            next = d->nextReport;
+        if (d->accessAt != 0 && d->accessAt < next)
+            next = d->accessAt;
+        if (d->uplinkAt != 0 && d->uplinkAt < next)
+            next = d->uplinkAt;
+    }
+    if (fleetPushUs != 0 && fleetNextPush < next)
+        next = fleetNextPush;
+    if (fleetDevCapsUs != 0 && fleetNextDevCaps < next)
+        next = fleetNextDevCaps;
+    if (fleetEnd < next)
+        next = fleetEnd;
+    if (next <= now + FLEET_TICK_US)
+        return 0;
+    if ((next - now) / FLEET_TICK_US > UINT32_MAX)
+        return UINT32_MAX - 1;
+    return (next - now) / FLEET_TICK_US - 1;
+}
+
+// Writes the device records eepromSetGetDevInfo_BR() would have stored
+void provisionFleet(void)
+{
+    uint16_t add;
+    uint8_t i, j;
+
+    writeEeprom(NO_OF_DEV_IN_BRIDGE, fleetSize);
+    for (i = 0; i < fleetSize; i++)
+    {
+        add = DEV1_NO_START + i * DEV_RECORD_SIZE;
+        writeEeprom(add, i + 1);
+        for (j = 0; j < sizeof(fleet[i].mac); j++)
+            writeEeprom(add + 1 + j, fleet[i].mac[j]);
+        fleet[i].devNum = i + 1;
+        joinedCount++;
+    }
+}
+
+// Presses the JOIN button on one device at a time, holding the bridge's
+// button until the whole fleet has joined or given up
+void stepFleetJoin(void)
+{
+    uint64_t now = getHostTime();
+    fleetDevice *d = NULL;
+    uint8_t i;
+
+    for (i = 0; i < fleetSize && d == NULL; i++)
+        if (fleet[i].devNum == 0 && (fleet[i].joining || fleet[i].joinRequests == 0))
+            d = &fleet[i];
+    if (d != NULL && !d->joining)
+    {
+        d->joining = true;
+        d->joinStart = now;
+        setPinValue(JOIN_BUTTON, 0);
+    }
+    else if (d == NULL)
+        setPinValue(JOIN_BUTTON, 1);
+    for (i = 0; i < fleetSize; i++)
+        if (fleet[i].devNum != 0 && fleet[i].nextReport == 0)
+            fleet[i].nextReport = now + getHostRandom() % fleetUplinkUs;
+}
+
+void queueFleetPush(void)
+{
+    pushMessage msg;
+    fleetDevice *d = NULL;
+    fleetPush *p;
+    uint8_t i;
+
+    for (i = 0; i < fleetSize && d == NULL; i++)
+    {
+        fleetNextTarget = (fleetNextTarget + 1) % fleetSize;
+        if (fleet[fleetNextTarget].devNum != 0)
+            d = &fleet[fleetNextTarget];
+    }
+    if (d == NULL)
+        return;
+    memcpy(msg.topicName, "MTRSP", sizeof(msg.topicName));
+    snprintf(msg.topicMessage, sizeof(msg.topicMessage), "%u", fleetPushSeq);
+    if (queuePushMsg(&msg, d->devNum))
+    {
+        p = &fleetPushes[fleetPushSeq % MAX_TRACKED_PUSHES];
+        p->queuedAt = getHostTime();
+        p->devNum = d->devNum;
+        p->delivered = false;
+        fleetPushSeq++;
+        pushesQueued++;
+    }
+    else
+        pushesRejected++;
+}
+
+// Asks one device at a time for its capabilities, as "devCaps" does; the
+// destination is a device bit mask, so only devices 1 to 7 are asked
+void requestFleetDevCaps(void)
+{
+    uint8_t devNum = fleetNextDevCapsTarget % 7 + 1;
+    fleetNextDevCapsTarget++;
+    if (getFleetDevice(devNum) != NULL)
+    {
+        setShellDestinationDevNumber(1 << devNum);
+        sendDevCap();
+    }
+}
+
+void reportRadioFleet(void)
+{
+    static const char *slotNames[SLOT_COUNT] = {"sync", "dl", "fack", "access", "ul"};
+    double seconds = (getHostTime() - fleetStart) / 1e6;
+    double frameTime = lastSync - firstSync;
+    uint16_t kbps = getNrf24l01DataRate();
+    radioStats radio;
+    nrf24l01Stats nrf;
+    uint8_t i;
+
+    getRadioStats(&radio);
+    getNrf24l01Stats(&nrf);
+    fprintf(stderr, "radio: %u devices (%u joined), %u kbps, %.1f s\n", fleetSize, joinedCount, kbps, seconds);
+    fprintf(stderr, "  airtime: 32 byte payload %u us at %u kbps (250 kbps %u us, 2 Mbps %u us) + %u us settling\n",
+            getRadioAirtime(DATA_MAX_SIZE, kbps), kbps, getRadioAirtime(DATA_MAX_SIZE, 250),
+            getRadioAirtime(DATA_MAX_SIZE, 2000), RADIO_SETTLE_US);
+    if (superframes > 1)
+    {
+        fprintf(stderr, "  superframes: %u, %.1f ms average\n", superframes, frameTime / (superframes - 1) / 1e3);
+        fprintf(stderr, "  on air:");
+        for (i = 0; i < SLOT_COUNT; i++)
+            fprintf(stderr, " %s %.3f%%", slotNames[i], 100.0 * slotAirtime[i] / frameTime);
+        fprintf(stderr, " of superframe time\n");
+    }
+    if (uplinkSlotsOffered != 0)
+        fprintf(stderr, "  uplink slots: %u of %u carried a packet (%.1f%%)\n", uplinkSlotsUsed,
+                uplinkSlotsOffered, 100.0 * uplinkSlotsUsed / uplinkSlotsOffered);
+    fprintf(stderr, "  channel: %u packets, %u collided, %u copies heard, %u lost\n",
+            radio.packets, radio.collided, radio.delivered, radio.lost);
+    fprintf(stderr, "  bridge nrf: %u sent, %u received, %u read, %u overflowed, %u flushed\n",
+            nrf.txPackets, nrf.rxPackets, nrf.rxRead, nrf.rxOverflows, nrf.rxFlushed);
+    fprintf(stderr, "  goodput: uplink %.1f B/s (%u packets, %u reports dropped), downlink %.1f B/s (%u packets)\n",
+            uplinkBytes / seconds, uplinkPackets, reportsDropped, downlinkBytes / seconds, downlinkPackets);
+    reportLatency("uplink", &uplinkLatency);
+    fprintf(stderr, "  pushes: %u queued, %u rejected (buffer full), %u on air, %u to the addressed device, %u to others\n",
+            pushesQueued, pushesRejected, pushLatency.count, pushesToTarget, pushesToOthers);
+    reportLatency("push", &pushLatency);
+    if (fleetJoinMode)
+        fprintf(stderr, "  join: %u requests, %u failed, %.1f s average\n", joinRequests, joinFailures,
+                joinedCount ? joinTime / 1e6 / joinedCount : 0.0);
+    fprintf(stderr, "  spi1: %u transactions, %u bytes\n", nrf.transactions, nrf.bytes);
+}
+
+void __wrap_initWireless(void)
+{
+    uint8_t i;
+
+    fleetActive = getenv("NRF_DEVICES") != NULL;
+    if (fleetActive)
+    {
+        fleetSize = getFleetEnv("NRF_DEVICES", 0);
+        if (fleetSize > MAX_FLEET_DEVICES)
+            fleetSize = MAX_FLEET_DEVICES;
+        fleetJoinMode = getFleetEnv("NRF_JOIN", 0) != 0;
+        fleetUplinkUs = getFleetEnv("NRF_UPLINK_MS", 1000) * 1000;
+        fleetPushUs = getFleetEnv("NRF_PUSH_MS", 1000) * 1000;
+        fleetDevCapsUs = getFleetEnv("NRF_DEVCAPS_MS", 0) * 1000;
+        if (fleetUplinkUs == 0)
+            fleetUplinkUs = 1000000;
+        if (getenv("NRF_LOSS") != NULL)
+            setRadioLoss(strtod(getenv("NRF_LOSS"), NULL));
+        forceRadioDataRate(getFleetEnv("NRF_RATE", 0));
+
+        attachNrf24l01(readBridgeFrame);
+        attachSpi1Device(transferNrf24l01);
+        attachPinHook(SSI1FSS, selectNrf24l01);
+        attachPinHook(CE_GPIO, enableNrf24l01);
+        setPinValue(SSI1FSS, 1);
+        setRadioObserver(observeFleetFrame);
+
+        for (i = 0; i < fleetSize; i++)
+        {
+            fleet[i].node = addRadioNode(receiveFleetFrame, finishFleetFrame);
+            tuneRadioNode(fleet[i].node, 76, 1000);
+            setRadioListening(fleet[i].node, true);
+            memcpy(fleet[i].mac, fleetMac, sizeof(fleetMac));
+            fleet[i].mac[5] = i + 1;
+        }
+        if (!fleetJoinMode)
+            provisionFleet();
+        attachHostTimer(tickRadioFleet, FLEET_TICK_US, getFleetIdleTicks, NULL);
+    }
+    __real_initWireless();
+    if (fleetActive)
+    {
+        fleetStart = getHostTime();
+        fleetEnd = fleetStart + (uint64_t)getFleetEnv("NRF_SECONDS", 30) * 1000000;
+        fleetNextPush = fleetStart + fleetPushUs;
+        fleetNextDevCaps = fleetStart + fleetDevCapsUs;
+    }
+}
+
+void __wrap_processWireless(void)
+{
+    uint64_t now;
+
+    if (fleetActive)
+    {
+        now = getHostTime();
+        stepFleetJoin();
+        if (fleetPushUs != 0 && now >= fleetNextPush)
+        {
+            queueFleetPush();
+            fleetNextPush += fleetPushUs;
+        }
+        if (fleetDevCapsUs != 0 && now >= fleetNextDevCaps)
+        {
+            requestFleetDevCaps();
+            fleetNextDevCaps += fleetDevCapsUs;
+        }
+        if (now >= fleetEnd)
+        {
+            reportRadioFleet();
+            exit(0);
+        }
+    }
+    __real_processWireless();
+    // Charges the device number lookup and allocation that follows a JOIN REQ
+    if (joinProbeArmed)
+    {
+        joinProbeArmed = false;
+        if (sendJoinResponse_BR)
+            endStorageProbe(&joinProbe, STORAGE_JOIN);
+    }
+}
@@ -0,0 +1,97 @@
+// SPI0 Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Hardware configuration:
+// Device models attach with attachSpi0Device(); with none MISO idles high
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "spi0.h"
+#include "host.h"
+#include "busStats.h"
+
+// SCLK sits idle between bytes of the blocking path while the core waits on
+// BSY, reads DR back and returns to the caller before loading the next byte
+#define SPI0_BYTE_GAP_NS 600
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+_hostSpiDevice spi0Device = NULL;
+uint32_t spi0ByteNs = 8000;         // one byte at the baud rate, charged per transfer
+uint8_t spi0RxData = 0xFF;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void attachSpi0Device(_hostSpiDevice device)
+{
+    spi0Device = device;
+}
+
+void initSpi0(uint32_t pinMask)
+{
+}
+
+void setSpi0BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+    if (baudRate != 0)
+        spi0ByteNs = 8000000000ULL / baudRate;
+}
+
+void setSpi0Mode(uint8_t polarity, uint8_t phase)
+{
+}
+
+// Full duplex: the byte clocked back by the device is held for readSpi0Data()
+void writeSpi0Data(uint32_t data)
+{
+    chargeHostTime(spi0ByteNs + SPI0_BYTE_GAP_NS);
+    countBusBytes(BUS_SPI0, 1);
+    if (spi0Device != NULL)
+        spi0RxData = (*spi0Device)(data);
+}
+
+uint32_t readSpi0Data()
+{
+    return spi0RxData;
+}
+
+// Block transfers keep the FIFO fed, so bytes go out back to back
+void writeSpi0Block(const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+    chargeHostTime(spi0ByteNs * size);
+    countBusBytes(BUS_SPI0, size);
+    if (spi0Device != NULL)
+        for (i = 0; i < size; i++)
+            spi0RxData = (*spi0Device)(data[i]);
+}
+
+void readSpi0Block(uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+    chargeHostTime(spi0ByteNs * size);
+    countBusBytes(BUS_SPI0, size);
+    for (i = 0; i < size; i++)
+    {
+        if (spi0Device != NULL)
+            spi0RxData = (*spi0Device)(0);
+        data[i] = spi0RxData;
+    }
+}
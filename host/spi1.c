@@ -0,0 +1,74 @@
+// SPI1 Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Hardware configuration:
+// Device models attach with attachSpi1Device().  With none the bus stands in
+// for an nRF24L01+ alone on its channel: every register read returns 0x2E
+// (powered up, TX_DS set, RX FIFO empty) so transmissions complete at once
+// and nothing is ever received
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "spi1.h"
+#include "host.h"
+#include "busStats.h"
+
+#define IDLE_RADIO_STATUS 0x2E
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+_hostSpiDevice spi1Device = NULL;
+uint32_t spi1ByteNs = 8000;         // one byte at the baud rate, charged per transfer
+uint8_t spi1RxData = IDLE_RADIO_STATUS;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void attachSpi1Device(_hostSpiDevice device)
+{
+    spi1Device = device;
+}
+
+void initSpi1(uint32_t pinMask)
+{
+}
+
+void setSpi1BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+    if (baudRate != 0)
+        spi1ByteNs = 8000000000ULL / baudRate;
+}
+
+void setSpi1Mode(uint8_t polarity, uint8_t phase)
+{
+}
+
+// Full duplex: the byte clocked back by the device is held for readSpi1Data()
+void writeSpi1Data(uint32_t data)
+{
+    chargeHostTime(spi1ByteNs);
+    countBusBytes(BUS_SPI1, 1);
+    if (spi1Device != NULL)
+        spi1RxData = (*spi1Device)(data);
+}
+
+uint32_t readSpi1Data()
+{
+    return spi1RxData;
+}
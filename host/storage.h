@@ -0,0 +1,73 @@
+// Storage Model Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Timing statistics of the two EEPROM models and the probes that charge
+// them to the operations that use them.
+//
+// 24LC512 (i2cEeprom.c): every byte access is a complete I2C transaction at
+// 100 kHz, 38 bit times for a write and 48 for a random read, which the
+// CPU waits out polling the master.  A write then starts the 5 ms internal
+// write cycle; a transaction addressed to the chip before it finishes is not
+// acknowledged, so its write is lost or its read returns 0xFF.
+//
+// Internal EEPROM (eeprom.c): reads take 4 clocks and writes keep EEDONE
+// busy for the word program time.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef STORAGE_H_
+#define STORAGE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct _i2cEepromStats
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t naks;                  // accesses during a write cycle
+    uint64_t busNs;                 // bus time charged to the CPU
+    uint64_t writeCycleNs;          // internal write cycles started
+} i2cEepromStats;
+
+typedef struct _eepromStats
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint64_t busyNs;                // time charged to the CPU
+} eepromStats;
+
+typedef enum _storageOp
+{
+    STORAGE_BIND_PUT, STORAGE_BIND_GET, STORAGE_BIND_REMOVE, STORAGE_JOIN, STORAGE_OPS
+} storageOp;
+
+typedef struct _storageProbe
+{
+    uint64_t start;                 // us
+    i2cEepromStats i2c;
+    eepromStats internal;
+} storageProbe;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void getI2cEepromStats(i2cEepromStats *stats);
+void getEepromStats(eepromStats *stats);
+
+// Probes may nest; each charges its own window to op
+void startStorageProbe(storageProbe *probe);
+void endStorageProbe(storageProbe *probe, storageOp op);
+
+#endif
@@ -0,0 +1,145 @@
+// Storage Probe Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Charges EEPROM traffic and elapsed time to the operations that cause it,
+// and prints them when the run exits.
+//
+// The binding table in hashTable.c is wrapped at link time (-Wl,--wrap):
+//   bind put    mqtt_binding_table_put()
+//   bind get    mqtt_binding_table_get()
+//   bind remove mqtt_binding_table_remove()
+// Device number allocation on a JOIN REQ is charged by radioFleet.c, since
+// eepromSetGetDevInfo_BR() is called from inside wireless.c.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hashTable.h"
+#include "host.h"
+#include "storage.h"
+
+typedef struct _storageOpStats
+{
+    uint32_t calls;
+    uint64_t us;
+    uint64_t maxUs;
+    uint32_t i2cReads;
+    uint32_t i2cWrites;
+    uint32_t i2cNaks;
+    uint32_t reads;
+    uint32_t writes;
+} storageOpStats;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+storageOpStats storageOps[STORAGE_OPS];
+bool storageReportPending = false;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void __real_mqtt_binding_table_put(MQTTBinding **bindings, uint8_t bindings_count);
+MQTTBinding* __real_mqtt_binding_table_get(MQTTBinding **bindings, uint8_t bindings_count, const char *devCaps);
+bool __real_mqtt_binding_table_remove(MQTTBinding **bindings, uint8_t bindings_count, const char *devCaps);
+
+void reportStorage(void)
+{
+    static const char *opNames[STORAGE_OPS] = {"bind put", "bind get", "bind remove", "join"};
+    i2cEepromStats i2c;
+    eepromStats internal;
+    storageOpStats *s;
+    uint8_t i;
+
+    getI2cEepromStats(&i2c);
+    getEepromStats(&internal);
+    fprintf(stderr, "storage: 24lc512 %u reads, %u writes, %u naks, %.1f ms bus, %.1f ms write cycles\n",
+            i2c.reads, i2c.writes, i2c.naks, i2c.busNs / 1e6, i2c.writeCycleNs / 1e6);
+    fprintf(stderr, "  internal eeprom: %u reads, %u writes, %.3f ms busy\n",
+            internal.reads, internal.writes, internal.busyNs / 1e6);
+    for (i = 0; i < STORAGE_OPS; i++)
+    {
+        s = &storageOps[i];
+        if (s->calls != 0)
+            fprintf(stderr, "    %-11s %6u calls %9.3f ms avg %9.3f ms max, per call: 24lc512 %.1f reads %.1f writes"
+                    " %.1f naks, internal %.1f reads %.1f writes\n", opNames[i], s->calls,
+                    s->us / 1e3 / s->calls, s->maxUs / 1e3, (double)s->i2cReads / s->calls,
+                    (double)s->i2cWrites / s->calls, (double)s->i2cNaks / s->calls,
+                    (double)s->reads / s->calls, (double)s->writes / s->calls);
+    }
+}
+
+void startStorageProbe(storageProbe *probe)
+{
+    probe->start = getHostTime();
+    getI2cEepromStats(&probe->i2c);
+    getEepromStats(&probe->internal);
+}
+
+void endStorageProbe(storageProbe *probe, storageOp op)
+{
+    storageOpStats *s = &storageOps[op];
+    uint64_t us = getHostTime() - probe->start;
+    i2cEepromStats i2c;
+    eepromStats internal;
+
+    getI2cEepromStats(&i2c);
+    getEepromStats(&internal);
+    s->calls++;
+    s->us += us;
+    if (us > s->maxUs)
+        s->maxUs = us;
+    s->i2cReads += i2c.reads - probe->i2c.reads;
+    s->i2cWrites += i2c.writes - probe->i2c.writes;
+    s->i2cNaks += i2c.naks - probe->i2c.naks;
+    s->reads += internal.reads - probe->internal.reads;
+    s->writes += internal.writes - probe->internal.writes;
+    if (!storageReportPending)
+    {
+        storageReportPending = true;
+        atexit(reportStorage);
+    }
+}
+
+void __wrap_mqtt_binding_table_put(MQTTBinding **bindings, uint8_t bindings_count)
+{
+    storageProbe probe;
+    startStorageProbe(&probe);
+    __real_mqtt_binding_table_put(bindings, bindings_count);
+    endStorageProbe(&probe, STORAGE_BIND_PUT);
+}
+
+MQTTBinding* __wrap_mqtt_binding_table_get(MQTTBinding **bindings, uint8_t bindings_count, const char *devCaps)
+{
+    storageProbe probe;
+    MQTTBinding *binding;
+    startStorageProbe(&probe);
+    binding = __real_mqtt_binding_table_get(bindings, bindings_count, devCaps);
+    endStorageProbe(&probe, STORAGE_BIND_GET);
+    return binding;
+}
+
+bool __wrap_mqtt_binding_table_remove(MQTTBinding **bindings, uint8_t bindings_count, const char *devCaps)
+{
+    storageProbe probe;
+    bool removed;
+    startStorageProbe(&probe);
+    removed = __real_mqtt_binding_table_remove(bindings, bindings_count, devCaps);
+    endStorageProbe(&probe, STORAGE_BIND_REMOVE);
+    return removed;
+}
@@ -0,0 +1,97 @@
+// UART0 Library (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// Target uC:       -
+// System Clock:    -
+
+// Hardware configuration:
+// UART0 TX goes to stdout and RX comes from stdin
+// Line feeds typed on the host are delivered as carriage returns (as a
+// terminal emulator would send them) and carriage returns sent by the
+// firmware are printed as line feeds
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <poll.h>
+#include <unistd.h>
+#include "uart0.h"
+#include "host.h"
+#include "busStats.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+bool uartInputClosed = false;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initUart0(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+}
+
+void putcUart0(char c)
+{
+    markHostActivity();
+    countBusBytes(BUS_UART0, 1);
+    putchar(c == '\r' ? '\n' : c);
+}
+
+void putsUart0(char* str)
+{
+    uint8_t i = 0;
+    while (str[i] != '\0')
+        putcUart0(str[i++]);
+}
+
+void putnsUart0(char* str, uint32_t length)
+{
+    uint8_t i = 0;
+    for(i = 0; i < length; i++)
+        putcUart0(str[i]);
+}
+
+// Blocking function that returns with serial data once stdin has some
+char getcUart0(void)
+{
+    char c = 0;
+    while (!kbhitUart0())
+        spendHostTime(1000);
+    if (read(STDIN_FILENO, &c, 1) != 1)
+    {
+        uartInputClosed = true;
+        c = 0;
+    }
+    markHostActivity();
+    countBusBytes(BUS_UART0, 1);
+    return c == '\n' ? '\r' : c;
+}
+
+// Returns the status of the receive buffer
+// Called once per superloop pass, so pending interrupts are delivered and
+// idle time is skipped here
+bool kbhitUart0(void)
+{
+    struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+    idleHost();
+    if (uartInputClosed)
+        return false;
+    return poll(&fd, 1, 0) == 1 && (fd.revents & POLLIN) != 0;
+}
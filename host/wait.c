@@ -0,0 +1,28 @@
+// Wait functions (host)
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (HOST build)
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "wait.h"
+#include "host.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Busy waits on the host clock; interrupts are serviced while waiting as
+// they would be on the target
+void waitMicrosecond(uint32_t us)
+{
+    spendHostTime(us);
+}
@@ -21,6 +21,7 @@
 #include "tm4c123gh6pm.h"
 #include "gpio.h"
 #include "i2c0.h"
+#include "busStats.h"
 
 // PortB masks
 #define SDA_MASK 8
@@ -61,6 +62,7 @@ void initI2c0(void)
 // For simple devices with a single internal register
 void writeI2c0Data(uint8_t add, uint8_t data)
 {
+    countBusBytes(BUS_I2C0, 2);
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = data;
     I2C0_MICR_R = I2C_MICR_IC;
@@ -70,6 +72,7 @@ void writeI2c0Data(uint8_t add, uint8_t data)
 
 uint8_t readI2c0Data(uint8_t add)
 {
+    countBusBytes(BUS_I2C0, 2);
     I2C0_MSA_R = (add << 1) | 1; // add:r/~w=1
     I2C0_MICR_R = I2C_MICR_IC;
     I2C0_MCS_R = I2C_MCS_START |  I2C_MCS_RUN | I2C_MCS_STOP;
@@ -80,6 +83,7 @@ uint8_t readI2c0Data(uint8_t add)
 void i2cWriteMultiple(uint8_t add, uint8_t reg, const uint8_t data[], uint8_t size)
 {
     uint8_t i;
+    countBusBytes(BUS_I2C0, 2 + size);
     // send address and register
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = reg;
@@ -113,6 +117,7 @@ void i2cWriteMultiple(uint8_t add, uint8_t reg, const uint8_t data[], uint8_t si
 // For devices with multiple registers
 void writeI2c0Register(uint8_t add, uint8_t reg, uint8_t data)
 {
+    countBusBytes(BUS_I2C0, 3);
     // send address and register
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = reg;
@@ -130,6 +135,7 @@ void writeI2c0Register(uint8_t add, uint8_t reg, uint8_t data)
 void writeI2c0Registers(uint8_t add, uint8_t reg, const uint8_t data[], uint8_t size)
 {
     uint8_t i;
+    countBusBytes(BUS_I2C0, 2 + size);
     // send address and register
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = reg;
@@ -162,6 +168,7 @@ void writeI2c0Registers(uint8_t add, uint8_t reg, const uint8_t data[], uint8_t
 
 uint8_t readI2c0Register(uint8_t add, uint8_t reg)
 {
+    countBusBytes(BUS_I2C0, 4);
     // set internal register counter in device
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = reg;
@@ -180,6 +187,7 @@ uint8_t readI2c0Register(uint8_t add, uint8_t reg)
 void readI2c0Registers(uint8_t add, uint8_t reg, uint8_t data[], uint8_t size)
 {
     uint8_t i = 0;
+    countBusBytes(BUS_I2C0, 3 + size);
     // send address and register number
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = reg;
@@ -222,6 +230,7 @@ void readI2c0Registers(uint8_t add, uint8_t reg, uint8_t data[], uint8_t size)
 
 bool pollI2c0Address(uint8_t add)
 {
+    countBusBytes(BUS_I2C0, 1);
     I2C0_MSA_R = (add << 1) | 1; // add:r/~w=1
     I2C0_MICR_R = I2C_MICR_IC;
     I2C0_MCS_R = I2C_MCS_START | I2C_MCS_RUN | I2C_MCS_STOP;
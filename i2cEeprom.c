@@ -13,6 +13,8 @@
 // Device includes, defines, and assembler directives
 //-----------------------------------------------------------------------------
 #include "i2cEeprom.h"
+#include "busStats.h"
+#include "perfStats.h"
 
 //-----------------------------------------------------------------------------
 // Subroutines
@@ -20,6 +22,9 @@
 
 uint8_t i2cEepromRead(uint8_t add, uint16_t location)
 {
+    uint32_t perfStart = PERF_START();
+    uint8_t data;
+    countBusBytes(BUS_I2C0, 5);
     // set internal register counter in device
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = (location >> 8) & 0xFF;                     // High Byte
@@ -37,11 +42,15 @@ uint8_t i2cEepromRead(uint8_t add, uint16_t location)
     I2C0_MICR_R = I2C_MICR_IC;
     I2C0_MCS_R = I2C_MCS_START | I2C_MCS_RUN | I2C_MCS_STOP;    // Repeated start is needed
     while ((I2C0_MRIS_R & I2C_MRIS_RIS) == 0);
-    return I2C0_MDR_R;
+    data = I2C0_MDR_R;
+    PERF_STOP(PERF_I2C_EEPROM, perfStart);
+    return data;
 }
 
 void i2cEepromReset(uint8_t add, uint16_t location)
 {
+    countBusBytes(BUS_I2C0, 4);
+    countBusWriteCycle();
     // send address and register high byte
         I2C0_MSA_R = add << 1; // add:r/~w=0
         I2C0_MDR_R = (location >> 8) & 0xFF;                    // High Byte
@@ -65,6 +74,9 @@ void i2cEepromReset(uint8_t add, uint16_t location)
 
 void i2cEepromWrite(uint8_t add, uint16_t location, uint8_t data)
 {
+    uint32_t perfStart = PERF_START();
+    countBusBytes(BUS_I2C0, 4);
+    countBusWriteCycle();
     // send address and register high byte
     I2C0_MSA_R = add << 1; // add:r/~w=0
     I2C0_MDR_R = (location >> 8) & 0xFF;                    // High Byte
@@ -83,5 +95,6 @@ void i2cEepromWrite(uint8_t add, uint16_t location, uint8_t data)
     I2C0_MICR_R = I2C_MICR_IC;
     I2C0_MCS_R = I2C_MCS_RUN | I2C_MCS_STOP;
     while (!(I2C0_MRIS_R & I2C_MRIS_RIS));
+    PERF_STOP(PERF_I2C_EEPROM, perfStart);
 }
 
@@ -26,7 +26,7 @@
 
 #include <stdint.h>
 
-#include "tm4c123gh6pm.h"
+#include "hal.h"
 #include "wait.h"
 #include "i2c0.h"
 //-----------------------------------------------------------------------------
@@ -17,6 +17,7 @@
 //-----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <string.h>
 #include "ip.h"
 
 // ------------------------------------------------------------------------------
@@ -42,16 +43,15 @@ uint8_t ipMqttBrokerAddress[IP_ADD_LENGTH] = {0,0,0,0};
 bool isIp(etherHeader *ether)
 {
     ipHeader *ip = (ipHeader*)ether->data;
-    uint8_t ipHeaderLength = ip->size * 4;
+    return (ether->frameType == htons(TYPE_IP)) && isIpHeaderValid(ip);
+}
+
+// Determines whether the header checksum of a received datagram is intact
+bool isIpHeaderValid(ipHeader *ip)
+{
     uint32_t sum = 0;
-    bool ok;
-    ok = (ether->frameType == htons(TYPE_IP));
-    if (ok)
-    {
-        sumIpWords(ip, ipHeaderLength, &sum);
-        ok = (getIpChecksum(sum) == 0);
-    }
-    return ok;
+    sumIpWords(ip, ip->size * 4, &sum);
+    return getIpChecksum(sum) == 0;
 }
 
 // Determines whether packet is unicast to this ip
@@ -174,24 +174,66 @@ void getIpMqttBrokerAddress(uint8_t ip[4])
 
 // Calculate sum of words
 // Must use getEtherChecksum to complete 1's compliment addition
+// Adds the data as little endian 16-bit words (the first byte low), which
+// folds to the same checksum bytes as summing it in network order
+// Works a 32-bit word at a time: a word is two 16-bit words, as 2^16 = 1 in
+// 1's compliment arithmetic, and the 64-bit accumulator keeps the carries
+// (an add with carry per word on the M4)
+// Data starting at an odd address is summed from the even address below
+// it, which swaps the bytes of the result
+// Words are loaded with memcpy since the frames are byte buffers
 void sumIpWords(void* data, uint16_t sizeInBytes, uint32_t* sum)
 {
-    uint8_t* pData = (uint8_t*)data;
-    uint16_t i;
-    uint8_t phase = 0;
-    uint16_t data_temp;
-    for (i = 0; i < sizeInBytes; i++)
+    const uint8_t* pData = (const uint8_t*)data;
+    uint64_t acc = 0;
+    uint32_t words[4];
+    uint16_t half;
+    bool odd = ((uintptr_t)pData & 1) != 0;
+
+    if (odd && sizeInBytes > 0)
     {
-        if (phase)
-        {
-            data_temp = *pData;
-            *sum += data_temp << 8;
-        }
-        else
-          *sum += *pData;
-        phase = 1 - phase;
-        pData++;
+        acc = *pData++ << 8;
+        sizeInBytes--;
     }
+    if (((uintptr_t)pData & 2) != 0 && sizeInBytes >= 2)
+    {
+        memcpy(&half, pData, sizeof(half));
+        acc += half;
+        pData += 2;
+        sizeInBytes -= 2;
+    }
+    while (sizeInBytes >= 16)
+    {
+        memcpy(words, pData, sizeof(words));
+        acc += words[0];
+        acc += words[1];
+        acc += words[2];
+        acc += words[3];
+        pData += 16;
+        sizeInBytes -= 16;
+    }
+    while (sizeInBytes >= 4)
+    {
+        memcpy(words, pData, sizeof(words[0]));
+        acc += words[0];
+        pData += 4;
+        sizeInBytes -= 4;
+    }
+    if (sizeInBytes >= 2)
+    {
+        memcpy(&half, pData, sizeof(half));
+        acc += half;
+        pData += 2;
+        sizeInBytes -= 2;
+    }
+    if (sizeInBytes > 0)
+        acc += *pData;
+
+    while ((acc >> 16) > 0)
+        acc = (acc & 0xFFFF) + (acc >> 16);
+    if (odd)
+        acc = ((acc & 0xFF) << 8) | (acc >> 8);
+    *sum += (uint32_t)acc;
 }
 
 // Completes 1's compliment addition by folding carries back into field
@@ -205,6 +247,16 @@ uint16_t getIpChecksum(uint32_t sum)
     return ~result;
 }
 
+// Adds the TCP/UDP pseudo-header: both addresses, the protocol and the
+// length of the segment
+void sumIpPseudoHeader(ipHeader* ip, uint16_t length, uint32_t* sum)
+{
+    uint16_t tmp16 = htons(length);
+    sumIpWords(ip->sourceIp, 8, sum);
+    *sum += (ip->protocol & 0xff) << 8;
+    sumIpWords(&tmp16, 2, sum);
+}
+
 void calcIpChecksum(ipHeader* ip)
 {
     // 32-bit sum over ip header
@@ -49,6 +49,17 @@ typedef struct _ipHeader // 20 or more bytes
 #define PROTOCOL_UDP  17
 
 // UDP/TCP socket
+// Ethernet, IP and TCP headers of a segment without options
+#define SOCKET_HEADER_SIZE 54
+// Runs of received data a socket holds back beyond a gap
+#define SOCKET_RX_RANGES   4
+
+typedef struct _socketRange
+{
+    uint16_t start;             // from the socket's rxBase
+    uint16_t end;
+} socketRange;
+
 typedef struct _socket
 {
     uint8_t remoteIpAddress[4];
@@ -59,6 +70,48 @@ typedef struct _socket
     uint32_t acknowledgementNumber;
     uint16_t id;
     uint8_t state;
+    // send side: acknowledgementNumber is the next sequence number to send,
+    // unacknowledged the oldest one the peer hasn't acknowledged, and window
+    // the most the peer will take beyond it (see processTcpQueue)
+    uint32_t unacknowledged;
+    uint16_t window;
+    // the socket's segments in the send buffer, oldest and newest as their
+    // number + 1 (0 for none), and the bytes they hold
+    uint8_t txFirst;
+    uint8_t txLast;
+    uint8_t txCount;
+    uint16_t txQueued;
+    // round trip time in ms, smoothed (scaled by 8) and its variation
+    // (scaled by 4), and the retransmission timeout they give
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint16_t rto;
+    uint16_t retransmissions;
+    // window probes sent while the peer's window holds back the oldest
+    // segment, and the time in ms of the last (see processTcpQueue); 0 while
+    // the socket has data in flight
+    uint8_t persists;
+    uint32_t persistTime;
+    // receive side: data segments not yet acknowledged, and the time in ms
+    // the first of them arrived (see processTcpAcks)
+    uint8_t ackPending;
+    uint32_t ackTime;
+    // data received beyond a gap, in hold back buffer rxBuffer - 1 (0 for
+    // none) from sequence number rxBase, as the runs rxRanges (see
+    // holdTcpData)
+    uint8_t rxBuffer;
+    uint8_t rxRangeCount;
+    uint32_t rxBase;
+    socketRange rxRanges[SOCKET_RX_RANGES];
+    // number + 1 of the next socket in the same bucket of the TCP socket
+    // table, 0 for none (see addTcpSocket)
+    uint8_t tableNext;
+    // headers every TCP segment of the socket starts with, and the sums of
+    // their fixed fields (see setTcpHeaderTemplate)
+    bool headerValid;
+    uint16_t ipHeaderSum;
+    uint16_t tcpHeaderSum;
+    uint8_t header[SOCKET_HEADER_SIZE];
 } socket;
 
 //-----------------------------------------------------------------------------
@@ -66,6 +119,7 @@ typedef struct _socket
 //-----------------------------------------------------------------------------
 
 bool isIp(etherHeader *ether);
+bool isIpHeaderValid(ipHeader *ip);
 bool isIpUnicast(etherHeader *ether);
 bool isIpValid();
 
@@ -83,6 +137,7 @@ void setIpMqttBrokerAddress(const uint8_t ip[4]);
 void getIpMqttBrokerAddress(uint8_t ip[4]);
 
 void sumIpWords(void* data, uint16_t sizeInBytes, uint32_t* sum);
+void sumIpPseudoHeader(ipHeader* ip, uint16_t length, uint32_t* sum);
 void calcIpChecksum(ipHeader* ip);
 uint16_t getIpChecksum(uint32_t sum);
 
@@ -19,13 +19,22 @@
 #include <stdio.h>
 #include <string.h>
 #include "mqtt.h"
+#include "uart0.h"
 #include "timer.h"
+#include "perfStats.h"
 
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
 
 uint8_t mqttBrokerSocketIndex = 0;
+// Packet buffers the readers borrow for a packet cut across segments
+mqttReader *mqttRxOwners[MQTT_RX_BUFFERS];
+uint8_t mqttRxPackets[MQTT_RX_BUFFERS][MQTT_RX_PACKET_SIZE];
+// Packets the readers skipped (too long to keep, or not MQTT), and the
+// times a reader left the rest of a segment unread waiting for a buffer
+uint32_t mqttRxSkipped = 0;
+uint32_t mqttRxWaits = 0;
 
 // ------------------------------------------------------------------------------
 //  Structures
@@ -35,52 +44,16 @@ uint8_t mqttBrokerSocketIndex = 0;
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void mqttConnect(etherHeader *ether, socket s, uint8_t flags, char *data[], uint8_t nargs)
+void mqttConnect(etherHeader *ether, socket *s, uint8_t flags, char *data[], uint8_t nargs)
 {
     uint8_t i;
-    uint32_t sum;
-    uint16_t tcpLength;
 
-    uint8_t localHwAddress[6];
-    uint8_t localIpAddress[4];
 
-    // Ether frame
-    getEtherMacAddress(localHwAddress);
-    getIpAddress(localIpAddress);
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i] = s.remoteHwAddress[i];
-        ether->sourceAddress[i] = localHwAddress[i];
-    }
-    ether->frameType = htons(TYPE_IP);
-
-    // IP header
-    ipHeader* ip = (ipHeader*)ether->data;
-    
-    ip->rev = 0x4;
-    ip->size = 0x5;
-    ip->typeOfService = 0;
-    ip->id = 0;
-    ip->flagsAndOffset = 0;
-    ip->ttl = 128;
-    ip->protocol = PROTOCOL_TCP;
-    ip->headerChecksum = 0;
-     for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i] = s.remoteIpAddress[i];
-        ip->sourceIp[i] = localIpAddress[i];
-    }
-    uint8_t ipHeaderLength = ip->size * 4;
-
-    // TCP header
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
-    tcp->sourcePort = htons(s.localPort);
-    tcp->destPort = htons(s.remotePort);
-    tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-    tcp->acknowledgementNumber = htonl(s.sequenceNumber);   
+    // Ether, IP and TCP headers from the socket's template
+    tcpHeader* tcp = startTcpSegment(ether, s);
+    tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+    tcp->acknowledgementNumber = htonl(s->sequenceNumber);
     tcp->offsetFields = htons(PSH | ACK | 0x5000);
-    tcp->windowSize = htons(1500);
-    tcp->urgentPointer = 0;
 
     // MQTT Packet
     uint16_t mqttLength = 0;
@@ -122,16 +95,8 @@ void mqttConnect(etherHeader *ether, socket s, uint8_t flags, char *data[], uint
     mqttRemainingLength[0] |= (mqttLength & 0x7F);
     // mqttRemainingLength[1] = (mqttLength >> 7) & 0x7F;
 
-    s.acknowledgementNumber += mqttLength;
-    tcpLength = sizeof(tcpHeader) + mqttLength;
-    ip->length = htons(ipHeaderLength + tcpLength);
-
-    // 32-bit sum over ip header
-    calcIpChecksum(ip);
-    // 32-bit sum over TCP header
-    calcTcpChecksum(ip, tcpLength);
     // send packet with size = ether + ip header + TCP header + MQTT packet
-    putEtherPacket(ether, sizeof(etherHeader) + ipHeaderLength + tcpLength);
+    sendTcpSegment(ether, s, mqttLength);
 }
 
 uint16_t getArgumentLength(char *str)
@@ -142,52 +107,16 @@ uint16_t getArgumentLength(char *str)
     return size;
 }
 
-void mqttSubscribe(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_t nargs)
+void mqttSubscribe(etherHeader *ether, socket *s, uint8_t QoS, char *data[], uint8_t nargs)
 {
     uint8_t i;
-    uint32_t sum;
-    uint16_t tcpLength;
-    uint8_t localHwAddress[6];
-    uint8_t localIpAddress[4];
     uint16_t topicLength;
 
-    // Ether frame
-    getEtherMacAddress(localHwAddress);
-    getIpAddress(localIpAddress);
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i] = s.remoteHwAddress[i];
-        ether->sourceAddress[i] = localHwAddress[i];
-    }
-    ether->frameType = htons(TYPE_IP);
-
-    // IP header
-    ipHeader* ip = (ipHeader*)ether->data;
-    
-    ip->rev = 0x4;
-    ip->size = 0x5;
-    ip->typeOfService = 0;
-    ip->id = 0;
-    ip->flagsAndOffset = 0;
-    ip->ttl = 128;
-    ip->protocol = PROTOCOL_TCP;
-    ip->headerChecksum = 0;
-     for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i] = s.remoteIpAddress[i];
-        ip->sourceIp[i] = localIpAddress[i];
-    }
-    uint8_t ipHeaderLength = ip->size * 4;
-
-    // TCP header
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
-    tcp->sourcePort = htons(s.localPort);
-    tcp->destPort = htons(s.remotePort);
-    tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-    tcp->acknowledgementNumber = htonl(s.sequenceNumber);   
+    // Ether, IP and TCP headers from the socket's template
+    tcpHeader* tcp = startTcpSegment(ether, s);
+    tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+    tcp->acknowledgementNumber = htonl(s->sequenceNumber);
     tcp->offsetFields = htons(PSH | ACK | 0x5000);
-    tcp->windowSize = htons(1500);
-    tcp->urgentPointer = 0;
     
 
     uint16_t mqttLength = 0;
@@ -199,8 +128,8 @@ void mqttSubscribe(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint
     mqtt[mqttLength++] = 0x00;
 
 
-    mqtt[mqttLength++] = ((s.localPort & 0xF) >> 8) & 0xFF;
-    mqtt[mqttLength++] = (s.localPort & 0xF) & 0xFF;
+    mqtt[mqttLength++] = ((s->localPort & 0xF) >> 8) & 0xFF;
+    mqtt[mqttLength++] = (s->localPort & 0xF) & 0xFF;
 
     uint16_t argumentLength = 0;
     uint8_t argumentIndex = 0;
@@ -220,64 +149,20 @@ void mqttSubscribe(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint
         mqttRemainingLength[0] |= 0x80;
     mqttRemainingLength[0] |= (mqttLength & 0x7F);
     mqttRemainingLength[1] = (mqttLength >> 7) & 0x7F;
-    s.acknowledgementNumber += mqttLength;
-    tcpLength = sizeof(tcpHeader) + mqttLength;
-    ip->length = htons(ipHeaderLength + tcpLength);
-
-    // 32-bit sum over ip header
-    calcIpChecksum(ip);
-    // 32-bit sum over TCP header
-    calcTcpChecksum(ip, tcpLength);
     // send packet with size = ether + ip header + TCP header + MQTT packet
-    putEtherPacket(ether, sizeof(etherHeader) + ipHeaderLength + tcpLength);
+    sendTcpSegment(ether, s, mqttLength);
 }
 
-void mqttPublish(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_t nargs)
+void mqttPublish(etherHeader *ether, socket *s, uint8_t QoS, char *data[], uint8_t nargs)
 {
     uint8_t i;
-    uint32_t sum;
-    uint16_t tcpLength;
-    uint8_t localHwAddress[6];
-    uint8_t localIpAddress[4];
     uint16_t topicLength;
 
-    // Ether frame
-    getEtherMacAddress(localHwAddress);
-    getIpAddress(localIpAddress);
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i] = s.remoteHwAddress[i];
-        ether->sourceAddress[i] = localHwAddress[i];
-    }
-    ether->frameType = htons(TYPE_IP);
-
-    // IP header
-    ipHeader* ip = (ipHeader*)ether->data;
-    
-    ip->rev = 0x4;
-    ip->size = 0x5;
-    ip->typeOfService = 0;
-    ip->id = 0;
-    ip->flagsAndOffset = 0;
-    ip->ttl = 128;
-    ip->protocol = PROTOCOL_TCP;
-    ip->headerChecksum = 0;
-     for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i] = s.remoteIpAddress[i];
-        ip->sourceIp[i] = localIpAddress[i];
-    }
-    uint8_t ipHeaderLength = ip->size * 4;
-
-    // TCP header
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
-    tcp->sourcePort = htons(s.localPort);
-    tcp->destPort = htons(s.remotePort);
-    tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-    tcp->acknowledgementNumber = htonl(s.sequenceNumber);   
+    // Ether, IP and TCP headers from the socket's template
+    tcpHeader* tcp = startTcpSegment(ether, s);
+    tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+    tcp->acknowledgementNumber = htonl(s->sequenceNumber);
     tcp->offsetFields = htons(PSH | ACK | 0x5000);
-    tcp->windowSize = htons(1500);
-    tcp->urgentPointer = 0;
     
 
 
@@ -308,64 +193,20 @@ void mqttPublish(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_
         mqttRemainingLength[0] |= 0x80;
     mqttRemainingLength[0] |= (mqttLength & 0x7F);
     mqttRemainingLength[1] = (mqttLength >> 7) & 0x7F;
-    s.acknowledgementNumber += mqttLength;
-    tcpLength = sizeof(tcpHeader) + mqttLength;
-    ip->length = htons(ipHeaderLength + tcpLength);
-
-    // 32-bit sum over ip header
-    calcIpChecksum(ip);
-    // 32-bit sum over TCP header
-    calcTcpChecksum(ip, tcpLength);
     // send packet with size = ether + ip header + TCP header + MQTT packet
-    putEtherPacket(ether, sizeof(etherHeader) + ipHeaderLength + tcpLength);
+    sendTcpSegment(ether, s, mqttLength);
 }
 
-void mqttDisconnect(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_t nargs)
+void mqttDisconnect(etherHeader *ether, socket *s, uint8_t QoS, char *data[], uint8_t nargs)
 {
         uint8_t i;
-    uint32_t sum;
-    uint16_t tcpLength;
-    uint8_t localHwAddress[6];
-    uint8_t localIpAddress[4];
     uint16_t topicLength;
 
-    // Ether frame
-    getEtherMacAddress(localHwAddress);
-    getIpAddress(localIpAddress);
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i] = s.remoteHwAddress[i];
-        ether->sourceAddress[i] = localHwAddress[i];
-    }
-    ether->frameType = htons(TYPE_IP);
-
-    // IP header
-    ipHeader* ip = (ipHeader*)ether->data;
-    
-    ip->rev = 0x4;
-    ip->size = 0x5;
-    ip->typeOfService = 0;
-    ip->id = 0;
-    ip->flagsAndOffset = 0;
-    ip->ttl = 128;
-    ip->protocol = PROTOCOL_TCP;
-    ip->headerChecksum = 0;
-     for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i] = s.remoteIpAddress[i];
-        ip->sourceIp[i] = localIpAddress[i];
-    }
-    uint8_t ipHeaderLength = ip->size * 4;
-
-    // TCP header
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
-    tcp->sourcePort = htons(s.localPort);
-    tcp->destPort = htons(s.remotePort);
-    tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-    tcp->acknowledgementNumber = htonl(s.sequenceNumber);   
+    // Ether, IP and TCP headers from the socket's template
+    tcpHeader* tcp = startTcpSegment(ether, s);
+    tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+    tcp->acknowledgementNumber = htonl(s->sequenceNumber);
     tcp->offsetFields = htons(PSH | ACK | 0x5000);
-    tcp->windowSize = htons(1500);
-    tcp->urgentPointer = 0;
     
 
 
@@ -383,64 +224,24 @@ void mqttDisconnect(etherHeader *ether, socket s, uint8_t QoS, char *data[], uin
         mqttRemainingLength[0] |= 0x80;
     mqttRemainingLength[0] |= (mqttLength & 0x7F);
     mqttRemainingLength[1] = (mqttLength >> 7) & 0x7F;
-    s.acknowledgementNumber += mqttLength;
-    tcpLength = sizeof(tcpHeader) + mqttLength;
-    ip->length = htons(ipHeaderLength + tcpLength);
-
-    // 32-bit sum over ip header
-    calcIpChecksum(ip);
-    // 32-bit sum over TCP header
-    calcTcpChecksum(ip, tcpLength);
     // send packet with size = ether + ip header + TCP header + MQTT packet
-    putEtherPacket(ether, sizeof(etherHeader) + ipHeaderLength + tcpLength);    
+    sendTcpSegment(ether, s, mqttLength);
 }
 
-void sendMqttMessage(etherHeader *ether, socket s, uint8_t controlHeader, uint8_t messageFlags, void *data, uint8_t MAX_ARGUMENT_LENGTH, uint8_t nargs)
+// Returns false if the send buffer has no room for the packet, which is
+// then not sent
+bool sendMqttMessage(etherHeader *ether, socket *s, uint8_t controlHeader, uint8_t messageFlags, void *data, uint8_t MAX_ARGUMENT_LENGTH, uint8_t nargs)
 {
     static uint16_t id = 1;
     uint8_t i;
-    uint32_t sum;
-    uint16_t tcpLength;
-    uint8_t localHwAddress[6];
-    uint8_t localIpAddress[4];
-
-    // Ether frame
-    getEtherMacAddress(localHwAddress);
-    getIpAddress(localIpAddress);
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i] = s.remoteHwAddress[i];
-        ether->sourceAddress[i] = localHwAddress[i];
-    }
-    ether->frameType = htons(TYPE_IP);
-
-    // IP header
-    ipHeader* ip = (ipHeader*)ether->data;
-    
-    ip->rev = 0x4;
-    ip->size = 0x5;
-    ip->typeOfService = 0;
-    ip->id = 0;
-    ip->flagsAndOffset = 0;
-    ip->ttl = 128;
-    ip->protocol = PROTOCOL_TCP;
-    ip->headerChecksum = 0;
-     for (i = 0; i < IP_ADD_LENGTH; i++)
-    {
-        ip->destIp[i] = s.remoteIpAddress[i];
-        ip->sourceIp[i] = localIpAddress[i];
-    }
-    uint8_t ipHeaderLength = ip->size * 4;
+    bool sent;
+    uint32_t perfStart = PERF_START();
 
-    // TCP header
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
-    tcp->sourcePort = htons(s.localPort);
-    tcp->destPort = htons(s.remotePort);
-    tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-    tcp->acknowledgementNumber = htonl(s.sequenceNumber);   
+    // Ether, IP and TCP headers from the socket's template
+    tcpHeader* tcp = startTcpSegment(ether, s);
+    tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+    tcp->acknowledgementNumber = htonl(s->sequenceNumber);
     tcp->offsetFields = htons(PSH | ACK | 0x5000);
-    tcp->windowSize = htons(1500);
-    tcp->urgentPointer = 0;
 
 
     uint16_t argumentLength = 0;
@@ -514,16 +315,10 @@ void sendMqttMessage(etherHeader *ether, socket s, uint8_t controlHeader, uint8_
     mqttRemainingLength[0] |= ((mqttLength - 3) & 0x7F);
     mqttRemainingLength[1] = ((mqttLength - 3) >> 7) & 0x7F;
 
-    s.acknowledgementNumber += mqttLength;
-    tcpLength = sizeof(tcpHeader) + mqttLength;
-    ip->length = htons(ipHeaderLength + tcpLength);
-
-    // 32-bit sum over ip header
-    calcIpChecksum(ip);
-    // 32-bit sum over TCP header
-    calcTcpChecksum(ip, tcpLength);
     // send packet with size = ether + ip header + TCP header + MQTT packet
-    putEtherPacket(ether, sizeof(etherHeader) + ipHeaderLength + tcpLength);
+    sent = sendTcpSegment(ether, s, mqttLength);
+    PERF_STOP(PERF_MQTT_SEND, perfStart);
+    return sent;
 }
 
 
@@ -540,41 +335,157 @@ uint8_t getMqttFlags(uint8_t *data)
     return data[0] & 0xF0;
 }
 
-uint8_t *getMqttData(uint8_t *data)
+// Size of the fixed header a packet starts with, the control byte and 1 to
+// 4 bytes of remaining length (set in length); 0 while size bytes don't
+// hold all of it
+uint8_t getMqttHeaderSize(const uint8_t data[], uint32_t size, uint32_t *length)
 {
-    uint8_t mqttFlag = data[0] & 0xF0;
-    uint32_t msgLength = 0;
-    data++;
-    msgLength += *data & 0x7F;
-    if(*data & 0x80)
-    {
-        msgLength += (*data & 0x7F) << 7;
-        data++;
-        if(*data & 0x80)
-        {
-            data++;
-            msgLength += (*data & 0x7F) << 14;
-            if(*data & 0x80)
-            {
-                data++;
-                msgLength += *data << 21;
-            }   
-        }  
-    } 
+    uint8_t i;
 
+    *length = 0;
+    for (i = 1; i < size && i <= 4; i++)
+    {
+        *length |= (uint32_t)(data[i] & 0x7F) << (7 * (i - 1));
+        if (!(data[i] & 0x80))
+            return i + 1;
+    }
+    return 0;
+}
 
+// Variable header of a CONNACK or PUBLISH packet
+uint8_t *getMqttData(uint8_t *data)
+{
+    uint32_t msgLength;
+    uint8_t headerSize = getMqttHeaderSize(data, 5, &msgLength);
 
-    switch(mqttFlag)
+    switch(data[0] & 0xF0)
     {
         case CONNACK:
-            return &(data[msgLength - 1]);
         case PUBLISH:
-            return ++data;
+            return &data[headerSize];
         default:
             return NULL;
     }
 }
 
+// Gives the reader's packet buffer back to the pool
+void releaseMqttReader(mqttReader *r)
+{
+    if (r->buffer != 0)
+        mqttRxOwners[r->buffer - 1] = NULL;
+    r->buffer = 0;
+}
+
+void resetMqttReader(mqttReader *r)
+{
+    releaseMqttReader(r);
+    r->size = 0;
+    r->total = 0;
+    r->skip = 0;
+}
+
+// Borrows a packet buffer for the packet whose fixed header the reader has
+// read, and moves the header into it.  Returns false if none is free
+bool holdMqttPacket(mqttReader *r)
+{
+    uint8_t i;
+
+    for (i = 0; i < MQTT_RX_BUFFERS && mqttRxOwners[i] != NULL; i++);
+    if (i == MQTT_RX_BUFFERS)
+        return false;
+    mqttRxOwners[i] = r;
+    r->buffer = i + 1;
+    memcpy(mqttRxPackets[i], r->header, r->size);
+    return true;
+}
+
+// Takes the stream bytes at data up to the end of the next complete packet
+// and returns the packet, or NULL once they are all taken without one.
+// If the packet needs a buffer while every one is lent to another reader,
+// it returns NULL with bytes left at data, which the caller must leave
+// unacknowledged and read again once the peer sends them again.
+// The packet stays valid until the next call on the reader
+uint8_t* readMqttPacket(mqttReader *r, uint8_t **data, uint16_t *size)
+{
+    uint8_t headerSize;
+    uint32_t length;
+    uint32_t n;
+    uint8_t *packet;
+
+    // the packet the last call returned is done with
+    if (r->total == 0)
+        releaseMqttReader(r);
+    while (*size != 0)
+    {
+        if (r->skip != 0)
+        {
+            n = (r->skip < *size) ? r->skip : *size;
+            r->skip -= n;
+        }
+        else if (r->size == 0 && (headerSize = getMqttHeaderSize(*data, *size, &length)) != 0
+                 && headerSize + length <= *size)
+        {
+            // whole in this segment, so it is read where it is
+            packet = *data;
+            *data += headerSize + length;
+            *size -= headerSize + length;
+            return packet;
+        }
+        else if (r->total == 0)
+        {
+            // the fixed header, a byte at a time until its length is known
+            r->header[r->size++] = **data;
+            n = 1;
+            headerSize = getMqttHeaderSize(r->header, r->size, &length);
+            if (headerSize != 0 && headerSize + length > MQTT_RX_PACKET_SIZE)
+            {
+                r->skip = length;
+                r->size = 0;
+                mqttRxSkipped++;
+            }
+            else if (headerSize != 0)
+                r->total = headerSize + length;
+            else if (r->size == 5)
+            {
+                // a fifth length byte: not MQTT, so start over after it
+                r->size = 0;
+                mqttRxSkipped++;
+            }
+        }
+        else if (r->buffer == 0 && !holdMqttPacket(r))
+        {
+            mqttRxWaits++;
+            return NULL;
+        }
+        else
+        {
+            n = r->total - r->size;
+            if (n > *size)
+                n = *size;
+            memcpy(&mqttRxPackets[r->buffer - 1][r->size], *data, n);
+            r->size += n;
+        }
+        *data += n;
+        *size -= n;
+        if (r->total != 0 && r->size == r->total)
+        {
+            r->size = 0;
+            r->total = 0;
+            return mqttRxPackets[r->buffer - 1];
+        }
+    }
+    return NULL;
+}
+
+void printMqttStatus(void)
+{
+    char str[80];
+
+    snprintf(str, sizeof(str), "MQTT receive: %lu packets skipped, %lu waits for a packet buffer\n",
+             (unsigned long)mqttRxSkipped, (unsigned long)mqttRxWaits);
+    putsUart0(str);
+}
+
 uint8_t getMqttBrokerSocketIndex(void)
 {
     return mqttBrokerSocketIndex;
@@ -613,67 +524,21 @@ uint8_t getTopicIndex(char *name, topic *topics, uint8_t topicCount)
     return 0;
 }
 
+// Message of a PUBLISH packet at QoS 0
 void *getMqttMessage(uint8_t *data)
 {
     uint32_t msgLength;
-    uint16_t topicLength;
+    uint8_t headerSize = getMqttHeaderSize(data, 5, &msgLength);
+    uint16_t topicLength = (data[headerSize] << 8) + data[headerSize + 1];
 
-    
-    data++;
-    msgLength = 0;
-    msgLength += *data & 0x7F;
-    if(*data & 0x80)
-    {
-        msgLength += (*data & 0x7F) << 7;
-        data++;
-        if(*data & 0x80)
-        {
-            data++;
-            msgLength += (*data & 0x7F) << 14;
-            if(*data & 0x80)
-            {
-                data++;
-                msgLength += *data << 21;
-            }   
-        }  
-    }
-    data++;
-
-    topicLength = 0;
-    topicLength += (data[0] & 0xFF) << 8;
-    topicLength += data[1] & 0xFF;
-
-    return &(data[2 + topicLength]);
+    return &(data[headerSize + 2 + topicLength]);
 }
 
 uint16_t getMqttMessageLength(uint8_t *data)
 {
     uint32_t msgLength;
-    uint16_t topicLength;
-    
-    data++;
-    msgLength = 0;
-    msgLength += *data & 0x7F;
-    if(*data & 0x80)
-    {
-        msgLength += (*data & 0x7F) << 7;
-        data++;
-        if(*data & 0x80)
-        {
-            data++;
-            msgLength += (*data & 0x7F) << 14;
-            if(*data & 0x80)
-            {
-                data++;
-                msgLength += *data << 21;
-            }   
-        }  
-    }
-    data++;
-
-    topicLength = 0;
-    topicLength += (data[0] & 0xFF) << 8;
-    topicLength += data[1] & 0xFF;
+    uint8_t headerSize = getMqttHeaderSize(data, 5, &msgLength);
+    uint16_t topicLength = (data[headerSize] << 8) + data[headerSize + 1];
 
     return msgLength - topicLength - 2;
 }
\ No newline at end of file
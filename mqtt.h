@@ -49,6 +49,15 @@
 #define MQTT_CLEAN                  2
 #define MQTT_MAX_ARGUMENTS          5
 #define MQTT_MAX_ARGUMENT_LENGTH    80
+// Largest packet an mqttReader keeps whole; longer ones are skipped
+#ifndef MQTT_RX_PACKET_SIZE
+#define MQTT_RX_PACKET_SIZE         512
+#endif
+// Packets that may be kept at once, across all the readers; a reader that
+// finds none free leaves the stream unread for the peer to send again
+#ifndef MQTT_RX_BUFFERS
+#define MQTT_RX_BUFFERS             2
+#endif
 
 
 typedef struct _topic
@@ -56,20 +65,37 @@ typedef struct _topic
     char name[MQTT_MAX_ARGUMENT_LENGTH];
 } topic;
 
+// Packets read out of a TCP byte stream, whichever way it was cut into
+// segments: a packet a segment holds whole is used where it is, the start
+// of one the segment cuts off is kept in a packet buffer borrowed from the
+// readers' pool until the rest arrives
+typedef struct _mqttReader
+{
+    uint16_t size;              // bytes of the packet kept so far
+    uint16_t total;             // its size once the fixed header is in, else 0
+    uint32_t skip;              // bytes left of a packet too long to keep
+    uint8_t header[5];          // the fixed header, until its length is known
+    uint8_t buffer;             // packet buffer + 1, or 0 for none
+} mqttReader;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void mqttConnect(etherHeader *ether, socket s, uint8_t flags, char *data[], uint8_t nargs);
-void mqttSubscribe(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_t nargs);
-void mqttPublish(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_t nargs);
-void mqttDisconnect(etherHeader *ether, socket s, uint8_t QoS, char *data[], uint8_t nargs);
-void sendMqttMessage(etherHeader *ether, socket s, uint8_t controlHeader, uint8_t messageFlags, void *data, uint8_t MAX_ARGUMENT_LENGTH, uint8_t nargs);
+void mqttConnect(etherHeader *ether, socket *s, uint8_t flags, char *data[], uint8_t nargs);
+void mqttSubscribe(etherHeader *ether, socket *s, uint8_t QoS, char *data[], uint8_t nargs);
+void mqttPublish(etherHeader *ether, socket *s, uint8_t QoS, char *data[], uint8_t nargs);
+void mqttDisconnect(etherHeader *ether, socket *s, uint8_t QoS, char *data[], uint8_t nargs);
+bool sendMqttMessage(etherHeader *ether, socket *s, uint8_t controlHeader, uint8_t messageFlags, void *data, uint8_t MAX_ARGUMENT_LENGTH, uint8_t nargs);
 uint16_t getArgumentLength(char *str);
 
 bool isMqtt(etherHeader *ether);
 
 uint8_t getMqttFlags(uint8_t *data);
+uint8_t getMqttHeaderSize(const uint8_t data[], uint32_t size, uint32_t *length);
+void resetMqttReader(mqttReader *r);
+uint8_t* readMqttPacket(mqttReader *r, uint8_t **data, uint16_t *size);
+void printMqttStatus(void);
 
 uint8_t *getMqttData(uint8_t *data);
 
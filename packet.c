@@ -0,0 +1,119 @@
+// Packet Classifier Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL or Linux host (HOST build)
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "packet.h"
+#include "mqtt.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Classifies the size byte frame in ether and fills info; returns the type
+// Lengths in the headers are checked against the frame, so a truncated or
+// damaged datagram is PACKET_OTHER rather than read past its end
+uint8_t getPacketInfo(etherHeader *ether, uint16_t size, socket *sockets, uint8_t socketCount,
+                      packetInfo *info)
+{
+    arpPacket *arp;
+    ipHeader *ip;
+    udpHeader *udp;
+    tcpHeader *tcp;
+    uint8_t localIpAddress[4];
+    uint8_t ipHeaderLength;
+    uint16_t ipLength;
+    uint16_t transportLength;
+    uint8_t tcpHeaderLength;
+
+    info->type = PACKET_OTHER;
+    info->ip = NULL;
+    info->transport = NULL;
+    info->payload = NULL;
+    info->payloadSize = 0;
+    info->tcpFlags = 0;
+    info->socketNumber = socketCount;
+    info->mqtt = false;
+    if (size < sizeof(etherHeader))
+        return info->type;
+    size -= sizeof(etherHeader);
+    getIpAddress(localIpAddress);
+
+    if (ether->frameType == htons(TYPE_ARP))
+    {
+        arp = (arpPacket*)ether->data;
+        if (size < sizeof(arpPacket))
+            return info->type;
+        if (arp->op == htons(1) && memcmp(arp->destIp, localIpAddress, IP_ADD_LENGTH) == 0)
+            info->type = PACKET_ARP_REQUEST;
+        else if (arp->op == htons(2))
+            info->type = PACKET_ARP_RESPONSE;
+        return info->type;
+    }
+    if (ether->frameType != htons(TYPE_IP))
+        return info->type;
+
+    // IP header
+    ip = (ipHeader*)ether->data;
+    ipHeaderLength = ip->size * 4;
+    ipLength = ntohs(ip->length);
+    if (size < sizeof(ipHeader) || ipHeaderLength < sizeof(ipHeader) || ipLength < ipHeaderLength
+        || ipLength > size || !isIpHeaderValid(ip))
+        return info->type;
+    info->ip = ip;
+    if (memcmp(ip->destIp, localIpAddress, IP_ADD_LENGTH) != 0)
+        return info->type;
+    info->type = PACKET_IP;
+    info->transport = (uint8_t*)ip + ipHeaderLength;
+    transportLength = ipLength - ipHeaderLength;
+
+    switch (ip->protocol)
+    {
+        case PROTOCOL_ICMP:
+            if (transportLength < sizeof(icmpHeader))
+                break;
+            if (((icmpHeader*)info->transport)->type == 8)
+                info->type = PACKET_PING_REQUEST;
+            else if (((icmpHeader*)info->transport)->type == 0)
+                info->type = PACKET_PING_RESPONSE;
+            break;
+        case PROTOCOL_UDP:
+            udp = (udpHeader*)info->transport;
+            if (transportLength < sizeof(udpHeader) || ntohs(udp->length) < sizeof(udpHeader)
+                || ntohs(udp->length) > transportLength || !isUdpChecksumOk(ip, udp))
+                break;
+            info->type = PACKET_UDP;
+            info->payload = udp->data;
+            info->payloadSize = ntohs(udp->length) - sizeof(udpHeader);
+            break;
+        case PROTOCOL_TCP:
+            tcp = (tcpHeader*)info->transport;
+            if (transportLength < sizeof(tcpHeader))
+                break;
+            tcpHeaderLength = ((tcp->offsetFields & 0xF0) >> 4) * 4;
+            if (tcpHeaderLength < sizeof(tcpHeader) || tcpHeaderLength > transportLength
+                || !isTcpChecksumOk(ether, ip, transportLength))
+                break;
+            info->type = PACKET_TCP;
+            info->payload = (uint8_t*)tcp + tcpHeaderLength;
+            info->payloadSize = transportLength - tcpHeaderLength;
+            info->tcpFlags = ntohs(tcp->offsetFields) & 0xFF;
+            info->socketNumber = findTcpSocket(ip, tcp, sockets, socketCount);
+            info->mqtt = ntohs(tcp->sourcePort) == MQTT_PORT;
+            break;
+    }
+    return info->type;
+}
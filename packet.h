@@ -0,0 +1,65 @@
+// Packet Classifier Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL or Linux host (HOST build)
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// One pass over a received frame: locates each header once, checks the IP
+// and UDP/TCP checksums once, and leaves what the handlers in main() need
+// in a packetInfo, so they don't parse the frame again.
+//
+//     getPacketInfo(data, size, sockets, MAX_SOCKETS, &info);
+//     if (info.type == PACKET_TCP && info.socketNumber < MAX_SOCKETS)
+//         ...info.tcpFlags, info.payload, info.payloadSize...
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PACKET_H_
+#define PACKET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "eth0.h"
+#include "ip.h"
+#include "arp.h"
+#include "icmp.h"
+#include "udp.h"
+#include "tcp.h"
+
+// Packet types
+#define PACKET_OTHER         0  // not for this ip, damaged or not handled
+#define PACKET_ARP_REQUEST   1  // for this ip
+#define PACKET_ARP_RESPONSE  2
+#define PACKET_IP            3  // unicast to this ip, other protocols
+#define PACKET_PING_REQUEST  4
+#define PACKET_PING_RESPONSE 5
+#define PACKET_UDP           6
+#define PACKET_TCP           7
+
+typedef struct _packetInfo
+{
+  uint8_t type;
+  ipHeader *ip;            // set for any intact IP datagram
+  void *transport;         // icmpHeader, udpHeader or tcpHeader
+  uint8_t *payload;        // UDP or TCP data
+  uint16_t payloadSize;
+  uint16_t tcpFlags;
+  uint8_t socketNumber;    // socket a TCP segment belongs to, or socketCount
+  bool mqtt;               // TCP segment from the MQTT port
+} packetInfo;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t getPacketInfo(etherHeader *ether, uint16_t size, socket *sockets, uint8_t socketCount,
+                      packetInfo *info);
+
+#endif
@@ -0,0 +1,156 @@
+// Performance Statistics Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL or Linux host (HOST build)
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "uart0.h"
+#include "perfStats.h"
+
+// Each power of two is split into PERF_STEPS buckets, so a percentile is
+// read back to within 25%
+#define PERF_STEPS   4
+#define PERF_BUCKETS (32 * PERF_STEPS)
+
+typedef struct _perfHistogram
+{
+    uint32_t count;
+    uint64_t sum;
+    uint32_t min;
+    uint32_t max;
+    uint16_t buckets[PERF_BUCKETS];
+} perfHistogram;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+perfHistogram perfRegions[PERF_COUNT];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Starts the DWT cycle counter (TRCENA in DEMCR, then CYCCNTENA)
+void initPerfStats(void)
+{
+#ifndef HOST
+    NVIC_DBG_INT_R |= 0x01000000;
+    DWT_CYCCNT_R = 0;
+    DWT_CTRL_R |= 1;
+#endif
+    resetPerfStats();
+}
+
+uint8_t getPerfBucket(uint32_t cycles)
+{
+    uint8_t bits = 0;
+    uint32_t v = cycles;
+
+    if (cycles < PERF_STEPS)
+        return cycles;
+    if (v >> 16) { v >>= 16; bits += 16; }
+    if (v >> 8)  { v >>= 8;  bits += 8; }
+    if (v >> 4)  { v >>= 4;  bits += 4; }
+    if (v >> 2)  { v >>= 2;  bits += 2; }
+    if (v >> 1)  { bits += 1; }
+    // bits >= 2: the top bit and the two below it pick the bucket
+    return (bits - 1) * PERF_STEPS + ((cycles >> (bits - 2)) & (PERF_STEPS - 1));
+}
+
+// Largest count that falls in a bucket
+uint32_t getPerfBucketLimit(uint8_t bucket)
+{
+    uint8_t bits = bucket / PERF_STEPS + 1;
+    uint8_t step = bucket % PERF_STEPS;
+
+    if (bucket < PERF_STEPS)
+        return bucket;
+    return ((uint32_t)(PERF_STEPS + step) << (bits - 2)) + ((uint32_t)1 << (bits - 2)) - 1;
+}
+
+void addPerfSample(perfRegion region, uint32_t cycles)
+{
+    perfHistogram *h = &perfRegions[region];
+    uint8_t bucket = getPerfBucket(cycles);
+    uint8_t i;
+
+    if (h->count == 0 || cycles < h->min)
+        h->min = cycles;
+    if (cycles > h->max)
+        h->max = cycles;
+    h->count++;
+    h->sum += cycles;
+    // A full bucket halves them all, which keeps the shape of the histogram
+    if (h->buckets[bucket] == UINT16_MAX)
+        for (i = 0; i < PERF_BUCKETS; i++)
+            h->buckets[i] = (h->buckets[i] + 1) / 2;
+    h->buckets[bucket]++;
+}
+
+uint32_t getPerfPercentile(perfRegion region, uint8_t percent)
+{
+    perfHistogram *h = &perfRegions[region];
+    uint32_t total = 0;
+    uint32_t seen = 0;
+    uint32_t limit;
+    uint8_t i;
+
+    for (i = 0; i < PERF_BUCKETS; i++)
+        total += h->buckets[i];
+    if (total == 0)
+        return 0;
+    total = (total * percent + 99) / 100;
+    for (i = 0; i < PERF_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= total)
+        {
+            limit = getPerfBucketLimit(i);
+            return (limit < h->max) ? limit : h->max;
+        }
+    }
+    return h->max;
+}
+
+void resetPerfStats(void)
+{
+    memset(perfRegions, 0, sizeof(perfRegions));
+}
+
+// Prints cycles per region; the shell region only takes its sample once
+// the command returns, so printing doesn't change the table
+void printPerfStats(void)
+{
+    static const char *regionNames[PERF_COUNT] = {"loop", "shell", "transmit", "wireless", "nrf rx",
+                                                  "eth get", "isTcp", "mqtt send", "eeprom", "i2c eeprom"};
+    perfHistogram *h;
+    char str[80];
+    uint8_t i;
+
+    putsUart0("Cycles (40 MHz)   count        min        avg        p99        max\n");
+    for (i = 0; i < PERF_COUNT; i++)
+    {
+        h = &perfRegions[i];
+        if (h->count == 0)
+            continue;
+        snprintf(str, sizeof(str), "  %-12s %8lu %10lu %10lu %10lu %10lu\n", regionNames[i],
+                 (unsigned long)h->count, (unsigned long)h->min, (unsigned long)(h->sum / h->count),
+                 (unsigned long)getPerfPercentile((perfRegion)i, 99), (unsigned long)h->max);
+        putsUart0(str);
+    }
+}
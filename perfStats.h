@@ -0,0 +1,63 @@
+// Performance Statistics Library
+// Bridge Team
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL or Linux host (HOST build)
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Cycle counts per code region, kept as a histogram so the shell can show
+// min/avg/p99/max without storing samples.  On the target the cycles come
+// from the Cortex-M4 DWT cycle counter; on the host they are the host clock
+// (clock_gettime, or the simulated clock with HOST_CLOCK=virtual) counted
+// in 40 MHz cycles, so both builds print the same units.
+//
+//     uint32_t perfStart = PERF_START();
+//     processShell();
+//     PERF_STOP(PERF_SHELL, perfStart);
+//
+// Regions nest; each one counts everything that runs inside it, including
+// interrupt handlers.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PERFSTATS_H_
+#define PERFSTATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef HOST
+#include "host.h"
+#define PERF_CYCLES() ((uint32_t)(getHostTimeNs() / 25))
+#else
+#define DWT_CTRL_R              (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT_R            (*((volatile uint32_t *)0xE0001004))
+#define PERF_CYCLES() (DWT_CYCCNT_R)
+#endif
+
+#define PERF_START()             PERF_CYCLES()
+#define PERF_STOP(region, start) addPerfSample(region, PERF_CYCLES() - (start))
+
+typedef enum _perfRegion
+{
+    PERF_LOOP, PERF_SHELL, PERF_TRANSMISSION, PERF_WIRELESS, PERF_NRF_RX, PERF_ETH_GET, PERF_IS_TCP,
+    PERF_MQTT_SEND, PERF_EEPROM, PERF_I2C_EEPROM, PERF_COUNT
+} perfRegion;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initPerfStats(void);
+void addPerfSample(perfRegion region, uint32_t cycles);
+uint32_t getPerfPercentile(perfRegion region, uint8_t percent);
+void resetPerfStats(void);
+void printPerfStats(void);
+
+#endif
@@ -25,6 +25,7 @@
 #include "tm4c123gh6pm.h"
 #include "gpio.h"
 #include "spi0.h"
+#include "busStats.h"
 
 // Pins
 #define SSI0TX PORTA,5
@@ -95,6 +96,7 @@ void setSpi0Mode(uint8_t polarity, uint8_t phase)
 void writeSpi0Data(uint32_t data)
 {
     SSI0_DR_R = data;
+    countBusBytes(BUS_SPI0, 1);
     while (SSI0_SR_R & SSI_SR_BSY);
 }
 
@@ -103,3 +105,39 @@ uint32_t readSpi0Data()
 {
     return SSI0_DR_R;
 }
+
+// Streams a block out through the FIFOs, keeping SCLK running between bytes;
+// no more than 8 bytes are in flight so the rx FIFO can't overrun, and the
+// bytes clocked back are discarded
+void writeSpi0Block(const uint8_t data[], uint16_t size)
+{
+    uint16_t tx = 0, rx = 0;
+    while (rx < size)
+    {
+        if (tx < size && (uint16_t)(tx - rx) < 8 && (SSI0_SR_R & SSI_SR_TNF))
+            SSI0_DR_R = data[tx++];
+        if (SSI0_SR_R & SSI_SR_RNE)
+        {
+            (void)SSI0_DR_R;
+            rx++;
+        }
+    }
+    countBusBytes(BUS_SPI0, size);
+}
+
+// Streams a block in through the FIFOs, clocking out zeros
+void readSpi0Block(uint8_t data[], uint16_t size)
+{
+    uint16_t tx = 0, rx = 0;
+    while (rx < size)
+    {
+        if (tx < size && (uint16_t)(tx - rx) < 8 && (SSI0_SR_R & SSI_SR_TNF))
+        {
+            SSI0_DR_R = 0;
+            tx++;
+        }
+        if (SSI0_SR_R & SSI_SR_RNE)
+            data[rx++] = SSI0_DR_R;
+    }
+    countBusBytes(BUS_SPI0, size);
+}
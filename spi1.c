@@ -24,6 +24,7 @@
 #include <stdbool.h>
 #include "tm4c123gh6pm.h"
 #include "spi1.h"
+#include "busStats.h"
 #include "gpio.h"
 
 
@@ -97,6 +98,7 @@ void setSpi1Mode(uint8_t polarity, uint8_t phase)
 void writeSpi1Data(uint32_t data)
 {
     SSI1_DR_R = data;
+    countBusBytes(BUS_SPI1, 1);
     while (SSI1_SR_R & SSI_SR_BSY);
 }
 
@@ -22,12 +22,38 @@
 #include <stdbool.h>
 #include "tcp.h"
 #include "timer.h"
+#include "uart0.h"
+#include "perfStats.h"
 
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
 
+// Segments waiting for the peer's acknowledgement.  Each socket chains its
+// own, oldest first, from txFirst, and their data goes wherever tcpTxData
+// has room, so a socket whose peer stops acknowledging only holds up its
+// own sends
+tcpTxSegment tcpTxSegments[TCP_TX_SEGMENTS];
+uint8_t tcpTxCount = 0;
+uint8_t tcpTxData[TCP_TX_BUFFER_SIZE];
 
+// First socket of each bucket, as its number + 1 (0 for none); the rest of
+// the bucket is chained through the sockets' tableNext
+uint8_t tcpSocketTable[TCP_SOCKET_TABLE_SIZE];
+
+// Buffers for data received beyond a gap, each lent to one socket until
+// the gap is filled: byte 0 of a socket's buffer is sequence number rxBase,
+// and its rxRanges are the runs of it received, in order and apart, all
+// past its sequenceNumber
+socket *tcpRxOwners[TCP_RX_BUFFERS];
+uint8_t tcpRxData[TCP_RX_BUFFERS][TCP_RX_BUFFER_SIZE];
+
+// Data the last segment received brought into sequence, for readTcpStream:
+// the segment's own, then a run of the socket's buffer it joined up with
+socket *tcpRxReader = NULL;
+uint8_t *tcpRxSegmentData;
+uint16_t tcpRxSegmentSize = 0;
+socketRange tcpRxReady;
 
 // ------------------------------------------------------------------------------
 //  Structures
@@ -43,126 +69,626 @@ bool isTcp(etherHeader* ether)
 {
     ipHeader *ip = (ipHeader*)ether->data;
     uint8_t ipHeaderLength = ip->size * 4;
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + ipHeaderLength);
+    return (ip->protocol == PROTOCOL_TCP)
+           && isTcpChecksumOk(ether, ip, ntohs(ip->length) - ipHeaderLength);
+}
+
+// Determines whether the checksum of a received segment is intact
+bool isTcpChecksumOk(etherHeader *ether, ipHeader *ip, uint16_t tcpLength)
+{
+    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
     uint32_t sum = 0;
-    bool ok;
-    uint16_t tmp16;
-    ok = (ip->protocol == PROTOCOL_TCP);
-    if (ok)
+    bool ok = true;
+    uint32_t perfStart = PERF_START();
+    // the checksum offload may already have checked it in the ENC28J60
+    if (!isEtherTcpChecksumVerified(ether))
     {
         // 32-bit sum over pseudo-header
-        sumIpWords(ip->sourceIp, 8, &sum);
-        tmp16 = ip->protocol;
-        sum += (tmp16 & 0xff) << 8;
-        tmp16 = htons(ntohs(ip->length) - (ip->size * 4));
-        sumIpWords(&tmp16, 2, &sum);
+        sumIpPseudoHeader(ip, tcpLength, &sum);
         // add tcp header and data
-        sumIpWords(tcp, ntohs(ip->length) - (ip->size * 4), &sum);
+        sumIpWords(tcp, tcpLength, &sum);
         ok = (getIpChecksum(sum) == 0);
     }
 
+    PERF_STOP(PERF_IS_TCP, perfStart);
     return ok;
 }
 
 
-void sendTcpMessage(etherHeader *ether, socket s, uint32_t flags, uint8_t data[], uint16_t dataSize)
+// Builds the headers every segment of the socket starts with: addresses,
+// ports and the fixed IP fields, with the length, id, sequence numbers,
+// flags and checksums left zero.  The 1's compliment sums of the fixed
+// fields are kept with it, so a send only adds in what it changes
+void setTcpHeaderTemplate(socket *s)
 {
-    uint8_t i;
+    etherHeader *ether = (etherHeader*)s->header;
+    ipHeader *ip = (ipHeader*)ether->data;
+    tcpHeader *tcp = (tcpHeader*)ip->data;
     uint32_t sum;
-    uint16_t tmp16;
-    uint16_t tcpLength;
-    uint8_t *copyData;
-    uint8_t localHwAddress[6];
-    uint8_t localIpAddress[4];
 
-    // Ether frame
-    getEtherMacAddress(localHwAddress);
-    getIpAddress(localIpAddress);
-    for (i = 0; i < HW_ADD_LENGTH; i++)
-    {
-        ether->destAddress[i] = s.remoteHwAddress[i];
-        ether->sourceAddress[i] = localHwAddress[i];
-    }
+    memset(s->header, 0, sizeof(s->header));
+    memcpy(ether->destAddress, s->remoteHwAddress, HW_ADD_LENGTH);
+    getEtherMacAddress(ether->sourceAddress);
     ether->frameType = htons(TYPE_IP);
 
-    // IP header
-    ipHeader* ip = (ipHeader*)ether->data;
-    
     ip->rev = 0x4;
     ip->size = 0x5;
-    ip->typeOfService = 0;
-    ip->id = 0;
-    ip->flagsAndOffset = 0;
     ip->ttl = 128;
     ip->protocol = PROTOCOL_TCP;
-    ip->headerChecksum = 0;
-     for (i = 0; i < IP_ADD_LENGTH; i++)
+    getIpAddress(ip->sourceIp);
+    memcpy(ip->destIp, s->remoteIpAddress, IP_ADD_LENGTH);
+
+    tcp->sourcePort = htons(s->localPort);
+    tcp->destPort = htons(s->remotePort);
+    tcp->windowSize = htons(TCP_RX_BUFFER_SIZE);
+
+    sum = 0;
+    sumIpWords(ip, sizeof(ipHeader), &sum);
+    s->ipHeaderSum = ~getIpChecksum(sum);
+    // pseudo-header without the length, and the fixed tcp fields
+    sum = 0;
+    sumIpWords(ip->sourceIp, 8, &sum);
+    sum += PROTOCOL_TCP << 8;
+    sumIpWords(tcp, sizeof(tcpHeader), &sum);
+    s->tcpHeaderSum = ~getIpChecksum(sum);
+    s->headerValid = true;
+}
+
+// Copies the socket's headers into the frame and returns the tcp header for
+// the caller to fill in the sequence numbers, flags and data
+tcpHeader* startTcpSegment(etherHeader *ether, socket *s)
+{
+    if (!s->headerValid)
+        setTcpHeaderTemplate(s);
+    memcpy(ether, s->header, SOCKET_HEADER_SIZE);
+    return (tcpHeader*)((ipHeader*)ether->data)->data;
+}
+
+// Sets the lengths and id of a segment started with startTcpSegment(),
+// finishes both checksums from the template's sums and sends it
+bool putTcpSegment(etherHeader *ether, socket *s, uint16_t dataSize)
+{
+    static uint16_t id = 0;
+    ipHeader *ip = (ipHeader*)ether->data;
+    tcpHeader *tcp = (tcpHeader*)ip->data;
+    uint16_t tcpLength = sizeof(tcpHeader) + dataSize;
+    uint16_t pseudoTcpLength = htons(tcpLength);
+    uint32_t sum;
+
+    ip->length = htons(sizeof(ipHeader) + tcpLength);
+    ip->id = htons(id++);
+    sum = s->ipHeaderSum;
+    sumIpWords(&ip->length, 4, &sum);
+    ip->headerChecksum = getIpChecksum(sum);
+
+    if (isEtherChecksumOffload(tcpLength))
+        calcTcpChecksum(ip, tcpLength);
+    else
     {
-        ip->destIp[i] = s.remoteIpAddress[i];
-        ip->sourceIp[i] = localIpAddress[i];
+        // sequence and acknowledgement numbers, offset and flags
+        sum = s->tcpHeaderSum;
+        sumIpWords(&pseudoTcpLength, 2, &sum);
+        sumIpWords(&tcp->sequenceNumber, 10, &sum);
+        sumIpWords(tcp->data, dataSize, &sum);
+        tcp->checksum = getIpChecksum(sum);
     }
-    
-    // TCP header
-    tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + (ip->size * 4));
-    tcp->sourcePort = htons(s.localPort);
-    tcp->destPort = htons(s.remotePort);
-    uint8_t ipHeaderLength = ip->size * 4;
 
-    switch(s.state)
+    // send packet with size = ether + ip header + tcp header + data size
+    if (!putEtherPacket(ether, sizeof(etherHeader) + sizeof(ipHeader) + tcpLength))
+        return false;
+    // any segment acknowledging all that was received stands for a delayed ACK
+    if ((ntohs(tcp->offsetFields) & ACK) && (int32_t)(ntohl(tcp->acknowledgementNumber) - s->sequenceNumber) >= 0)
+        s->ackPending = 0;
+    return true;
+}
+
+// Returns the size of the free run of tcpTxData at *start, first moving
+// *start past the segments in the way
+uint16_t getTcpTxRun(uint16_t *start)
+{
+    tcpTxSegment *segment;
+    uint16_t end = TCP_TX_BUFFER_SIZE;
+    bool moved = true;
+    uint8_t i;
+
+    while (moved)
+    {
+        moved = false;
+        for (i = 0; i < TCP_TX_SEGMENTS; i++)
+        {
+            segment = &tcpTxSegments[i];
+            if (segment->s != NULL && segment->offset <= *start && *start < segment->offset + segment->size)
+            {
+                *start = segment->offset + segment->size;
+                moved = true;
+            }
+        }
+    }
+    for (i = 0; i < TCP_TX_SEGMENTS; i++)
+    {
+        segment = &tcpTxSegments[i];
+        if (segment->s != NULL && segment->size != 0 && segment->offset >= *start && segment->offset < end)
+            end = segment->offset;
+    }
+    return end - *start;
+}
+
+// Returns the offset in tcpTxData of the first run of size free bytes, or
+// TCP_TX_BUFFER_SIZE if there is none
+uint16_t allocTcpTxData(uint16_t size)
+{
+    uint16_t start = 0;
+    uint16_t run;
+
+    while (start < TCP_TX_BUFFER_SIZE)
+    {
+        run = getTcpTxRun(&start);
+        if (run >= size)
+            return start;
+        start += run;
+    }
+    return TCP_TX_BUFFER_SIZE;
+}
+
+// Returns the largest segment the send buffer can take now from the socket,
+// which is held to its share, TCP_TX_SOCKET_SIZE bytes in
+// TCP_TX_SOCKET_SEGMENTS segments
+uint16_t getTcpSendSpace(socket *s)
+{
+    uint16_t start = 0;
+    uint16_t run;
+    uint16_t space = 0;
+
+    if (tcpTxCount == TCP_TX_SEGMENTS || s->txCount == TCP_TX_SOCKET_SEGMENTS)
+        return 0;
+    while (start < TCP_TX_BUFFER_SIZE)
+    {
+        run = getTcpTxRun(&start);
+        if (run > space)
+            space = run;
+        start += run;
+    }
+    return (space < TCP_TX_SOCKET_SIZE - s->txQueued) ? space : TCP_TX_SOCKET_SIZE - s->txQueued;
+}
+
+// Takes the oldest segment off the socket's queue
+void freeTcpQueued(socket *s)
+{
+    tcpTxSegment *segment = &tcpTxSegments[s->txFirst - 1];
+
+    s->txFirst = segment->next;
+    if (s->txFirst == 0)
+    {
+        s->txLast = 0;
+        s->persists = 0;
+    }
+    s->txQueued -= segment->size;
+    s->txCount--;
+    segment->s = NULL;
+    tcpTxCount--;
+}
+
+// Sends a queued segment, with the socket's current acknowledgement
+bool sendTcpQueued(etherHeader *ether, tcpTxSegment *segment)
+{
+    tcpHeader *tcp = startTcpSegment(ether, segment->s);
+
+    tcp->sequenceNumber = htonl(segment->sequenceNumber);
+    tcp->acknowledgementNumber = (segment->flags & ACK) ? htonl(segment->s->sequenceNumber) : 0;
+    tcp->offsetFields = htons(segment->flags | 0x5000);
+    memcpy(tcp->data, &tcpTxData[segment->offset], segment->size);
+    if (!putTcpSegment(ether, segment->s, segment->size))
+        return false;
+    segment->transmissions++;
+    segment->sentTime = getUptime();
+    return true;
+}
+
+// Whether the peer's window takes all of a segment
+bool isTcpWindowOpen(tcpTxSegment *segment)
+{
+    socket *s = segment->s;
+    return segment->sequenceNumber + segment->size - s->unacknowledged <= s->window;
+}
+
+// Bytes from the start of a queued segment that the peer's window takes
+uint16_t getTcpWindowRoom(tcpTxSegment *segment)
+{
+    socket *s = segment->s;
+    int32_t room = s->unacknowledged + s->window - segment->sequenceNumber;
+
+    if (room <= 0)
+        return 0;
+    return ((uint32_t)room < segment->size) ? room : segment->size;
+}
+
+// Cuts a queued segment after size bytes, the rest becoming the next one in
+// the socket's chain, so the part the peer's window takes can go out.
+// Returns false if there is no free slot for the rest
+bool splitTcpQueued(tcpTxSegment *segment, uint16_t size)
+{
+    socket *s = segment->s;
+    tcpTxSegment *rest;
+    uint8_t i;
+
+    if (tcpTxCount == TCP_TX_SEGMENTS)
+        return false;
+    for (i = 0; tcpTxSegments[i].s != NULL; i++)
+        ;
+    rest = &tcpTxSegments[i];
+    *rest = *segment;
+    rest->sequenceNumber += size;
+    rest->offset += size;
+    rest->size -= size;
+    segment->size = size;
+    segment->next = i + 1;
+    if (s->txLast == segment - tcpTxSegments + 1)
+        s->txLast = i + 1;
+    s->txCount++;
+    tcpTxCount++;
+    return true;
+}
+
+// Sends a segment with the sequence number before the oldest the peer has
+// not acknowledged and no data, which the peer answers with its window
+bool sendTcpProbe(etherHeader *ether, socket *s)
+{
+    tcpHeader *tcp = startTcpSegment(ether, s);
+
+    tcp->sequenceNumber = htonl(s->unacknowledged - 1);
+    tcp->acknowledgementNumber = htonl(s->sequenceNumber);
+    tcp->offsetFields = htons(ACK | 0x5000);
+    return putTcpSegment(ether, s, 0);
+}
+
+// Sends a segment started with startTcpSegment().  Data on an established
+// socket, and a SYN, go through the send buffer: they take the next
+// sequence numbers, go out once the peer's window has room for them, and
+// are kept until the peer acknowledges them (processTcpQueue).  Returns
+// false if the send buffer is full, and the segment is not sent
+bool sendTcpSegment(etherHeader *ether, socket *s, uint16_t dataSize)
+{
+    tcpHeader *tcp = (tcpHeader*)((ipHeader*)ether->data)->data;
+    uint16_t flags = ntohs(tcp->offsetFields) & 0x1FF;
+    tcpTxSegment *segment;
+    uint16_t offset;
+    uint8_t i;
+
+    if (!(flags & SYN) && (dataSize == 0 || s->state != TCP_ESTABLISHED))
+        return putTcpSegment(ether, s, dataSize);
+
+    if (tcpTxCount == TCP_TX_SEGMENTS || getTcpSendSpace(s) < dataSize)
+        return false;
+    offset = allocTcpTxData(dataSize);
+    for (i = 0; tcpTxSegments[i].s != NULL; i++)
+        ;
+    segment = &tcpTxSegments[i];
+    segment->s = s;
+    segment->sequenceNumber = s->acknowledgementNumber;
+    segment->offset = offset;
+    segment->size = dataSize;
+    segment->flags = flags;
+    segment->transmissions = 0;
+    segment->next = 0;
+    memcpy(&tcpTxData[offset], tcp->data, dataSize);
+    tcpTxCount++;
+    if (s->txLast != 0)
+        tcpTxSegments[s->txLast - 1].next = i + 1;
+    else
+        s->txFirst = i + 1;
+    s->txLast = i + 1;
+    s->txQueued += dataSize;
+    s->txCount++;
+    // a SYN takes a sequence number of its own
+    s->acknowledgementNumber += dataSize + ((flags & SYN) ? 1 : 0);
+
+    if (isTcpWindowOpen(segment))
+    {
+        tcp->sequenceNumber = htonl(segment->sequenceNumber);
+        if (putTcpSegment(ether, s, dataSize))
+        {
+            segment->transmissions = 1;
+            segment->sentTime = getUptime();
+        }
+    }
+    return true;
+}
+
+// Takes a round trip time sample into the socket's estimate, Jacobson and
+// Karels' smoothed mean and mean deviation kept in fixed point, and sets
+// the retransmission timeout from it
+void sampleTcpRtt(socket *s, uint32_t rtt)
+{
+    int32_t delta;
+    uint32_t rto;
+
+    // a round trip under the 1 ms tick still took time, and a zero estimate
+    // means no sample yet
+    if (rtt == 0)
+        rtt = 1;
+    if (s->srtt == 0 && s->rttvar == 0)
+    {
+        s->srtt = rtt << 3;
+        s->rttvar = rtt << 1;
+    }
+    else
+    {
+        // srtt += (rtt - srtt) / 8, rttvar += (|rtt - srtt| - rttvar) / 4
+        delta = (int32_t)rtt - (int32_t)(s->srtt >> 3);
+        s->srtt += delta;
+        if (delta < 0)
+            delta = -delta;
+        s->rttvar += delta - (s->rttvar >> 2);
+    }
+    // srtt + 4 * rttvar, at least the 1 ms of the clock for the variation
+    rto = (s->srtt >> 3) + ((s->rttvar != 0) ? s->rttvar : 1);
+    if (rto < TCP_RTO_MIN)
+        rto = TCP_RTO_MIN;
+    if (rto > TCP_RTO_MAX)
+        rto = TCP_RTO_MAX;
+    s->rto = rto;
+}
+
+// Releases the segments of the socket that ack covers, timing the newest of
+// them.  Karn's rule: the acknowledgement of a segment sent more than once
+// can't be told from that of the first transmission, so only segments sent
+// once are timed
+void ackTcpQueue(socket *s, uint32_t ack)
+{
+    uint32_t now = getUptime();
+    tcpTxSegment *segment;
+    uint32_t sentTime = 0;
+    bool timed = false;
+
+    if ((int32_t)(ack - s->unacknowledged) <= 0 || (int32_t)(ack - s->acknowledgementNumber) > 0)
+        return;
+    s->unacknowledged = ack;
+    while (s->txFirst != 0)
+    {
+        segment = &tcpTxSegments[s->txFirst - 1];
+        if ((int32_t)(segment->sequenceNumber + segment->size - ack) > 0)
+            break;
+        timed = (segment->transmissions == 1);
+        sentTime = segment->sentTime;
+        freeTcpQueued(s);
+    }
+    if (timed)
+        sampleTcpRtt(s, now - sentTime);
+}
+
+// Drops every segment of a socket that is reset or closed, and the data
+// held back for it
+void clearTcpQueue(socket *s)
+{
+    while (s->txFirst != 0)
+        freeTcpQueued(s);
+    s->unacknowledged = s->acknowledgementNumber;
+    if (s->rxBuffer != 0)
+        tcpRxOwners[s->rxBuffer - 1] = NULL;
+    s->rxBuffer = 0;
+    s->rxRangeCount = 0;
+    if (tcpRxReader == s)
+        tcpRxReader = NULL;
+}
+
+// Sends every segment of the socket in flight again once the oldest has
+// timed out, since a peer that drops what arrives beyond a gap needs them
+// all, and backs the retransmission timeout off
+bool retransmitTcpSocket(etherHeader *ether, socket *s)
+{
+    tcpTxSegment *segment;
+    uint8_t n;
+
+    s->rto = (s->rto < TCP_RTO_MAX / 2) ? s->rto * 2 : TCP_RTO_MAX;
+    for (n = s->txFirst; n != 0; n = segment->next)
+    {
+        segment = &tcpTxSegments[n - 1];
+        if (segment->transmissions == 0)
+            break;
+        if (!sendTcpQueued(ether, segment))
+            return false;
+        s->retransmissions++;
+    }
+    return true;
+}
+
+// Sends the queued segments the peer's window has opened for, probes a
+// window that holds them all back, and sends again those not acknowledged
+// within the socket's retransmission timeout.
+// Returns a socket whose peer stopped acknowledging, its segments dropped,
+// for the caller to reset; otherwise NULL
+socket* processTcpQueue(etherHeader *ether)
+{
+    uint32_t now = getUptime();
+    uint32_t timeout;
+    tcpTxSegment *segment;
+    socket *s;
+    uint16_t room;
+    uint8_t i, n;
+
+    // each socket once, from the slot of its oldest segment
+    for (i = 0; i < TCP_TX_SEGMENTS; i++)
+    {
+        s = tcpTxSegments[i].s;
+        if (s == NULL || s->txFirst != i + 1)
+            continue;
+        segment = &tcpTxSegments[i];
+        // the oldest was sent first, so it is the first to time out
+        if (segment->transmissions != 0 && (int32_t)(now - segment->sentTime) >= (int32_t)s->rto)
+        {
+            if (segment->transmissions > ((segment->flags & SYN) ? TCP_MAX_SYN_RETRANSMISSIONS : TCP_MAX_RETRANSMISSIONS))
+            {
+                clearTcpQueue(s);
+                return s;
+            }
+            // a busy transmit buffer means a busy wire; try on the next pass
+            if (!retransmitTcpSocket(ether, s))
+                break;
+        }
+        for (n = s->txFirst; n != 0; n = segment->next)
+        {
+            segment = &tcpTxSegments[n - 1];
+            if (segment->transmissions != 0)
+                continue;
+            // a segment wider than the window goes out up to its edge
+            room = getTcpWindowRoom(segment);
+            if (!isTcpWindowOpen(segment) && (room == 0 || !splitTcpQueued(segment, room)))
+                break;
+            if (!sendTcpQueued(ether, segment))
+                return NULL;
+        }
+
+        // with nothing in flight, only the peer's window update would start
+        // the socket again; it may be lost, so the window is probed after
+        // the rto, backing off like it up to TCP_RTO_MAX
+        segment = &tcpTxSegments[s->txFirst - 1];
+        if (segment->transmissions != 0)
+            s->persists = 0;
+        else if (s->persists == 0)
+        {
+            s->persists = 1;
+            s->persistTime = now;
+        }
+        else
+        {
+            timeout = s->rto;
+            for (n = 1; n < s->persists && timeout < TCP_RTO_MAX; n++)
+                timeout *= 2;
+            if ((int32_t)(now - s->persistTime) < (int32_t)timeout)
+                continue;
+            if (!sendTcpProbe(ether, s))
+                return NULL;
+            if (timeout < TCP_RTO_MAX)
+                s->persists++;
+            s->persistTime = now;
+        }
+    }
+    return NULL;
+}
+
+// Sends a bare ACK for each established socket whose received data has
+// waited long enough for a segment of ours to carry the acknowledgement
+void processTcpAcks(etherHeader *ether, socket *sockets, uint8_t socketCount)
+{
+    uint32_t now = getUptime();
+    socket *s;
+    uint8_t i;
+
+    for (i = 0; i < socketCount; i++)
+    {
+        s = &sockets[i];
+        if (s->ackPending == 0 || s->state != TCP_ESTABLISHED)
+            continue;
+        if (s->ackPending >= TCP_ACK_SEGMENTS || now - s->ackTime >= TCP_ACK_DELAY)
+            sendTcpMessage(ether, s, ACK, NULL, 0);
+    }
+}
+
+// Prints the round trip time estimate and send state of the TCP sockets
+void printTcpStatus(socket *sockets, uint8_t socketCount)
+{
+    static const char *stateNames[] = {"closed", "listen", "syn rcvd", "syn sent", "established", "fin wait 1",
+                                       "fin wait 2", "closing", "close wait", "last ack", "time wait"};
+    socket *s;
+    char remote[22];
+    char str[100];
+    uint16_t used = 0;
+    uint8_t i;
+
+    putsUart0("TCP sockets (times in ms, in flight/window in bytes)\n");
+    putsUart0("  #  remote                 state           srtt   rttvar   rto    in flight  retx\n");
+    for (i = 0; i < socketCount; i++)
+    {
+        s = &sockets[i];
+        if (s->localPort == 0 || s->id != PROTOCOL_TCP)
+            continue;
+        snprintf(remote, sizeof(remote), "%u.%u.%u.%u:%u", s->remoteIpAddress[0], s->remoteIpAddress[1],
+                 s->remoteIpAddress[2], s->remoteIpAddress[3], s->remotePort);
+        snprintf(str, sizeof(str), "  %-2u %-21s  %-11s %6lu.%lu %6lu.%lu %5u %6lu/%-5u %5u\n", i, remote,
+                 (s->state <= TCP_TIME_WAIT) ? stateNames[s->state] : "?",
+                 (unsigned long)(s->srtt >> 3), (unsigned long)((s->srtt & 7) * 10 / 8),
+                 (unsigned long)(s->rttvar >> 2), (unsigned long)((s->rttvar & 3) * 10 / 4), s->rto,
+                 (unsigned long)(s->acknowledgementNumber - s->unacknowledged), s->window, s->retransmissions);
+        putsUart0(str);
+    }
+    for (i = 0; i < TCP_TX_SEGMENTS; i++)
+        if (tcpTxSegments[i].s != NULL)
+            used += tcpTxSegments[i].size;
+    snprintf(str, sizeof(str), "  send buffer: %u segments, %u bytes free of %u\n", tcpTxCount,
+             TCP_TX_BUFFER_SIZE - used, TCP_TX_BUFFER_SIZE);
+    putsUart0(str);
+    for (i = 0, used = 0; i < TCP_RX_BUFFERS; i++)
+        if (tcpRxOwners[i] != NULL)
+            used++;
+    snprintf(str, sizeof(str), "  hold back: %u of %u buffers lent\n", used, TCP_RX_BUFFERS);
+    putsUart0(str);
+}
+
+bool sendTcpMessage(etherHeader *ether, socket *s, uint32_t flags, uint8_t data[], uint16_t dataSize)
+{
+    uint16_t i;
+    uint8_t *copyData;
+    tcpHeader *tcp = startTcpSegment(ether, s);
+
+    switch(s->state)
     {
         case TCP_SYN_SENT:
             if(flags == SYN)
             {
-                tcp->sequenceNumber = htonl(random32());
+                // the SYN is kept in the send buffer, and sent again, until
+                // the SYN|ACK acknowledges it
+                s->acknowledgementNumber = random32();
+                s->unacknowledged = s->acknowledgementNumber;
+                tcp->sequenceNumber = htonl(s->acknowledgementNumber);
                 tcp->acknowledgementNumber = 0;
             }
             else
             {
-                tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-                tcp->acknowledgementNumber = htonl(s.sequenceNumber + 1);       
+                tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+                tcp->acknowledgementNumber = htonl(s->sequenceNumber + 1);       
             }
             break;
         case TCP_FIN_WAIT_1:
-            tcp->sequenceNumber = htonl(s.acknowledgementNumber);
+            tcp->sequenceNumber = htonl(s->acknowledgementNumber);
             tcp->acknowledgementNumber = 0;
             break;
         case TCP_CLOSE_WAIT:
-            tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-            tcp->acknowledgementNumber = htonl(s.sequenceNumber + 1);
+            tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+            tcp->acknowledgementNumber = htonl(s->sequenceNumber + 1);
             if(flags == FIN)
             {
-                tcp->sequenceNumber = htonl(s.acknowledgementNumber);
+                tcp->sequenceNumber = htonl(s->acknowledgementNumber);
                 tcp->acknowledgementNumber = 0;
             }
             break;
         default:
-            tcp->sequenceNumber = htonl(s.acknowledgementNumber);
-            tcp->acknowledgementNumber = htonl(s.sequenceNumber);   
+            tcp->sequenceNumber = htonl(s->acknowledgementNumber);
+            tcp->acknowledgementNumber = htonl(s->sequenceNumber);   
             break;
     }
-    s.acknowledgementNumber += dataSize;
-
     // TCP flags and offset
     tcp->offsetFields = htons(flags | 0x5000);
-    tcp->windowSize = htons((uint16_t)1500);
-    tcp->urgentPointer = 0;
-    // adjust lengths
-    tcpLength = sizeof(tcpHeader) + dataSize;
-    ip->length = htons(ipHeaderLength + tcpLength);
-    
 
     // copy data
     copyData = tcp->data;
     for (i = 0; i < dataSize; i++)
         copyData[i] = data[i];
     
-    // 32-bit sum over ip header
-    calcIpChecksum(ip);
-    calcTcpChecksum(ip, tcpLength);
-    
-    // send packet with size = ether + ip header + tcp header + data size
-    putEtherPacket(ether, sizeof(etherHeader) + ipHeaderLength + tcpLength);
+    return sendTcpSegment(ether, s, dataSize);
+}
+// Starts a socket's timing over for a new connection: no round trip time
+// yet, so the retransmission timeout is TCP_RTO, and nothing received
+// waiting to be acknowledged
+void initTcpSocket(socket *s)
+{
+    s->srtt = 0;
+    s->rttvar = 0;
+    s->rto = TCP_RTO;
+    s->retransmissions = 0;
+    s->persists = 0;
+    s->ackPending = 0;
 }
+
 // Sets socket state
 void setTcpState(socket *s, uint8_t state)
 {
@@ -172,32 +698,232 @@ void setTcpState(socket *s, uint8_t state)
 // Gets pointer to TCP payload of frame
 uint8_t* getTcpData(etherHeader *ether, socket *s)
 {
-    uint16_t dataSize;
-
     ipHeader *ip = (ipHeader*)ether->data;
     uint8_t ipHeaderLength = ip->size * 4;
     tcpHeader *tcp = (tcpHeader*)((uint8_t*)ip + ipHeaderLength);
+    uint16_t tcpLength = ((tcp->offsetFields & 0xF0) >> 4) * 4;
 
-    // Find Payload size
-    if (s->state != TCP_ESTABLISHED)
-        dataSize = 1;
+    updateTcpSocket(s, tcp, ntohs(ip->length) - ipHeaderLength - tcpLength);
+    return tcp->data;
+}
+
+// Counts received data for processTcpAcks to acknowledge; urgent asks for
+// the ACK at once, as a segment out of order or already received means the
+// peer is missing a segment or an ACK (RFC 5681 4.2)
+void delayTcpAck(socket *s, bool urgent)
+{
+    if (s->ackPending == 0)
+        s->ackTime = getUptime();
+    if (urgent && s->ackPending < TCP_ACK_SEGMENTS)
+        s->ackPending = TCP_ACK_SEGMENTS;
+    else if (s->ackPending < UINT8_MAX)
+        s->ackPending++;
+}
+
+// Moves the socket's held back data down to start at its sequenceNumber,
+// so the buffer's room is all ahead of it, or gives the buffer back once
+// nothing is held
+void rebaseTcpRx(socket *s)
+{
+    uint8_t *buffer;
+    uint16_t shift;
+    uint8_t i;
+
+    if (s->rxBuffer == 0)
+        return;
+    if (s->rxRangeCount == 0 || s->state != TCP_ESTABLISHED)
+    {
+        tcpRxOwners[s->rxBuffer - 1] = NULL;
+        s->rxBuffer = 0;
+        s->rxRangeCount = 0;
+        return;
+    }
+    shift = s->sequenceNumber - s->rxBase;
+    if (shift == 0)
+        return;
+    buffer = tcpRxData[s->rxBuffer - 1];
+    memmove(buffer, &buffer[shift], s->rxRanges[s->rxRangeCount - 1].end - shift);
+    for (i = 0; i < s->rxRangeCount; i++)
+    {
+        s->rxRanges[i].start -= shift;
+        s->rxRanges[i].end -= shift;
+    }
+    s->rxBase += shift;
+}
+
+// Gives the socket's hold back buffer back once no runs are left in it
+void releaseTcpRx(socket *s)
+{
+    if (s->rxBuffer == 0 || s->rxRangeCount != 0)
+        return;
+    tcpRxOwners[s->rxBuffer - 1] = NULL;
+    s->rxBuffer = 0;
+}
+
+// Keeps data that arrived beyond a gap, as far as the socket's buffer goes;
+// while every buffer is lent to another socket the data is dropped, and the
+// peer sends it again
+void holdTcpData(socket *s, uint32_t sequenceNumber, uint8_t data[], uint16_t size)
+{
+    uint16_t start, end;
+    uint8_t i, j;
+
+    if (s->rxBuffer == 0)
+    {
+        for (i = 0; i < TCP_RX_BUFFERS && tcpRxOwners[i] != NULL; i++);
+        if (i == TCP_RX_BUFFERS)
+            return;
+        tcpRxOwners[i] = s;
+        s->rxBuffer = i + 1;
+        s->rxBase = s->sequenceNumber;
+        s->rxRangeCount = 0;
+    }
+    if (sequenceNumber - s->rxBase >= TCP_RX_BUFFER_SIZE)
+        return;
+    start = sequenceNumber - s->rxBase;
+    end = (size < TCP_RX_BUFFER_SIZE - start) ? start + size : TCP_RX_BUFFER_SIZE;
+    memcpy(&tcpRxData[s->rxBuffer - 1][start], data, end - start);
+
+    // runs i to j - 1 overlap or touch the new one, and become one with it
+    for (i = 0; i < s->rxRangeCount && s->rxRanges[i].end < start; i++);
+    for (j = i; j < s->rxRangeCount && s->rxRanges[j].start <= end; j++)
+    {
+        if (s->rxRanges[j].start < start)
+            start = s->rxRanges[j].start;
+        if (s->rxRanges[j].end > end)
+            end = s->rxRanges[j].end;
+    }
+    if (j == i)
+    {
+        if (s->rxRangeCount == SOCKET_RX_RANGES)
+            return;
+        memmove(&s->rxRanges[i + 1], &s->rxRanges[i], (s->rxRangeCount - i) * sizeof(socketRange));
+        s->rxRangeCount++;
+    }
     else
     {
-        uint16_t tcpLength = ((tcp->offsetFields & 0xF0) >> 4) * 4;
-        uint16_t ipLength = ip->size * 4;
-        uint16_t totalSize = ntohs(ip->length);
-        dataSize = totalSize - ipLength - tcpLength;
+        memmove(&s->rxRanges[i + 1], &s->rxRanges[j], (s->rxRangeCount - j) * sizeof(socketRange));
+        s->rxRangeCount -= j - i - 1;
     }
-    
-    // if((s->acknowledgementNumber != ntohl(tcp->acknowledgementNumber)) && s->state == TCP_ESTABLISHED)
-    //     return NULL;
+    s->rxRanges[i].start = start;
+    s->rxRanges[i].end = end;
+}
 
-    // Update seq numbers
-    s->sequenceNumber = ntohl(tcp->sequenceNumber) + dataSize;
-    s->acknowledgementNumber = ntohl(tcp->acknowledgementNumber);
+// Takes the data of a segment received on an established socket into its
+// byte stream: data in sequence moves sequenceNumber on, along with any
+// held back data it reaches, and is left for readTcpStream; data beyond a
+// gap is held back; data already received is dropped
+void receiveTcpData(socket *s, uint32_t sequenceNumber, uint8_t data[], uint16_t size)
+{
+    uint16_t skip;
 
-    
-    return tcp->data;
+    // what the last segment brought into sequence is done with, whether or
+    // not its socket read it
+    if (tcpRxReader != NULL && tcpRxReader != s)
+        rebaseTcpRx(tcpRxReader);
+    tcpRxReader = s;
+    tcpRxSegmentSize = 0;
+    tcpRxReady.start = tcpRxReady.end = 0;
+    rebaseTcpRx(s);
+    if (size == 0)
+        return;
+    if ((int32_t)(sequenceNumber + size - s->sequenceNumber) <= 0)
+    {
+        delayTcpAck(s, true);
+        return;
+    }
+    if ((int32_t)(sequenceNumber - s->sequenceNumber) > 0)
+    {
+        holdTcpData(s, sequenceNumber, data, size);
+        delayTcpAck(s, true);
+        return;
+    }
+    skip = s->sequenceNumber - sequenceNumber;
+    tcpRxSegmentData = &data[skip];
+    tcpRxSegmentSize = size - skip;
+    s->sequenceNumber += tcpRxSegmentSize;
+    delayTcpAck(s, false);
+
+    // the runs the segment reaches; the last of them may go on past it
+    while (s->rxRangeCount != 0 && (int32_t)(s->rxBase + s->rxRanges[0].start - s->sequenceNumber) <= 0)
+    {
+        if ((int32_t)(s->rxBase + s->rxRanges[0].end - s->sequenceNumber) > 0)
+        {
+            tcpRxReady.start = s->sequenceNumber - s->rxBase;
+            tcpRxReady.end = s->rxRanges[0].end;
+            s->sequenceNumber = s->rxBase + s->rxRanges[0].end;
+            // a gap filled: the peer should hear of it at once
+            delayTcpAck(s, true);
+        }
+        s->rxRangeCount--;
+        memmove(&s->rxRanges[0], &s->rxRanges[1], s->rxRangeCount * sizeof(socketRange));
+    }
+    if (tcpRxReady.start == tcpRxReady.end)
+        releaseTcpRx(s);
+}
+
+// Returns the next piece of the socket's byte stream the last segment
+// received brought into sequence, and its size; 0 once there is none.  The
+// data is only valid until the next segment is received
+uint16_t readTcpStream(socket *s, uint8_t **data)
+{
+    uint16_t size;
+
+    if (s != tcpRxReader)
+        return 0;
+    if (tcpRxSegmentSize != 0)
+    {
+        *data = tcpRxSegmentData;
+        size = tcpRxSegmentSize;
+        tcpRxSegmentSize = 0;
+        return size;
+    }
+    if (tcpRxReady.start == tcpRxReady.end)
+    {
+        releaseTcpRx(s);
+        return 0;
+    }
+    *data = &tcpRxData[s->rxBuffer - 1][tcpRxReady.start];
+    size = tcpRxReady.end - tcpRxReady.start;
+    tcpRxReady.start = tcpRxReady.end;
+    return size;
+}
+
+// Gives back the last size bytes readTcpStream returned, and all it has yet
+// to return: the socket's sequenceNumber moves back to the first of them,
+// so they are not acknowledged and the peer sends them again
+void unreadTcpStream(socket *s, uint16_t size)
+{
+    if (s != tcpRxReader)
+        return;
+    s->sequenceNumber -= size + tcpRxSegmentSize + (tcpRxReady.end - tcpRxReady.start);
+    tcpRxSegmentSize = 0;
+    tcpRxReady.start = tcpRxReady.end;
+    releaseTcpRx(s);
+}
+
+// Takes the sequence numbers of a received segment carrying dataSize bytes
+void updateTcpSocket(socket *s, tcpHeader *tcp, uint16_t dataSize)
+{
+    // a SYN counts as one byte; once established, the data goes into the
+    // socket's byte stream
+    if (s->state != TCP_ESTABLISHED)
+        s->sequenceNumber = ntohl(tcp->sequenceNumber) + 1;
+    else
+        receiveTcpData(s, ntohl(tcp->sequenceNumber), (uint8_t*)tcp + ((tcp->offsetFields & 0xF0) >> 4) * 4,
+                       dataSize);
+    if (!(ntohs(tcp->offsetFields) & ACK))
+        return;
+    s->window = ntohs(tcp->windowSize);
+    // once the SYN is sent, an acknowledgement only releases sent data;
+    // until then it is the first sequence number to send
+    if (s->state == TCP_ESTABLISHED || s->state == TCP_SYN_SENT)
+        ackTcpQueue(s, ntohl(tcp->acknowledgementNumber));
+    else
+    {
+        s->acknowledgementNumber = ntohl(tcp->acknowledgementNumber);
+        s->unacknowledged = s->acknowledgementNumber;
+    }
 }
 
 bool establishTcpSocket(socket *sockets, uint8_t socketCount ,socket *s)
@@ -239,16 +965,76 @@ uint8_t isTcpSocketConnected(etherHeader *ether, socket *sockets, uint8_t socket
     ipHeader *ip = (ipHeader*)ether->data;
     uint8_t ipHeaderLength = ip->size * 4;
     tcpHeader* tcp = (tcpHeader*)((uint8_t*)ip + ipHeaderLength);
-    
-    // Find Socket
-    uint16_t socketNumber = ntohs(tcp->destPort) & 0xF;
-    if(socketNumber >= socketCount)
-        return socketCount;
+    return findTcpSocket(ip, tcp, sockets, socketCount);
+}
+
+// Bucket of a connection in the socket table: the top bits of the 4-tuple
+// multiplied by 2^32 / golden ratio, which draw on all of its bits
+uint8_t getTcpSocketBucket(const uint8_t remoteIp[4], uint16_t remotePort, uint16_t localPort)
+{
+    uint32_t key = ((uint32_t)remoteIp[0] << 24) | ((uint32_t)remoteIp[1] << 16) | ((uint32_t)remoteIp[2] << 8)
+                 | remoteIp[3];
+
+    key ^= ((uint32_t)remotePort << 16) | localPort;
+    return (key * 2654435761u) >> (32 - TCP_SOCKET_TABLE_BITS);
+}
+
+// Enters a socket in the table under its addresses and ports, which must
+// not change until it is removed
+void addTcpSocket(socket *sockets, uint8_t socketNumber)
+{
+    socket *s = &sockets[socketNumber];
+    uint8_t *link = &tcpSocketTable[getTcpSocketBucket(s->remoteIpAddress, s->remotePort, s->localPort)];
+
+    while (*link != 0)
+    {
+        if (*link == socketNumber + 1)
+            return;
+        link = &sockets[*link - 1].tableNext;
+    }
+    *link = socketNumber + 1;
+    s->tableNext = 0;
+}
 
-    if(sockets[socketNumber].remotePort != ntohs(tcp->sourcePort))
-        return socketCount;
+void removeTcpSocket(socket *sockets, uint8_t socketNumber)
+{
+    socket *s = &sockets[socketNumber];
+    uint8_t *link = &tcpSocketTable[getTcpSocketBucket(s->remoteIpAddress, s->remotePort, s->localPort)];
 
-    return socketNumber;
+    while (*link != 0)
+    {
+        if (*link == socketNumber + 1)
+        {
+            *link = s->tableNext;
+            s->tableNext = 0;
+            return;
+        }
+        link = &sockets[*link - 1].tableNext;
+    }
+}
+
+// Returns the socket of a connection, or socketCount
+uint8_t lookupTcpSocket(socket *sockets, uint8_t socketCount, const uint8_t remoteIp[4], uint16_t remotePort,
+                        uint16_t localPort)
+{
+    uint8_t next = tcpSocketTable[getTcpSocketBucket(remoteIp, remotePort, localPort)];
+    socket *s;
+
+    while (next != 0 && next <= socketCount)
+    {
+        s = &sockets[next - 1];
+        if (s->localPort == localPort && s->remotePort == remotePort
+            && memcmp(s->remoteIpAddress, remoteIp, IP_ADD_LENGTH) == 0)
+            return next - 1;
+        next = s->tableNext;
+    }
+    return socketCount;
+}
+
+// Returns the socket a received segment belongs to, or socketCount
+uint8_t findTcpSocket(ipHeader *ip, tcpHeader *tcp, socket *sockets, uint8_t socketCount)
+{
+    return lookupTcpSocket(sockets, socketCount, ip->sourceIp, ntohs(tcp->sourcePort), ntohs(tcp->destPort));
 }
 
 void calcTcpChecksum(ipHeader *ip, uint16_t tcpLength)
@@ -262,6 +1048,16 @@ void calcTcpChecksum(ipHeader *ip, uint16_t tcpLength)
     sumIpWords(&pseudoTcpLength, 2, &sum);
 
     tcp->checksum = 0;
+    // with the checksum offload on, the ENC28J60 sums the segment once it is
+    // in its buffer, adding the pseudo header sum left in the field
+    if (isEtherChecksumOffload(tcpLength))
+    {
+        tcp->checksum = ~getIpChecksum(sum);
+        setEtherTxChecksum((etherHeader*)((uint8_t*)ip - sizeof(etherHeader)),
+                           (uint8_t*)tcp - ((uint8_t*)ip - sizeof(etherHeader)),
+                           (uint8_t*)&tcp->checksum - ((uint8_t*)ip - sizeof(etherHeader)));
+        return;
+    }
     sumIpWords(tcp, tcpLength, &sum);
     tcp->checksum = getIpChecksum(sum);
 }
@@ -37,6 +37,18 @@ typedef struct _tcpHeader // 20 or more bytes
   uint8_t  data[0];
 } tcpHeader;
 
+typedef struct _tcpTxSegment
+{
+  socket *s;                        // NULL while the slot is free
+  uint32_t sequenceNumber;
+  uint16_t offset;                  // in tcpTxData
+  uint16_t size;
+  uint16_t flags;
+  uint8_t transmissions;            // 0 while it waits for the peer's window
+  uint8_t next;                     // number + 1 of the socket's next segment, 0 for none
+  uint32_t sentTime;                // ms
+} tcpTxSegment;
+
 // TCP states
 #define TCP_CLOSED        0
 #define TCP_LISTEN        1
@@ -62,17 +74,86 @@ typedef struct _tcpHeader // 20 or more bytes
 #define NS  0x0100
 #define OFS_SHIFT 12
 
+// Send buffer shared by the sockets: data sent on an established socket is
+// kept until the peer acknowledges it.  No socket holds more than its share
+// of it, so the others can still send while one peer isn't acknowledging
+#ifndef TCP_TX_BUFFER_SIZE
+#define TCP_TX_BUFFER_SIZE 2048
+#endif
+#define TCP_TX_SEGMENTS    16
+#ifndef TCP_TX_SOCKET_SIZE
+#define TCP_TX_SOCKET_SIZE (TCP_TX_BUFFER_SIZE * 3 / 4)
+#endif
+#define TCP_TX_SOCKET_SEGMENTS (TCP_TX_SEGMENTS * 3 / 4)
+// Retransmission timeout in ms (RFC 6298): TCP_RTO until the socket has a
+// round trip time sample, then the smoothed round trip time plus four times
+// its variation, no less than TCP_RTO_MIN.  It doubles on every timeout up
+// to TCP_RTO_MAX; after TCP_MAX_RETRANSMISSIONS of a segment the socket is
+// given up on
+#define TCP_RTO            1000
+#ifndef TCP_RTO_MIN
+#define TCP_RTO_MIN        200
+#endif
+#define TCP_RTO_MAX        60000
+#define TCP_MAX_RETRANSMISSIONS 8
+// A SYN is sent again on the same timeout, and the connect given up after
+// TCP_MAX_SYN_RETRANSMISSIONS of it (15 s)
+#define TCP_MAX_SYN_RETRANSMISSIONS 3
+// Delayed acknowledgement (RFC 1122 4.2.3.2): received data is acknowledged
+// by the next segment sent on the socket, or by a bare ACK once
+// TCP_ACK_SEGMENTS segments are waiting or the first has waited
+// TCP_ACK_DELAY ms (the RFC allows up to 500 ms)
+#ifndef TCP_ACK_DELAY
+#define TCP_ACK_DELAY      100
+#endif
+#define TCP_ACK_SEGMENTS   2
+// Received segments find their socket through a hash table on (remote ip,
+// remote port, local port); TCP_SOCKET_TABLE_BITS sizes it, best at least
+// twice the sockets
+#ifndef TCP_SOCKET_TABLE_BITS
+#define TCP_SOCKET_TABLE_BITS 6
+#endif
+#define TCP_SOCKET_TABLE_SIZE (1 << TCP_SOCKET_TABLE_BITS)
+// Data received beyond a gap is held back until the gap is filled, in one
+// of TCP_RX_BUFFERS buffers of TCP_RX_BUFFER_SIZE bytes lent to the sockets
+// that need one; a buffer is also the window every socket advertises
+#ifndef TCP_RX_BUFFER_SIZE
+#define TCP_RX_BUFFER_SIZE 1500
+#endif
+#ifndef TCP_RX_BUFFERS
+#define TCP_RX_BUFFERS     2
+#endif
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+void initTcpSocket(socket *s);
 void setTcpState(socket *s, uint8_t state);
-void sendTcpMessage(etherHeader *ether, socket s, uint32_t flags, uint8_t data[], uint16_t dataSize);
+void setTcpHeaderTemplate(socket *s);
+tcpHeader* startTcpSegment(etherHeader *ether, socket *s);
+bool putTcpSegment(etherHeader *ether, socket *s, uint16_t dataSize);
+bool sendTcpSegment(etherHeader *ether, socket *s, uint16_t dataSize);
+bool sendTcpMessage(etherHeader *ether, socket *s, uint32_t flags, uint8_t data[], uint16_t dataSize);
+uint16_t getTcpSendSpace(socket *s);
+void ackTcpQueue(socket *s, uint32_t ack);
+void clearTcpQueue(socket *s);
+socket* processTcpQueue(etherHeader *ether);
+void processTcpAcks(etherHeader *ether, socket *sockets, uint8_t socketCount);
+void printTcpStatus(socket *sockets, uint8_t socketCount);
 bool isTcp(etherHeader *ether);
+bool isTcpChecksumOk(etherHeader *ether, ipHeader *ip, uint16_t tcpLength);
 uint8_t* getTcpData(etherHeader *ether, socket *s);
+void updateTcpSocket(socket *s, tcpHeader *tcp, uint16_t dataSize);
+uint16_t readTcpStream(socket *s, uint8_t **data);
+void unreadTcpStream(socket *s, uint16_t size);
 uint16_t getTcpFlags(etherHeader *ether);
 uint8_t isTcpSocketConnected(etherHeader *ether, socket *sockets, uint8_t socketCount);
+void addTcpSocket(socket *sockets, uint8_t socketNumber);
+void removeTcpSocket(socket *sockets, uint8_t socketNumber);
+uint8_t lookupTcpSocket(socket *sockets, uint8_t socketCount, const uint8_t remoteIp[4], uint16_t remotePort,
+                        uint16_t localPort);
+uint8_t findTcpSocket(ipHeader *ip, tcpHeader *tcp, socket *sockets, uint8_t socketCount);
 bool establishTcpSocket(socket *sockets, uint8_t socketCount ,socket *s);
 void calcTcpChecksum(ipHeader *ip, uint16_t tcpLength);
 #endif
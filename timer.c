@@ -19,8 +19,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include "tm4c123gh6pm.h"
+#include "hal.h"
 #include "timer.h"
+#ifdef HOST
+#include "host.h"
+#endif
 
 #define GET_UPTIME_MS(t) ((t / 40000))
 //-----------------------------------------------------------------------------
@@ -38,10 +41,34 @@ bool reload[NUM_TIMERS];
 // Subroutines
 //-----------------------------------------------------------------------------
 
+#ifdef HOST
+// Number of coming ticks that expire no timer, so the host clock can skip them
+uint32_t getIdleTicks()
+{
+    uint32_t idle = UINT32_MAX;
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS; i++)
+        if (ticks[i] != 0 && ticks[i] - 1 < idle)
+            idle = ticks[i] - 1;
+    return idle;
+}
+
+void skipTicks(uint32_t count)
+{
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS; i++)
+        if (ticks[i] != 0)
+            ticks[i] -= count;
+}
+#endif
+
 void initTimer()
 {
     uint8_t i;
 
+#ifdef HOST
+    attachHostTimer(tickIsr, 1000000, getIdleTicks, skipTicks); // 1 sec tick
+#else
     // Enable clocks
     SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4;
     SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R0;
@@ -61,6 +88,7 @@ void initTimer()
     TIMER4_CTL_R |= TIMER_CTL_TAEN;                  // turn-on timer
     TIMER4_IMR_R |= TIMER_IMR_TATOIM;                // turn-on interrupt
     NVIC_EN2_R |= 1 << (INT_TIMER4A-80);             // turn-on interrupt 86 (TIMER4A)
+#endif
 
    for (i = 0; i < NUM_TIMERS; i++)
    {
@@ -73,7 +101,11 @@ void initTimer()
 
 uint32_t getUptime(void)
 {
+#ifdef HOST
+    return getHostTime() / 1000;
+#else
     return GET_UPTIME_MS(WTIMER0_TAV_R);
+#endif
 }
 
 
@@ -159,12 +191,18 @@ void tickIsr()
             }
         }
     }
+#ifndef HOST
     TIMER4_ICR_R = TIMER_ICR_TATOCINT;
+#endif
 }
 
 // Placeholder random number function
 uint32_t random32()
 {
+#ifdef HOST
+    return getHostRandom();
+#else
     return TIMER4_TAV_R;
+#endif
 }
 
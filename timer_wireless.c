@@ -19,8 +19,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include "tm4c123gh6pm.h"
+#include "hal.h"
 #include "timer_wireless.h"
+#ifdef HOST
+#include "host.h"
+#endif
 
 //-----------------------------------------------------------------------------
 // Global variables
@@ -37,10 +40,34 @@ bool reload_wr[NUM_TIMERS_WR];
 // Subroutines
 //-----------------------------------------------------------------------------
 
+#ifdef HOST
+// Number of coming ticks that expire no timer, so the host clock can skip them
+uint32_t getIdleTicks_ms()
+{
+    uint32_t idle = UINT32_MAX;
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS_WR; i++)
+        if (ticks_wr[i] != 0 && ticks_wr[i] - 1 < idle)
+            idle = ticks_wr[i] - 1;
+    return idle;
+}
+
+void skipTicks_ms(uint32_t count)
+{
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS_WR; i++)
+        if (ticks_wr[i] != 0)
+            ticks_wr[i] -= count;
+}
+#endif
+
 void initTimer_ms()
 {
     uint8_t i;
 
+#ifdef HOST
+    attachHostTimer(tickIsr_ms, 1000, getIdleTicks_ms, skipTicks_ms); // 1 ms tick
+#else
     /* Timer 3A initialization */
     SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R3;
     _delay_cycles(3);
@@ -54,6 +81,7 @@ void initTimer_ms()
     TIMER3_CTL_R |= TIMER_CTL_TAEN;                  // turn-on timer
     TIMER3_IMR_R |= TIMER_IMR_TATOIM;                // turn-on interrupt
     NVIC_EN1_R |= 1 << (INT_TIMER3A-48);             // turn-on interrupt 51 (TIMER3A)
+#endif
 
     for (i = 0; i < NUM_TIMERS_WR; i++)
     {
@@ -148,12 +176,18 @@ void tickIsr_ms()
             }
         }
     }
+#ifndef HOST
     TIMER3_ICR_R = TIMER_ICR_TATOCINT;
+#endif
 }
 
 // Placeholder random number function
 uint32_t random32_ms()
 {
+#ifdef HOST
+    return getHostRandom();
+#else
     return TIMER3_TAV_R;
+#endif
 }
 
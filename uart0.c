@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include "tm4c123gh6pm.h"
 #include "uart0.h"
+#include "busStats.h"
 #include "gpio.h"
 
 // Pins
@@ -74,6 +75,7 @@ void putcUart0(char c)
 {
     while (UART0_FR_R & UART_FR_TXFF);               // wait if uart0 tx fifo full
     UART0_DR_R = c;                                  // write character to fifo
+    countBusBytes(BUS_UART0, 1);
 }
 
 // Blocking function that writes a string when the UART buffer is not full
@@ -95,6 +97,7 @@ void putnsUart0(char* str, uint32_t length)
 char getcUart0(void)
 {
     while (UART0_FR_R & UART_FR_RXFE);               // wait if uart0 rx fifo empty
+    countBusBytes(BUS_UART0, 1);
     return UART0_DR_R & 0xFF;                        // get character from fifo
 }
 
@@ -38,22 +38,18 @@ bool isUdp(etherHeader *ether)
     ipHeader *ip = (ipHeader*)ether->data;
     uint8_t ipHeaderLength = ip->size * 4;
     udpHeader *udp = (udpHeader*)((uint8_t*)ip + ipHeaderLength);
-    bool ok;
-    uint16_t tmp16;
+    return (ip->protocol == PROTOCOL_UDP) && isUdpChecksumOk(ip, udp);
+}
+
+// Determines whether the checksum of a received datagram is intact
+bool isUdpChecksumOk(ipHeader *ip, udpHeader *udp)
+{
     uint32_t sum = 0;
-    ok = (ip->protocol == PROTOCOL_UDP);
-    if (ok)
-    {
-        // 32-bit sum over pseudo-header
-        sumIpWords(ip->sourceIp, 8, &sum);
-        tmp16 = ip->protocol;
-        sum += (tmp16 & 0xff) << 8;
-        sumIpWords(&udp->length, 2, &sum);
-        // add udp header and data
-        sumIpWords(udp, ntohs(udp->length), &sum);
-        ok = (getIpChecksum(sum) == 0);
-    }
-    return ok;
+    // 32-bit sum over pseudo-header
+    sumIpPseudoHeader(ip, ntohs(udp->length), &sum);
+    // add udp header and data
+    sumIpWords(udp, ntohs(udp->length), &sum);
+    return getIpChecksum(sum) == 0;
 }
 
 // Gets pointer to UDP payload of frame
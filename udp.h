@@ -37,6 +37,7 @@ typedef struct _udpHeader // 8 bytes
 //-----------------------------------------------------------------------------
 
 bool isUdp(etherHeader *ether);
+bool isUdpChecksumOk(ipHeader *ip, udpHeader *udp);
 uint8_t* getUdpData(etherHeader *ether);
 void getUdpMessageSocket(etherHeader *ether, socket *s);
 void sendUdpMessage(etherHeader *ether, socket s, uint8_t data[], uint16_t dataSize);
@@ -4,7 +4,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
-#include "tm4c123gh6pm.h"
+#include "hal.h"
 #include "clock.h"
 #include "wait.h"
 #include "gpio.h"
@@ -16,6 +16,8 @@
 #include "hashTable.h"
 #include "mqtt.h" // Added for getMqttBrokerAddress and setMqttBrokerAddress
 #include "i2c0.h"
+#include "busStats.h"
+#include "perfStats.h"
 
 bool isBridge = false;
 bool nrfSyncEnabled = false;
@@ -167,7 +169,7 @@ void processShell1(wirelessPacket* message)
 
             if (strcmp(token, "reboot") == 0)
             {
-                NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
+                resetSystem();
             }
 
             if (strcmp(token, "debug") == 0)
@@ -867,11 +869,13 @@ int nrf24l0TxMsg(uint8_t* data, uint16_t size, uint32_t devBitNum)
     uint8_t *ptr = packet;
     uint8_t temp = 0;
     uint16_t remlen = size+ 1 + sizeof(devBitNum);              /*Increment length for checksum */
+    busOp op;
 
     if(size > (DATA_MAX_SIZE - META_DATA_SIZE))
     {
         return -1;
     }
+    op = setBusOp(BUS_OP_RADIO_TX);
 
     /*meta data*/
     strncpy((char*)ptr,(char*)startCode,sizeof(startCode));
@@ -916,6 +920,7 @@ int nrf24l0TxMsg(uint8_t* data, uint16_t size, uint32_t devBitNum)
 
     memset(packet, 0, sizeof(packet));
 
+    setBusOp(op);
     return 0;
 }
 
@@ -1003,7 +1008,6 @@ void nrf24l0RxMsg(callback fn)
                 packetLength = 0;
                 isBridgePacket = false;
                 isDevPacket = false;
-                Rx_index += payloadlength - 1;
 
             }
             //reset the buffer. */ //Extra precaution
@@ -1189,7 +1193,9 @@ void processWireless(void)
     TimerHandler_BR();
     enableJoin_BR();
 
+    uint32_t perfStart = PERF_START();
     nrf24l0RxMsg(dataReceived);
+    PERF_STOP(PERF_NRF_RX, perfStart);
     if (dataReceivedFlag == true)
     {
         wp = (wirelessPacket*)buffer;
@@ -1257,6 +1263,7 @@ void processWireless(void)
                         for(j = 0; j < devCaps->numOfCaps - '0'; j++)
                         {
                             char inOrOut[8] = {};
+                            memset(binding[j], 0, sizeof(MQTTBinding));  // may hold erased EEPROM from the lookup above
                             binding[j]->client_id[0] = 'd';
                             binding[j]->client_id[1] = 'e';
                             binding[j]->client_id[2] = 'v';
@@ -1314,7 +1321,8 @@ void processWireless(void)
             if((pubWrPtr + 1) % MAX_PUB_MSG_BUFFER_SIZE != pubRdPtr)
             {
                 strcpy(pubMsgBuffer[pubWrPtr][PUB_MSG_BUFFER_TOPIC_INDEX], topicName);
-                strcpy(pubMsgBuffer[pubWrPtr++][PUB_MSG_BUFFER_MSG_INDEX], pushMsg->topicMessage);
+                strcpy(pubMsgBuffer[pubWrPtr][PUB_MSG_BUFFER_MSG_INDEX], pushMsg->topicMessage);
+                pubWrPtr = (pubWrPtr + 1) % MAX_PUB_MSG_BUFFER_SIZE;
             }
             gf_mqtt_device_pub = getMqttBrokerSocketIndex();
 